@@ -5,11 +5,27 @@
  * Brief    : Application to measure voltage and current consumption
  *            on LED/LCD display boards (for Amena.sk) forking to 2 processes. 
  *            Parent process displaying actual voltage current and power to user
- *            Child process calculating accumulative power log.
- *            Utilizing blocking multiplexing on stdin fd 
- *            Sharing accumulative log via shared memory object
+ *            Child processes, one per i2c bus, calculating
+ *            accumulative energy log of every measured device.
+ *            Utilizing blocking multiplexing on stdin fd and on
+ *            epoll instance of socket clients
+ *            Sharing samples and accumulative log via lock-free
+ *            ring and seqlock in shared memory object
  * Version  : v1
- * Options  : </dev/i2c-*> 
+ * Options  : [-r rate | -c] [-p spec] [-t mode] [-j rate] [-s]
+ *            [-l file] [-z file] [-u path] [-T port] [-M port]
+ *            [-R prio[:cpu,...]] <dev>[@addr] ... , dev is /dev/i2c-* or
+ *            sim[:opts], -s scans listed buses for INA219, -l appends
+ *            every sample to binary log file, -z to compressed log file
+ *            with index (see clog.h), -c takes every conversion when CNVR
+ *            bit signals it is ready, -p sets ADC by profile or key=val list
+ *            (see ina_config.h), -t selects timestamps local|iso|epoch,
+ *            -j streams samples of all devices as NDJSON to stdout, at
+ *            most rate lines/s per device, -u and -T serve commands on
+ *            Unix-domain socket path and loopback TCP port, -M serves
+ *            Prometheus metrics over HTTP on loopback port, -R runs
+ *            sampler workers SCHED_FIFO at prio, pinned to cpus with
+ *            memory locked (see rt.h)
  ****************************************************************/
 //#define _FILE_OFFSET_BITS 64
 #define SELF
@@ -20,6 +36,7 @@
 /****************************************************************/
 /************************** Includes ****************************/
 /****************************************************************/
+#include <ctype.h>
 #include <fcntl.h>
 #include <time.h>
 #include <linux/i2c-dev.h>
@@ -30,6 +47,7 @@
 #include <sys/time.h>
 #include <sys/wait.h>
 #include <sys/select.h>
+#include <getopt.h>
 #include "../header/tlpi_hdr.h"
 #include "../header/get_num.h"   /* Declares our functions for handling
 				    numeric arguments (getInt(), 
@@ -38,7 +56,19 @@
 					   functions */
 #include "../header/i2c.h"
 #include "../header/INA219.h"
-#include "../../header/curr_time.h"
+#include "sampler.h"
+#include "i2c_transport.h"
+#include "ina_dev.h"
+#include "measure.h"
+#include "shm_ring.h"
+#include "energy.h"
+#include "sample_log.h"
+#include "ina_config.h"
+#include "ts_fmt.h"
+#include "stream.h"
+#include "command.h"
+#include "server.h"
+#include "rt.h"
 
 /****************************************************************/
 /***************** Global Variable Definitions ******************/
@@ -50,7 +80,8 @@
 /************ Local Symbolic Constant Definitions ***************/
 /****************************************************************/
 // When more, can be put in extra header file
-#define msg "{ \"INFO\":\"Enter 'accu', 'log', 'clear', 'exit'\" }\n"
+#define msg "{ \"INFO\":\"Enter " CMD_LIST "\" }\n"
+#define usage "{ \"INFO\":\"run %s [-r rate | -c] [-p spec] [-t mode] [-j rate] [-s] [-l file] [-z file] [-u path] [-T port] [-M port] [-R prio[:cpu,...]] <dev>[@addr] ..., dev is /dev/i2c-[01] or sim[:opts]\" }\n"
 
 // To use 4us writing/reading delay for INA219 circuit
 #define INA219
@@ -70,9 +101,9 @@
 /************ Static global Variable Definitions ****************/
 /****************************************************************/
 // Must be labeled "static"
-static volatile sig_atomic_t CheckFlag = 0;
 static volatile sig_atomic_t exitFlag = 0;
 static char sigChldMsg[25];
+static stream_s stream;          // NDJSON sample stream to stdout
 
 /****************************************************************/
 /********* Static Local Functions Prototype Declarations ********/
@@ -85,14 +116,15 @@ static void sigContHandler(int sig)
   write(STDOUT_FILENO, sigChldMsg, strlen(sigChldMsg));
 }
 
-static void sigTimer(int sig)
+static void sigUsr(int sig)
 {
-  CheckFlag = 1;
+  exitFlag = 1;
 }
 
-static void sigUsr(int sig)
+/* Only purpose of SIGUSR2 is to interrupt sampler sleep, so it serves
+ * requests posted in shared memory (clear) without waiting for tick */
+static void sigWake(int sig)
 {
-  exitFlag = 1;
 }
 
 
@@ -104,23 +136,49 @@ static void sigUsr(int sig)
 int main(int argc, char *argv[])
 {
   // Processe's and files related variables
-  int i2cfd, nfds, readyfds, status;
-  fd_set readfds;
-  pid_t chldPid;
+  int nfds, readyfds, status;
+  fd_set readfds, writefds;
+  struct timeval tick;
+  pid_t workers[INA_MAX_DEVS];   // one sampler worker per bus
+  pid_t logger = -1;             // sample log writer, only with -l
+  const char *logPath = NULL;
+  const char *zlogPath = NULL;
   gid_t rgid, egid;      // keeping real and effective group id
   //  char *userPath, logFilePath[256];
   char logEntry[BUF_SIZE];
-  double *accuShare;
+  shm_share_s *share;
+  int i, ret;
+
+  // Measured devices, grouped by bus
+  ina_dev_s devs[INA_MAX_DEVS];
+  int ndev = 0, nbus, d;
+  ina_config_s cfg;
+  const char *profile = NULL;
+  long streamRate = 0;
+  rt_opts_s rtOpts = { 0, 0, { 0 } };
+  rt_state_s rtState;
+  int rateSet = 0;
+  int scan = 0;
   
   // Signal related variables
   struct sigaction saCont;
-  struct sigaction saTmr;
   struct sigaction saUsr;
+  struct sigaction saWake;
     
   // Variable handling read/write functionality of i2c device
-  int numRead, numWritten;
-  char RDbuf[2];
-  char command[10];
+  int numRead;
+  char lineBuf[BUF_SIZE];
+  size_t lineLen = 0;
+  char *eol;
+  int running = 1;
+
+  // Commands of console and socket clients work on same state
+  cmd_ctx_s ctx;
+  cmd_pend_s pend;                 // console command waiting for sampler
+  int lines, busy = 0;
+  server_s srv;
+  const char *sockPath = NULL;
+  int tcpPort = 0, httpPort = 0, serving = 0;
 
   /* Variable keeping values from registers
    * calibration register, configuration register, current register
@@ -130,53 +188,90 @@ int main(int argc, char *argv[])
   short confRegVal = 0,
     calibRegVal = 0;
 
-  measured_data_s sIna_measuring;
-
-  // Variable keeping real voltage and current values
-  double realShuntVoltVal = 0.0;
-  double realBusVoltVal = 0.0;
-  double realPowerVal = 0.0;
-  double realCurrVal = 0.0;
   //  double realAccuPow = 0.0;
  
   // Variables related to time and timers(needed for logs) 
   //  struct timeval timeout;
-  struct itimerval itimer;
+  long rate = SMPL_RATE_DEF;
+  int opt;
   
   //  struct tm *currTime;
   //char formTime[50];
+  ts_mode_e tsMode = TS_MODE_LOCAL;
   
-  
-  unsigned char configuration = config_reg;
-  unsigned char calibration = calib_reg;
-  unsigned char current = curr_data_reg;
-  unsigned char power = power_data_reg;
-  unsigned char shunt = shunt_volt_reg;
-  unsigned char bus = bus_volt_reg;
 
   /***************************************************************************/
   /************************* PART SETTING SYSTEMS CONFIG *********************/
   /***************************************************************************/
 
   // Initializing of some variables
-  memset(&sIna_measuring, 0, sizeof(sIna_measuring));
+  memset(&ctx, 0, sizeof(ctx));
+  memset(&pend, 0, sizeof(pend));
   memset(logEntry, 0, BUF_SIZE);
   
   // Check program's entry
   if (argc < 2 || strcmp(argv[1], "--help") == 0) {
-    fprintf(stderr,
-	    "{ \"INFO\":\"run %s </dev/i2c-[01]>\" }\n", argv[0]);
+    fprintf(stderr, usage, argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  // Parse options, sample rate in Hz checked against ADC limit later
+  while ((opt = getopt(argc, argv, "r:cp:t:j:sl:z:u:T:M:R:")) != -1) {
+    switch (opt) {
+    case 'r':
+      rate = getLong(optarg, GN_GT_0, "rate");
+      rateSet = 1;
+      break;
+    case 'c':
+      rate = SMPL_RATE_CNVR;
+      rateSet = 1;
+      break;
+    case 'p':
+      profile = optarg;
+      break;
+    case 't':
+      if (ts_fmt_parse_mode(optarg, &tsMode) == -1) {
+	fprintf(stderr, usage, argv[0]);
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'j':
+      streamRate = getLong(optarg, GN_GT_0, "stream rate");
+      break;
+    case 's':
+      scan = 1;
+      break;
+    case 'l':
+      logPath = optarg;
+      break;
+    case 'z':
+      zlogPath = optarg;
+      break;
+    case 'u':
+      sockPath = optarg;
+      break;
+    case 'T':
+      tcpPort = getInt(optarg, GN_GT_0, "port");
+      break;
+    case 'M':
+      httpPort = getInt(optarg, GN_GT_0, "metrics port");
+      break;
+    case 'R':
+      if (rt_parse(optarg, &rtOpts) == -1) {
+	fprintf(stderr, usage, argv[0]);
+	exit(EXIT_FAILURE);
+      }
+      break;
+    default:
+      fprintf(stderr, usage, argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (optind >= argc) {
+    fprintf(stderr, usage, argv[0]);
     exit(EXIT_FAILURE);
   }
 
-  // Initializing itimer
-  itimer.it_interval.tv_sec = 1;
-  itimer.it_interval.tv_usec = 0;
-  itimer.it_value.tv_sec = 1;
-  itimer.it_value.tv_usec = 0;
-  if (setitimer(ITIMER_REAL, &itimer, NULL) == -1)
-    errExit("setitimer(ITIMER_REAL)");
-  
 
   /* SIGCONT signal handler activation */
   sigemptyset(&saCont.sa_mask);
@@ -185,20 +280,21 @@ int main(int argc, char *argv[])
   if (sigaction(SIGCONT, &saCont, NULL) == -1)
     errExit("sigaction(SIGCONT)");
 
-  /* SIGALRM signal handler activation */
-  sigemptyset(&saTmr.sa_mask);
-  saTmr.sa_handler = sigTimer;
-  saTmr.sa_flags = 0;
-  if (sigaction(SIGALRM, &saTmr, NULL) == -1)
-    errExit("sigaction(SIGALRM)");
-
-  /* SIGUSR1 signal handler activation */
+  /* SIGUSR1 signal handler activation. No SA_RESTART, thus it also
+   * interrupts sampler sleeping in clock_nanosleep() */
   sigemptyset(&saUsr.sa_mask);
   saUsr.sa_handler = sigUsr;
   saUsr.sa_flags = 0;
   if (sigaction(SIGUSR1, &saUsr, NULL) == -1)
     errExit("sigaction(SIGUSR1)");
 
+  /* SIGUSR2 signal handler activation, wakes sampler for requests */
+  sigemptyset(&saWake.sa_mask);
+  saWake.sa_handler = sigWake;
+  saWake.sa_flags = 0;
+  if (sigaction(SIGUSR2, &saWake, NULL) == -1)
+    errExit("sigaction(SIGUSR2)");
+
           
   /* Set effective group id to real group id to prohibit security breaches
    * Since this point egid will equal real gid = martin = 1000
@@ -222,14 +318,43 @@ int main(int argc, char *argv[])
     exit(EXIT_FAILURE);
   }
 
-  // Open i2c device with INA's slave address to communicate with INA
-  i2cfd = i2c_init(argv[1], INA_SLV_ADDR);
+  // Collect devices, either scanned on given buses or listed explicitly
+  for (i = optind; i < argc; i++) {
+    if (scan) {
+      ndev += ina_dev_scan(argv[i], &devs[ndev], INA_MAX_DEVS - ndev);
+      continue;
+    }
+    if (ndev == INA_MAX_DEVS || ina_dev_parse(argv[i], &devs[ndev]) == -1) {
+      fprintf(stderr,
+	      "{ \"ERROR\":\"bad-device-%s\" }\n", argv[i]);
+      exit(EXIT_FAILURE);
+    }
+    ndev++;
+  }
+  if (ndev == 0) {
+    fprintf(stderr,
+	    "{ \"ERROR\":\"no INA219 found\" }\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // Open i2c device (or simulator) with INA's slave address
+  for (d = 0; d < ndev; d++) {
+    if (ina_dev_open(&devs[d]) == -1) {
+      fprintf(stderr,
+	      "{ \"ERROR\":\"i2c_transport_open-%s\" errno: %s }\n",
+	      devs[d].bus, strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+  }
+  nbus = ina_dev_group(devs, ndev);
 
 #ifdef DEBUG
   printf("Effective gid exactly after opening file:%d\n", (int)egid);
 #endif // DEBUG
   
   /**** Set effective gid back to real gid for security reasons ****/
+  // Workers take it back only to reopen bus of device gone offline
+  ina_dev_keep_gid(egid);
   if (setegid(rgid) == -1)
     errExit("{ \"ERROR\":\"setegid-back-real-gid\" }");
 
@@ -243,329 +368,285 @@ int main(int argc, char *argv[])
   /**************************** I2C INA-219 COMMUNICATION *********************/
   /****************************************************************************/
 
-
-  /************************ Registers configuration **************************/
-  // Reset configuration register on each start
-  confRegVal = setreg(reset, 0, 0, 0);
-  numWritten = i2c_write_data_word(i2cfd, &configuration, confRegVal);
-  if (numWritten == -1) {
-    fprintf(stderr,
-	    "{ \"ERROR\":\"i2c_write_data_word(reset-config-reg)\" }\n");
-    exit(EXIT_FAILURE);
-  }
-	    
-#ifdef DEBUG
-  
-  // Read init data from configuration register of INA219
-  memset(RDbuf, 0, I2C_BUF_SIZE);
-  numRead = i2c_read_data_word(i2cfd, &configuration, RDbuf);
-  if (numRead == -1) {
-    fprintf(stderr,
-	    "{ \"ERROR\":\"i2c_read_data_word(configuration_reg)\" }\n");
-    exit(EXIT_FAILURE);
-  }
-
-  strtosh(RDbuf, confRegVal);
-
-  printf("The init value of configuration register: 0x%02hx\n", confRegVal);
-
-#endif // DEBUG
-  
-  /**********************************************************************/
-  /***** Set configuration register to 0x199f and re-read its value *****/
-  /**********************************************************************/
-	  
   // Configure confRegValto value 0x199f (0x1fff)
   // 0x199f => shuntBusCont, SADC_Bitres12def, BADC_Bitres12def, PGA_gain8
   // 0x1fff => shuntBusCont, SADC_Sample128, BADC_Sample128, PGA_gain8
   confRegVal= setreg(shuntBusCont , SADC_Sample128, BADC_Sample128 , PGA_gain8);
+  calibRegVal= 0x1400;
 
-  // Write confRegVal value in configuration register
-  numWritten = i2c_write_data_word(i2cfd, &configuration, confRegVal);
-  if (numWritten == -1) {
-    fprintf(stderr,
-	    "{ \"ERROR\":\"i2c_write_data_word(set-config-reg)\" }\n");
-    exit(EXIT_FAILURE);
-  }
-
-#ifdef DEBUG
-  // Re-read, if confRegVal value set correctly in configuration register
-  memset(RDbuf, 0, I2C_BUF_SIZE);
-  numRead = i2c_read_data_word(i2cfd, &configuration, RDbuf);
-  if (numRead == -1) {
-    fprintf(stderr,
-	    "read-set-conf-register\n");
-    exit(EXIT_FAILURE);
+  // Profile or key=val spec of -p retunes ADC, explicit -r or -c wins
+  cfg.conf = confRegVal;
+  cfg.calib = calibRegVal;
+  cfg.rate = rate;
+  if (profile != NULL) {
+    if (ina_config_parse(profile, &cfg) == -1) {
+      fprintf(stderr,
+	      "{ \"ERROR\":\"bad-config-%s\" }\n", profile);
+      exit(EXIT_FAILURE);
+    }
+    confRegVal = cfg.conf;
+    calibRegVal = cfg.calib;
+    if (!rateSet)
+      rate = cfg.rate;
   }
 
-  strtosh(RDbuf, confRegVal)
-	  
-    printf("The set value of config register: 0x%02hx\n", confRegVal);
-
-#endif // DEBUG
-
-  /**************** Check init value of calibration register ****************/
-#ifdef DEBUG
-  memset(RDbuf, 0, I2C_BUF_SIZE);
-  numRead = i2c_read_data_word(i2cfd, &calibration, RDbuf);
-  if (numRead == -1) {
-    fprintf(stderr,
-	    "i2c_read_data_word-calib-reg-init\n");
-    exit(EXIT_FAILURE);
+  // Reset every device, set configuration and calibration registers
+  for (d = 0; d < ndev; d++) {
+    if (ina_dev_setup(&devs[d], confRegVal, calibRegVal) == -1)
+      exit(EXIT_FAILURE);
+    ctx.devCfg[d] = cfg;
   }
-  
-  strtosh(RDbuf, calibRegVal)
 
-    printf("The init value of calibration register: 0x%02hx\n", calibRegVal);
-
-#endif // DEBUG
-  
-  /**********************************************************************/
-  /****** Set calibration register to 0x1400 and re-read its value ******/
-  /**********************************************************************/
-  // Write calibRegVal value in calibration register
-  calibRegVal= 0x1400;
-  numWritten = i2c_write_data_word(i2cfd, &calibration, calibRegVal);
-  if (numWritten == -1) {
+  // Sampling faster than ADC converts would only re-read old results
+  if (rate != SMPL_RATE_CNVR && rate > ina219_max_rate(confRegVal)) {
     fprintf(stderr,
-	    "{ \"ERROR\":\"i2c_write_data_word(set-calib-reg)\" }\n");
-    exit(EXIT_FAILURE);
-  }
-  
-#ifdef DEBUG
-  // Re-read calibRegVal value set correctly in calibration register
-  memset(RDbuf, 0, I2C_BUF_SIZE);
-  numRead = i2c_read_data_word(i2cfd, &calibration, RDbuf);
-  if (numRead == -1) {
-    fprintf(stderr,
-	    "i2c_read_data_word-calib-reg-set\n");
+	    "{ \"ERROR\":\"rate %ld Hz above ADC limit %ld Hz\" }\n",
+	    rate, ina219_max_rate(confRegVal));
     exit(EXIT_FAILURE);
   }
 
-  strtosh(RDbuf, calibRegVal)
-    
-  printf("The set value of calibration register: 0x%02hx\n", calibRegVal);
-
-  // Map anonymous shared mapping to share accumulative value
-  // This should be inherited by child process and should
+  // Map anonymous shared mapping to share samples and accumulative value
+  // This should be inherited by child processes and should
   // be shared between parent and child processes
-  accuShare = mmap(NULL, sizeof(double), PROT_READ | PROT_WRITE,
-		   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
-  if (accuShare == MAP_FAILED) {
+  share = shm_share_create(ndev);
+  if (share == NULL) {
     fprintf(stderr,
 	   "{ \"ERROR\":\"mmap(2)\" errno: %s }\n",
 	   strerror(errno));
     exit(EXIT_FAILURE);
   }
-  
-  // Clear shared memory object content
-  *accuShare = 15;
- 
-
-#endif //DEBUG
+  atomic_store(&share->rate, rate);
+
+  // Bus workers time every transaction from now on
+  for (d = 0; d < ndev; d++)
+    devs[d].tr.stats = &share->dev[d].i2c;
+
+  // Command server for socket clients, busy port or path fails early
+  if (sockPath != NULL || tcpPort > 0 || httpPort > 0) {
+    if (server_init(&srv, tsMode) == -1
+	|| (sockPath != NULL && server_listen_unix(&srv, sockPath) == -1)
+	|| (tcpPort > 0 && server_listen_tcp(&srv, tcpPort) == -1)
+	|| (httpPort > 0 && server_listen_http(&srv, httpPort) == -1)) {
+      fprintf(stderr,
+	      "{ \"ERROR\":\"server\" errno: %s }\n",
+	      strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+    serving = 1;
+  }
   
   /*
    * Read Current, Power, Bus & Shunt Voltage Register values
    * convert it to human readable format, write it to log file
    */
 
-  switch(chldPid = fork()) {
-  case -1:
-    fprintf(stderr,
-	    "{ \"ERROR\":\"select\" errno: %s }\n"
-	    , strerror(errno));
-
-    /******************************  CHILD PROCESS  *******************************/
-  case 0:
-      for(;;) {
-
-      // Measure power register continuosly each 1 second
-      if (CheckFlag) {
-
-	printf("The value of accuShare in child process: %.2f\n", *accuShare);
-	
-	// Read value from power register
-	numRead = i2c_read_data_word(i2cfd, &power, RDbuf);
-	if (numRead == -1) {
-	  fprintf(stderr,
-		  "{ \"ERROR\":\"i2c_read_data_word(power-reg)\" }\n");
-	  exit(EXIT_FAILURE);
-	}
-
-	// Make conversions 
-	strtosh(RDbuf, sIna_measuring.powerRegVal)
-        realPowerVal = pwrConv(sIna_measuring.powerRegVal);
-
-	*accuShare += realPowerVal;
-	
-	CheckFlag = 0;
+  /******************************  CHILD PROCESSES  *****************************
+   * One sampler worker per bus. Devices on same bus are serialized within     *
+   * worker, different buses are sampled in parallel                           *
+   *****************************************************************************/
+  for (i = 0; i < nbus; i++) {
+    switch(workers[i] = fork()) {
+    case -1:
+      fprintf(stderr,
+	      "{ \"ERROR\":\"fork\" errno: %s }\n"
+	      , strerror(errno));
+      exit(EXIT_FAILURE);
+
+    case 0:
+      // Real-time mode is opt-in, worker without it still samples
+      rt_enter(&rtOpts, i, &rtState);
+      for (d = 0; d < ndev; d++) {
+	if (devs[d].busIdx != i)
+	  continue;
+	atomic_store(&share->dev[d].stats.rtPrio, rtState.prio);
+	atomic_store(&share->dev[d].stats.rtCpu, rtState.cpu);
+	atomic_store(&share->dev[d].stats.rtLocked, rtState.locked);
       }
+      _exit(sampler_worker(devs, ndev, i, share, rate, &exitFlag) == 0
+	    ? EXIT_SUCCESS : EXIT_FAILURE);
+
+    default:
+      break;
+    }
+  }
 
-      // Check if parent does require exit
-      if (exitFlag)
-	_exit(EXIT_SUCCESS);
+  // Logger drains rings to file, so storage never stalls samplers
+  if (logPath != NULL || zlogPath != NULL) {
+    switch(logger = fork()) {
+    case -1:
+      fprintf(stderr,
+	      "{ \"ERROR\":\"fork\" errno: %s }\n"
+	      , strerror(errno));
+      exit(EXIT_FAILURE);
+
+    case 0:
+      _exit(log_worker(share, logPath, zlogPath, &exitFlag) == 0
+	    ? EXIT_SUCCESS : EXIT_FAILURE);
+
+    default:
+      break;
     }
+  }
    
-    /*************************** PARENT PROCESS *********************************
-     * Parent process checks and displays current values of measured quantities *
-     * If exited then sends SIGUSR1 signal to its child process. That in turn   *
-     * closes its accumulative log file and exits as well.                      *
-     ****************************************************************************/
-  default :
-
-     printf(msg);
-    snprintf(sigChldMsg, sizeof(sigChldMsg), "[PID]:%ld\n", (long)getpid());
-
-    for (;;) {
-      /* Set timeval to zero and make ready readfds for select syscall */
-      //  timeout.tv_sec = 0;
-      //timeout.tv_usec = 0;
-      nfds = STDIN_FILENO + 1;
-      FD_ZERO(&readfds);
+  /*************************** PARENT PROCESS *********************************
+   * Parent process checks and displays current values of measured quantities *
+   * If exited then sends SIGUSR1 signal to its child processes. Those in     *
+   * turn close their accumulative log and exit as well.                      *
+   ****************************************************************************/
+
+  ctx.devs = devs;
+  ctx.ndev = ndev;
+  ctx.nbus = nbus;
+  ctx.workers = workers;
+  ctx.share = share;
+  ctx.rate = rate;
+
+  // Sample timestamps are CLOCK_MONOTONIC, shown as wall-clock time
+  ts_fmt_init(&ctx.tsFmt, tsMode, TS_FMT_DEF, TS_FRAC_DIGITS);
+
+  printf(msg);
+  fflush(stdout);
+  snprintf(sigChldMsg, sizeof(sigChldMsg), "[PID]:%ld\n", (long)getpid());
+
+  // Stream shares stdout with command responses, lines are kept whole
+  stream_init(&stream, STDOUT_FILENO, tsMode);
+  if (streamRate > 0)
+    stream_start(&stream, share, streamRate, 0, ndev - 1);
+
+  while (running) {
+    /* Make ready readfds for select syscall, stdout is watched only
+     * while stream has buffered lines, stdin only while no command
+     * waits for sampler */
+    nfds = STDIN_FILENO + 1;
+    FD_ZERO(&readfds);
+    if (pend.kind == CMD_PEND_NONE)
       FD_SET(STDIN_FILENO, &readfds);
+    if (serving) {
+      FD_SET(server_fd(&srv), &readfds);
+      if (server_fd(&srv) >= nfds)
+	nfds = server_fd(&srv) + 1;
+    }
+    FD_ZERO(&writefds);
+    if (stream_pending(&stream) > 0) {
+      FD_SET(stream.fd, &writefds);
+      if (stream.fd >= nfds)
+	nfds = stream.fd + 1;
+    }
 
-      // Wait for command on STDIN descriptor in blocking mode
-      while ((readyfds = select(nfds, &readfds, NULL, NULL, NULL)) == -1 && errno == EINTR);
-      if (readyfds == -1) {
-	fprintf(stderr,
-		"{ \"ERROR\":\"select\" errno: %s }\n"
-		, strerror(errno));
-	exit(EXIT_FAILURE);
+    /* Wait for command, streaming wakes up every tick to pull rings,
+     * commands waiting for sampler to poll acknowledgements */
+    tick.tv_sec = 0;
+    tick.tv_usec = STREAM_TICK_MS * 1000;
+    readyfds = select(nfds, &readfds, &writefds, NULL,
+		      (stream.active || pend.kind != CMD_PEND_NONE || busy
+		       || (serving && (server_streaming(&srv)
+				       || server_waiting(&srv))))
+		      ? &tick : NULL);
+    if (readyfds == -1 && errno == EINTR)
+      continue;
+    if (readyfds == -1) {
+      fprintf(stderr,
+	      "{ \"ERROR\":\"select\" errno: %s }\n"
+	      , strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+
+    /* Never blocks, lines not fitting in stream buffer are dropped.
+     * Stdout is written only when select() found it writable */
+    stream_poll(&stream, share);
+    if (FD_ISSET(stream.fd, &writefds)
+	&& stream_flush(&stream) == -1) {
+      fprintf(stderr,
+	      "{ \"ERROR\":\"stream writev\" errno: %s }\n"
+	      , strerror(errno));
+      stream_stop(&stream);
+      stream.head = stream.tail;
+    }
+
+    // Clients are served without blocking, whether epoll fd is ready or not
+    if (serving)
+      server_service(&srv, &ctx);
+    busy = cmd_service(&ctx);
+
+    // Console command waiting for sampler, lines behind it wait too
+    lines = 0;
+    if (pend.kind != CMD_PEND_NONE) {
+      stream_sync(&stream);
+      lines = (cmd_poll(&pend, stdout) == CMD_DONE);
+    }
+
+    /* Check if stdin fd already in ready state
+       and read entered commands, one per line. EOF means exit */
+    if (FD_ISSET(STDIN_FILENO, &readfds) == 1) {
+      numRead = read(STDIN_FILENO, lineBuf + lineLen, sizeof(lineBuf) - lineLen - 1);
+      if (numRead <= 0) {
+	strcpy(lineBuf, "exit\n");
+	lineLen = strlen(lineBuf);
       }
+      else
+	lineLen += numRead;
 
-      /* Check if stdin fd already in ready state
-	 and read entered command */
-      if (FD_ISSET(STDIN_FILENO, &readfds) == 1) {
-	scanf("%s", command);
-
-        /*********************************** LOG **********************************/
-       if ( !strcmp(command, "log") ) {
-
-	 //Read value from shunt voltage register
-	 numRead = i2c_read_data_word(i2cfd, &shunt, RDbuf);
-	 if (numRead == -1) {
-	   fprintf(stderr,
-		   "{ \"ERROR\":\"i2c_read_data_word(shunt-volt-reg)\" }\n");
-	   exit(EXIT_FAILURE);
-	 }
-
-	 strtosh(RDbuf, sIna_measuring.shuntRegVal)
-	 
-	 // Read value from bus voltage register
-	 numRead = i2c_read_data_word(i2cfd, &bus, RDbuf);
-	 if (numRead == -1) {
-	   fprintf(stderr,
-		   "{ \"ERROR\":\"i2c_read_data_word(bus-volt-reg)\" }\n");
-	   exit(EXIT_FAILURE);
-	 }
-
-	 // Convert shunt-voltage. If negative voltage convert it to positive
-	 if (sign(sIna_measuring.shuntRegVal) == -1) {
-	   sIna_measuring.complVal = complement(sIna_measuring.shuntRegVal);
-	   realShuntVoltVal = shuntVoltConv(sIna_measuring.complVal);
-	 }
-	 else {
-	   realShuntVoltVal = shuntVoltConv(sIna_measuring.shuntRegVal);
-	 }
-	 
-	 // Make bus voltage conversions
-	 strtosh(RDbuf, sIna_measuring.busRegVal)
-	 if (sIna_measuring.busRegVal & CNVR)
-	   realBusVoltVal = busVoltConv(sIna_measuring.busRegVal);
-	 else{
-	    printf("Bus voltage not measured this time\n");
-	 }
-
-	 // Read value from current register
-	 numRead = i2c_read_data_word(i2cfd, &current, RDbuf);
-	 if (numRead == -1) {
-	   fprintf(stderr,
-		   "{ \"ERROR\":\"i2c_read_data_word(current-reg)\" }\n");
-	   exit(EXIT_FAILURE);
-	 }
-
-	 // Make current conversions
-	 strtosh(RDbuf, sIna_measuring.currRegVal)
-	 realCurrVal = currConv(sIna_measuring.currRegVal);
-
-	 // Read value from power register
-	 numRead = i2c_read_data_word(i2cfd, &power, RDbuf);
-	 if (numRead == -1) {
-	   fprintf(stderr,
-		   "{ \"ERROR\":\"i2c_read_data_word(power-reg)\" }\n");
-	   exit(EXIT_FAILURE);
-	 }
-
-	 // Make power conversion
-	 strtosh(RDbuf, sIna_measuring.powerRegVal)
-	 realPowerVal =  pwrConv(sIna_measuring.powerRegVal);
-	 
-#ifdef DEBUG
-	 printf("The value of busRegVal: 0x%02hx\n", sIna_measuring.busRegVal);
-#endif // DEBUG
-     
-#ifdef JSON
-	 printf("{\n\"log\":{ \"timestamp\":\"%s\", \"voltage\":%.2f, \"current\":%.2f, \"power\":%.2f }\n}\n",
-		currTime("%d/%m/%y %T"),
-		realBusVoltVal + (realShuntVoltVal / 1000) ,
-		realCurrVal,
-		realPowerVal);
-#else // JSON
-	 printf("The actual value of current : %.2f A\n", realCurrVal);
-	 printf("The actual value of shunt voltage: %.2f mV\n", realShuntVoltVal);
-	 printf("The actual value of bus voltage: %.2f\n", realBusVoltVal);
-	 printf("The actual value of power: %.2f\n", realPowerVal);
-#endif // JSON
-       }
+      // Overlong line without newline is dropped
+      if (lineLen == sizeof(lineBuf) - 1 && memchr(lineBuf, '\n', lineLen) == NULL)
+	lineLen = 0;
+      lines = 1;
+    }
 
-       /****************************** ACCU ******************************/
-       else if ( !strcmp(command, "accu") ) {
-	 
+    if (lines) {
+      while (running && pend.kind == CMD_PEND_NONE
+	     && (eol = memchr(lineBuf, '\n', lineLen)) != NULL) {
+	*eol = '\0';
+
+	// Response must not start in middle of streamed line
+	stream_sync(&stream);
+	ret = cmd_exec(&ctx, lineBuf, stdout, &stream, &pend);
+
+	lineLen -= eol + 1 - lineBuf;
+	memmove(lineBuf, eol + 1, lineLen);
+
+        /********************************* EXIT ********************************/
+	if (ret == CMD_EXIT) {
+	  // Lines still buffered are discarded
+	  stream_stop(&stream);
+	  if (serving)
+	    server_close(&srv);
+
+	  // Send signal to child processes that is caught
+	  // by sigUsr signal handler
+	  for (i = 0; i < nbus; i++)
+	    kill(workers[i], SIGUSR1);
+	  for (i = 0; i < nbus; i++)
+	    waitpid(workers[i], &status, 0);
+	  // Logger last, it writes samples taken until workers stopped
+	  if (logger != -1) {
+	    kill(logger, SIGUSR1);
+	    waitpid(logger, &status, 0);
+	  }
+
+	  // Workers stopped, accumulators and instrumentation are final
+	  cmd_exec(&ctx, "accu", stdout, &stream, &pend);
+	  cmd_exec(&ctx, "metrics", stdout, &stream, &pend);
+	  cmd_exec(&ctx, "jitter", stdout, &stream, &pend);
 #ifdef JSON
-	 printf("{ \"timestamp\":\"%s\", \"power\":%.2f };\n",
-		currTime("%d/%m/%y %T"), *accuShare);
+	  printf("{ \"INFO\":\"You are exiting %s application\" }\n", argv[0]);
 #else // JSON
-	 printf("The actual value of power: %.2f W\n", accuPowVal);
-#endif //JSON
-       }
-
-       /********************************* CLEAR *******************************/
-       else if ( !strcmp(command, "clear") ) {
-	 *accuShare = 0;
-       }
-             
-       /********************************* EXIT ********************************/
-       else if (strcmp(command, "exit") == 0) {
-	 // Send signal to child process that is caught
-	 // by sigUsr signal handler
-	 kill(chldPid, SIGUSR1);
-	 if (waitpid(chldPid, &status, 0) == chldPid) {
-	   if (WIFEXITED(status)) {
-#ifdef JSON
-	     printf("{ \"INFO\":\"You are exiting %s application\" }\n", argv[0]);
-#else // JSON
-	     printf("You are exiting INA219_v1 application");
+	  printf("You are exiting INA219_v1 application");
 #endif // JSON
-	     break;
-	   }
-	 }
-       }
-       else {
-#ifdef JSON
-	 printf("{ \"WARN\":\"Unrecognized command! Valid commands are: 'voltage', 'current', 'log', 'exit'\" }\n");
-#else // JSON
-	 printf("Unrecognized command!\n"
-		"Valid commands are: \'accu', \'log\', \'clear\', \'exit\'\n");
-#endif // JSON
-       }
+	  running = 0;
+	}
       }
+
+      // Responses leave before next streamed lines, stdout may be pipe
+      fflush(stdout);
     }
   }
 
-  if(close(i2cfd) == -1) {
-    fprintf(stderr,
-	    "{ \"ERROR\":\"close-i2cfd\" }\n");
-    exit(EXIT_FAILURE);
+  for (d = 0; d < ndev; d++) {
+    if(i2c_tr_close(&devs[d].tr) == -1) {
+      fprintf(stderr,
+	      "{ \"ERROR\":\"close-i2cfd\" }\n");
+      exit(EXIT_FAILURE);
+    }
   }
 
   exit(EXIT_SUCCESS);
@@ -0,0 +1,256 @@
+/*****************************************************************
+ * Title    : autorange.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Source file of automatic PGA gain ranging. Decision is
+ *            made from sample already read, integer compares only, so
+ *            sampler pays two register writes per switch and nothing
+ *            per sample. Calibration is written before configuration,
+ *            whose write restarts conversion, thus samples read within
+ *            conversion time after switch still hold old range
+ * Version  : 1.00
+ * Options  : SELF build runs standby - full load - standby profile:
+ *            [standby A] [load A] [calibration of /8]
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+
+//#define SELF
+//#define DEBUG
+//#define PRINT
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <math.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/INA219.h"
+#include "ina_config.h"
+#include "autorange.h"
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+static int ar_fits(const autorange_s *ar, int pg, long mag);
+#ifdef SELF
+static void self_read(long shunt, int pg, unsigned short calib,
+		      int64_t tsNs, sample_s *smp);
+#endif // SELF
+
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+#ifdef SELF
+int main(int argc, char *argv[])
+{
+  autorange_s ar;
+  sample_s smp;
+  unsigned short conf = 0x399f | CONF_AUTO_PGA;
+  double standby = (argc > 1) ? atof(argv[1]) : 0.005;
+  double load = (argc > 2) ? atof(argv[2]) : 2.5;
+  unsigned short calib = (argc > 3) ? (unsigned short)strtol(argv[3], NULL, 0)
+    : 0x1400;
+  double amps;
+  int64_t ts;
+  int i, pg, switches = 0;
+
+  autorange_init(&ar, &conf, &calib);
+  printf("start pg %d conf 0x%04hx calib 0x%04hx\n", ar.pg, conf, calib);
+
+  // 1 kHz samples of 0.1 ohm shunt, load in middle third
+  for (i = 0; i < 300; i++) {
+    ts = i * 1000000LL;
+    amps = (i >= 100 && i < 200) ? load : standby;
+    self_read(lround(amps * 0.1 / 10e-6), ar.pg, calib, ts, &smp);
+    pg = autorange_step(&ar, &smp);
+    meas_eng(&smp);
+    if (pg != -1 || (smp.flags & (SMPL_F_RANGE | SMPL_F_OVF)) || i % 50 == 0)
+      printf("%3d: %.5f A scale %d%s%s\n", i, smp.current,
+	     smplScale(smp.flags), (smp.flags & SMPL_F_OVF) ? " OVF" : "",
+	     (smp.flags & SMPL_F_RANGE) ? " RANGE" : "");
+    if (pg != -1) {
+      autorange_switch(&ar, pg, &conf, &calib);
+      ar.settleNs = ts + 1500000;
+      printf("     -> pg %d conf 0x%04hx calib 0x%04hx\n", pg, conf, calib);
+      switches++;
+    }
+  }
+  printf("switches %d, end pg %d\n", switches, ar.pg);
+
+  exit(EXIT_SUCCESS);
+}
+
+#endif // SELF
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+/* @func  ar_fits - range pg can take shunt magnitude mag: calibration
+ *                  of pg fits its register and current register read
+ *                  at pg stays AR_DOWN_PCT below its full scale
+ * @return 1 fits, 0 not
+ */
+static int ar_fits(const autorange_s *ar, int pg, long mag)
+{
+  int64_t calib = (int64_t)ar->baseCalib << (AR_PG_MAX - pg);
+
+  return calib <= AR_CALIB_MAX
+    && mag * calib / 4096 < AR_CURR_FS * AR_DOWN_PCT / 100;
+}
+
+
+#ifdef SELF
+/* @func  self_read - registers of INA219 measuring shunt counts at
+ *                    range pg, clipped and flagged as device does
+ */
+static void self_read(long shunt, int pg, unsigned short calib,
+		      int64_t tsNs, sample_s *smp)
+{
+  long current;
+  int ovf = 0;
+
+  if (shunt > AR_FS_COUNTS(pg)) {
+    shunt = AR_FS_COUNTS(pg);
+    ovf = 1;
+  }
+  current = shunt * calib / 4096;
+  if (current > 32767) {
+    current = 32767;
+    ovf = 1;
+  }
+
+  memset(smp, 0, sizeof(*smp));
+  smp->tsNs = tsNs;
+  smp->raw[MEAS_SHUNT] = (uint16_t)shunt;
+  smp->raw[MEAS_BUS] = (uint16_t)((3000 << 3) | CNVR | (ovf ? OVF : 0));
+  smp->raw[MEAS_CURR] = (uint16_t)current;
+  smp->raw[MEAS_POWER] = (uint16_t)(current * 3000 / 5000);
+  if (ovf)
+    smp->flags |= SMPL_F_OVF;
+}
+#endif // SELF
+
+
+/****************************************************************/
+/**************** Global Functions Definitions ******************/
+/****************************************************************/
+
+/* @func  autorange_init - start ranging when configuration asks for
+ *                         it by CONF_AUTO_PGA, range of PGA field is
+ *                         first one. Finest range is limited by
+ *                         ar_fits(), calibration must fit its register
+ * @param unsigned short *conf  - configuration, CONF_AUTO_PGA cleared
+ * @param unsigned short *calib - calibration of /8, scaled to range
+ */
+void autorange_init(autorange_s *ar, unsigned short *conf,
+		    unsigned short *calib)
+{
+  memset(ar, 0, sizeof(*ar));
+  if (!(*conf & CONF_AUTO_PGA))
+    return;
+
+  ar->on = 1;
+  ar->baseCalib = *calib;
+  while (ar->minPg < AR_PG_MAX && !ar_fits(ar, ar->minPg, 0))
+    ar->minPg++;
+
+  ar->pg = (*conf >> CONF_PG_SHIFT) & CONF_PG_MASK;
+  if (ar->pg < ar->minPg)
+    ar->pg = ar->minPg;
+  autorange_switch(ar, ar->pg, conf, calib);
+}
+
+
+/* @func  autorange_step - stamp sample with scale of its range and
+ *                         decide next range. OVF goes straight to /8,
+ *                         shunt or current near full scale one range
+ *                         up, finer range is taken once AR_DOWN_SAMPLES
+ *                         fresh samples fit it with margin
+ * @param sample_s *smp  - decoded sample, scale and SMPL_F_RANGE set
+ * @return new PGA field, -1 range stays
+ */
+int autorange_step(autorange_s *ar, sample_s *smp)
+{
+  long mag;
+
+  if (!ar->on)
+    return -1;
+
+  // Conversion under new range could not have completed yet
+  if (smp->tsNs < ar->settleNs) {
+    smp->flags |= SMPL_F_RANGE
+      | (uint32_t)(AR_PG_MAX - ar->prevPg) << SMPL_F_SCALE_SHIFT;
+    return -1;
+  }
+  smp->flags |= (uint32_t)(AR_PG_MAX - ar->pg) << SMPL_F_SCALE_SHIFT;
+
+  mag = labs((long)(int16_t)smp->raw[MEAS_SHUNT]);
+  if (smp->flags & SMPL_F_OVF)
+    return (ar->pg < AR_PG_MAX) ? AR_PG_MAX : -1;
+  if (mag > AR_FS_COUNTS(ar->pg) * AR_UP_PCT / 100
+      || labs((long)(int16_t)smp->raw[MEAS_CURR])
+      > AR_CURR_FS * AR_UP_PCT / 100)
+    return (ar->pg < AR_PG_MAX) ? ar->pg + 1 : -1;
+
+  // Re-read of old conversion tells nothing new
+  if (smp->flags & SMPL_F_STALE)
+    return -1;
+  if (ar->pg > ar->minPg
+      && mag < AR_FS_COUNTS(ar->pg - 1) * AR_DOWN_PCT / 100
+      && ar_fits(ar, ar->pg - 1, mag)) {
+    if (++ar->below >= AR_DOWN_SAMPLES)
+      return ar->pg - 1;
+  }
+  else
+    ar->below = 0;
+
+  return -1;
+}
+
+
+/* @func  autorange_switch - take range pg, caller writes registers and
+ *                           sets settleNs to end of first conversion
+ * @param int pg                - new PGA field
+ * @param unsigned short *conf  - configuration with PGA field of pg
+ * @param unsigned short *calib - calibration of pg
+ */
+void autorange_switch(autorange_s *ar, int pg, unsigned short *conf,
+		      unsigned short *calib)
+{
+  ar->prevPg = ar->pg;
+  ar->pg = pg;
+  ar->below = 0;
+
+  *conf = (unsigned short)((*conf & ~(CONF_AUTO_PGA
+				      | CONF_PG_MASK << CONF_PG_SHIFT))
+			   | pg << CONF_PG_SHIFT);
+  *calib = (unsigned short)(ar->baseCalib << (AR_PG_MAX - pg));
+}
@@ -0,0 +1,60 @@
+/*****************************************************************
+ * Title    : autorange.h
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Header file of automatic PGA gain ranging. Shunt register
+ *            LSB is 10 uV at every gain, so calibration is scaled with
+ *            range: each finer range doubles calibration and halves
+ *            current and power LSB. Sample carries its scale, readers
+ *            divide currConv() and pwrConv() results by 2^scale.
+ *            Range steps up at once on OVF or near full scale and down
+ *            only after AR_DOWN_SAMPLES samples fit finer range. With
+ *            calibration doubled current register fills before shunt
+ *            does, so finer range must fit both
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+#ifndef AUTORANGE_H
+#define AUTORANGE_H
+
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <stdint.h>
+#include "measure.h"
+
+/****************************************************************/
+/******************* Symbolic Constant Definitions **************/
+/****************************************************************/
+#define AR_PG_MAX        3          // PGA field of /8, +-320 mV
+#define AR_FS_COUNTS(pg) (4000L << (pg)) // shunt full scale, 10 uV LSB
+#define AR_UP_PCT        90         // of full scale, coarser range
+#define AR_DOWN_PCT      80         // of finer full scale, finer range
+#define AR_DOWN_SAMPLES  16         // consecutive samples before finer
+#define AR_CALIB_MAX     0xfffe     // bit 0 of calibration is read-only
+#define AR_CURR_FS       32767L     // current register full scale
+#define AR_SETTLE_NS     200000LL   // bus write, added to conversion time
+
+/****************************************************************/
+/********************** New Types Definitions *******************/
+/****************************************************************/
+typedef struct {
+  int on;                           // gain ranged automatically
+  int pg;                           // PGA field in effect
+  int prevPg;                       // PGA field before last switch
+  int minPg;                        // finest range calibration fits
+  unsigned short baseCalib;         // calibration of /8 range
+  int below;                        // consecutive samples fitting finer
+  int64_t settleNs;                 // samples read before it are marked
+} autorange_s;
+
+/****************************************************************/
+/******************* Global Functions Declarations **************/
+/****************************************************************/
+void autorange_init(autorange_s *ar, unsigned short *conf,
+		    unsigned short *calib);
+int autorange_step(autorange_s *ar, sample_s *smp);
+void autorange_switch(autorange_s *ar, int pg, unsigned short *conf,
+		      unsigned short *calib);
+
+#endif // AUTORANGE_H
@@ -0,0 +1,477 @@
+/*****************************************************************
+ * Title    : bench.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Microbenchmarks of sampling hot paths: register access
+ *            through transport, conversion macros, currTime() and
+ *            JSON output. Prints one JSON object per line, so results
+ *            of stations can be collected and compared by script
+ * Version  : 1.00
+ * Options  : [-n ops] [-r runs] [dev],
+ *            dev is /dev/i2c-*[@addr] or sim[:opts] (default sim)
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+
+#define SELF
+//#define DEBUG
+//#define PRINT
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <time.h>
+#include <getopt.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/get_num.h"
+#include "../header/INA219.h"
+#include "../../header/curr_time.h"
+#include "i2c_transport.h"
+#include "ina_dev.h"
+#include "measure.h"
+#include "shm_ring.h"
+#include "energy.h"
+#include "sampler.h"
+#include "ts_fmt.h"
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+#define BENCH_OPS_DEF    100000     // operations per run
+#define BENCH_RUNS_DEF   5          // runs per benchmark, median reported
+#define BENCH_RUNS_MAX   32
+#define BENCH_DEV_DEF    "sim:lat=0"
+
+// System calls i2c-dev backend issues per transport operation
+#define SYSC_READ_WORD   2          // write(reg pointer) + read()
+#define SYSC_WRITE_WORD  1          // write()
+#define SYSC_READ_WORDS  1          // ioctl(I2C_RDWR)
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+typedef struct {
+  ina_dev_s dev;
+  i2c_ops_s ops;                    // counting copy of backend ops
+  const i2c_ops_s *backOps;         // backend wrapped by ops
+  unsigned long long syscalls;      // as issued by i2c-dev backend
+  shm_share_s *share;
+  energy_q_s integ;
+  FILE *out;                        // JSON output sink, /dev/null
+  ts_clock_s clk;
+  ts_fmt_s tsFmt;
+  volatile double sink;             // keeps conversions from being elided
+} bench_ctx_s;
+
+typedef int (*bench_fn)(bench_ctx_s *ctx, long nops);
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+static bench_ctx_s *countCtx;       // context of counting ops
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+static int cnt_read_word(i2c_transport_s *t, const unsigned char *reg,
+			 char *word);
+static int cnt_write_word(i2c_transport_s *t, const unsigned char *reg,
+			  short word);
+static int cnt_read_words(i2c_transport_s *t, const unsigned char *regs,
+			  char (*words)[2], int nregs);
+
+static int b_read_word(bench_ctx_s *ctx, long nops);
+static int b_write_word(bench_ctx_s *ctx, long nops);
+static int b_read_words(bench_ctx_s *ctx, long nops);
+static int b_read_words_timed(bench_ctx_s *ctx, long nops);
+static int b_conv_macros(bench_ctx_s *ctx, long nops);
+static int b_meas_convert(bench_ctx_s *ctx, long nops);
+static int b_curr_time(bench_ctx_s *ctx, long nops);
+static int b_ts_format(bench_ctx_s *ctx, long nops);
+static int b_json_log(bench_ctx_s *ctx, long nops);
+static int b_rollup_add(bench_ctx_s *ctx, long nops);
+static int b_sample_regs(bench_ctx_s *ctx, long nops);
+static int b_sample_rdwr(bench_ctx_s *ctx, long nops);
+
+static double bench_run(const char *name, bench_fn fn, bench_ctx_s *ctx,
+			long nops, int runs);
+static int cmp_double(const void *a, const void *b);
+static const char *rate_json(double ns, char *buf, size_t len);
+
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+#ifdef SELF
+int main(int argc, char *argv[])
+{
+  static bench_ctx_s ctx;
+  const char *devSpec = BENCH_DEV_DEF;
+  unsigned short confRegVal;
+  double nsRegs, nsRdwr;
+  char rateRegs[32], rateRdwr[32];
+  long nops = BENCH_OPS_DEF;
+  int runs = BENCH_RUNS_DEF, opt;
+
+  while ((opt = getopt(argc, argv, "n:r:")) != -1) {
+    switch (opt) {
+    case 'n':
+      nops = getLong(optarg, GN_GT_0, "ops");
+      break;
+    case 'r':
+      runs = getInt(optarg, GN_GT_0, "runs");
+      if (runs > BENCH_RUNS_MAX)
+	runs = BENCH_RUNS_MAX;
+      break;
+    default:
+      usageErr("%s [-n ops] [-r runs] [dev[@addr]]\n", argv[0]);
+    }
+  }
+  if (optind < argc)
+    devSpec = argv[optind];
+
+  if (ina_dev_parse(devSpec, &ctx.dev) == -1 || ina_dev_open(&ctx.dev) == -1)
+    errExit("open %s", devSpec);
+
+  confRegVal = setreg(shuntBusCont, SADC_Sample128, BADC_Sample128, PGA_gain8);
+  if (ina_dev_setup(&ctx.dev, confRegVal, 0x1400) == -1)
+    exit(EXIT_FAILURE);
+
+  // Count backend calls through copy of its ops
+  ctx.backOps = ctx.dev.tr.ops;
+  ctx.ops = *ctx.backOps;
+  ctx.ops.read_word = cnt_read_word;
+  ctx.ops.write_word = cnt_write_word;
+  ctx.ops.read_words = cnt_read_words;
+  ctx.dev.tr.ops = &ctx.ops;
+  countCtx = &ctx;
+
+  ctx.share = shm_share_create(1);
+  if (ctx.share == NULL)
+    errExit("shm_share_create");
+  energy_q_reset(&ctx.integ);
+  ts_clock_sync(&ctx.clk);
+  ts_fmt_init(&ctx.tsFmt, TS_MODE_LOCAL, TS_FMT_DEF, 3);
+
+  ctx.out = fopen("/dev/null", "w");
+  if (ctx.out == NULL)
+    errExit("fopen /dev/null");
+
+  printf("{ \"bench\":\"setup\", \"backend\":\"%s\", \"device\":\"%s\", \"ops\":%ld, \"runs\":%d }\n",
+	 ctx.backOps->name, devSpec, nops, runs);
+
+  bench_run("i2c_read_data_word", b_read_word, &ctx, nops, runs);
+  bench_run("i2c_write_data_word", b_write_word, &ctx, nops, runs);
+  bench_run("i2c_read_data_words", b_read_words, &ctx, nops, runs);
+  bench_run("i2c_read_data_words_timed", b_read_words_timed, &ctx, nops, runs);
+  bench_run("conv_macros", b_conv_macros, &ctx, nops, runs);
+  bench_run("meas_convert", b_meas_convert, &ctx, nops, runs);
+  bench_run("currTime", b_curr_time, &ctx, nops, runs);
+  bench_run("ts_format", b_ts_format, &ctx, nops, runs);
+  bench_run("json_log_printf", b_json_log, &ctx, nops, runs);
+  bench_run("rollup_add", b_rollup_add, &ctx, nops, runs);
+  nsRegs = bench_run("sample_per_register", b_sample_regs, &ctx, nops, runs);
+  nsRdwr = bench_run("sample_rdwr", b_sample_rdwr, &ctx, nops, runs);
+
+  // Sampler cost bounds rate, ADC can not deliver more than its limit
+  printf("{ \"bench\":\"summary\", \"max_rate_hz_per_register\":%s, \"max_rate_hz_rdwr\":%s, \"adc_limit_hz\":%ld }\n",
+	 rate_json(nsRegs, rateRegs, sizeof(rateRegs)),
+	 rate_json(nsRdwr, rateRdwr, sizeof(rateRdwr)),
+	 ina219_max_rate(confRegVal));
+
+  fclose(ctx.out);
+  i2c_tr_close(&ctx.dev.tr);
+  exit(EXIT_SUCCESS);
+}
+
+#endif // SELF
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+static int cnt_read_word(i2c_transport_s *t, const unsigned char *reg,
+			 char *word)
+{
+  countCtx->syscalls += (reg == NULL) ? 1 : SYSC_READ_WORD;
+  return countCtx->backOps->read_word(t, reg, word);
+}
+
+
+static int cnt_write_word(i2c_transport_s *t, const unsigned char *reg,
+			  short word)
+{
+  countCtx->syscalls += SYSC_WRITE_WORD;
+  return countCtx->backOps->write_word(t, reg, word);
+}
+
+
+static int cnt_read_words(i2c_transport_s *t, const unsigned char *regs,
+			  char (*words)[2], int nregs)
+{
+  countCtx->syscalls += SYSC_READ_WORDS;
+  return countCtx->backOps->read_words(t, regs, words, nregs);
+}
+
+
+static int b_read_word(bench_ctx_s *ctx, long nops)
+{
+  unsigned char reg = bus_volt_reg;
+  char word[2];
+
+  while (nops--)
+    if (i2c_tr_read_data_word(&ctx->dev.tr, &reg, word) == -1)
+      return -1;
+
+  return 0;
+}
+
+
+static int b_write_word(bench_ctx_s *ctx, long nops)
+{
+  unsigned char reg = calib_reg;
+
+  while (nops--)
+    if (i2c_tr_write_data_word(&ctx->dev.tr, &reg, 0x1400) == -1)
+      return -1;
+
+  return 0;
+}
+
+
+static int b_read_words(bench_ctx_s *ctx, long nops)
+{
+  char words[MEAS_REGS][2];
+
+  while (nops--)
+    if (i2c_tr_read_data_words(&ctx->dev.tr, measRegs, words, MEAS_REGS) == -1)
+      return -1;
+
+  return 0;
+}
+
+
+/* Same transaction with latency histogram kept, as bus worker does */
+static int b_read_words_timed(bench_ctx_s *ctx, long nops)
+{
+  int ret;
+
+  ctx->dev.tr.stats = &ctx->share->dev[0].i2c;
+  ret = b_read_words(ctx, nops);
+  ctx->dev.tr.stats = NULL;
+
+  return ret;
+}
+
+
+/* Register values sweep whole 16 bit range, negative shunt included */
+static int b_conv_macros(bench_ctx_s *ctx, long nops)
+{
+  double acc = 0.0;
+  short val;
+  long i;
+
+  for (i = 0; i < nops; i++) {
+    val = (short)(i * 40503);
+    if (sign(val) == -1)
+      acc += shuntVoltConv(complement(val));
+    else
+      acc += shuntVoltConv(val);
+    acc += busVoltConv(val) + currConv(val) + pwrConv(val);
+  }
+  ctx->sink = acc;
+
+  return 0;
+}
+
+
+static int b_meas_convert(bench_ctx_s *ctx, long nops)
+{
+  char words[MEAS_REGS][2] = { { 0x13, 0x88 }, { 0x5d, 0xc2 },
+			       { 0x18, 0x6a }, { 0x0e, 0xa6 } };
+  sample_s smp;
+  long i;
+
+  for (i = 0; i < nops; i++) {
+    words[MEAS_SHUNT][1] = (char)i;
+    meas_convert(words, i, &smp);
+    ctx->sink = smp.power;
+  }
+
+  return 0;
+}
+
+
+static int b_curr_time(bench_ctx_s *ctx, long nops)
+{
+  while (nops--)
+    if (currTime("%d/%m/%y %T") == NULL)
+      return -1;
+
+  return 0;
+}
+
+
+/* Sample timestamps 1 ms apart, as sampler at 1 kHz produces */
+static int b_ts_format(bench_ctx_s *ctx, long nops)
+{
+  char buf[TS_BUF_LEN];
+  int64_t t = meas_now_ns();
+  long i;
+
+  for (i = 0; i < nops; i++)
+    ts_format(&ctx->tsFmt, ts_mono_to_real(&ctx->clk, t + i * 1000000LL),
+	      buf, sizeof(buf));
+
+  return 0;
+}
+
+
+/* Same format as 'log' command, stdio buffered to /dev/null */
+static int b_json_log(bench_ctx_s *ctx, long nops)
+{
+  long i;
+
+  for (i = 0; i < nops; i++)
+    fprintf(ctx->out, "{\n\"log\":{ \"device\":%d, \"addr\":\"0x%02x\", \"timestamp\":\"%s\", \"voltage\":%.2f, \"current\":%.2f, \"power\":%.2f }\n}\n",
+	    0, 0x40, "16/10/26 12:00:00", 12.05 + i * 1e-6, 0.5, 6.0);
+  fflush(ctx->out);
+
+  return 0;
+}
+
+
+/* Windowed statistics of one sample, all windows and channels */
+static int b_rollup_add(bench_ctx_s *ctx, long nops)
+{
+  sample_s smp;
+  long i;
+
+  memset(&smp, 0, sizeof(smp));
+  for (i = 0; i < nops; i++) {
+    smp.tsNs = meas_now_ns();
+    smp.raw[MEAS_CURR] = (uint16_t)(1000 + (i & 0xff));
+    rollup_add(&ctx->share->dev[0].rollup, &smp);
+  }
+
+  return 0;
+}
+
+
+/* Whole sample cycle as original code did it, register by register,
+ * with same accounting as sample_rdwr, so they differ by bus access only */
+static int b_sample_regs(bench_ctx_s *ctx, long nops)
+{
+  char words[MEAS_REGS][2];
+  sample_s smp;
+  long i;
+  int r;
+
+  for (i = 0; i < nops; i++) {
+    for (r = 0; r < MEAS_REGS; r++)
+      if (i2c_tr_read_data_word(&ctx->dev.tr, &measRegs[r], words[r]) == -1)
+	return -1;
+    meas_decode(words, meas_now_ns(), &smp);
+    ring_publish(&ctx->share->dev[0].ring, &smp);
+    sampler_account(&ctx->share->dev[0], &ctx->integ, &smp, 0);
+  }
+
+  return 0;
+}
+
+
+/* Whole sample cycle of sampler worker, one combined transaction */
+static int b_sample_rdwr(bench_ctx_s *ctx, long nops)
+{
+  char words[MEAS_REGS][2];
+  sample_s smp;
+  long i;
+
+  for (i = 0; i < nops; i++) {
+    if (i2c_tr_read_data_words(&ctx->dev.tr, measRegs, words, MEAS_REGS) == -1)
+      return -1;
+    meas_decode(words, meas_now_ns(), &smp);
+    ring_publish(&ctx->share->dev[0].ring, &smp);
+    sampler_account(&ctx->share->dev[0], &ctx->integ, &smp, 0);
+  }
+
+  return 0;
+}
+
+
+/* @func  bench_run - time benchmark over several runs after warm-up,
+ *                    print JSON line with median and best run
+ * @return median ns per operation, 0.0 on error
+ */
+static double bench_run(const char *name, bench_fn fn, bench_ctx_s *ctx,
+			long nops, int runs)
+{
+  double ns[BENCH_RUNS_MAX];
+  struct timespec t0, t1;
+  unsigned long long sysc;
+  int i;
+
+  // Warm-up fills caches and faults in pages
+  if (fn(ctx, nops / 10 + 1) == -1)
+    goto fail;
+
+  ctx->syscalls = 0;
+  for (i = 0; i < runs; i++) {
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (fn(ctx, nops) == -1)
+      goto fail;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    ns[i] = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / nops;
+  }
+  sysc = ctx->syscalls;
+
+  qsort(ns, runs, sizeof(ns[0]), cmp_double);
+  printf("{ \"bench\":\"%s\", \"ns_per_op\":%.1f, \"ns_per_op_best\":%.1f, \"syscalls_per_op\":%.2f }\n",
+	 name, ns[runs / 2], ns[0], (double)sysc / ((double)nops * runs));
+
+  return ns[runs / 2];
+
+ fail:
+  printf("{ \"bench\":\"%s\", \"error\":\"%s\" }\n", name, strerror(errno));
+  return 0.0;
+}
+
+
+static int cmp_double(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
+
+
+/* @func  rate_json - rate of sample cycle as JSON value, null when its
+ *                    benchmark failed
+ * @param double ns - median ns per sample, 0.0 of failed benchmark
+ */
+static const char *rate_json(double ns, char *buf, size_t len)
+{
+  if (ns > 0.0)
+    snprintf(buf, len, "%.0f", 1e9 / ns);
+  else
+    snprintf(buf, len, "null");
+
+  return buf;
+}
+
+
+/****************************************************************/
+/**************** Global Functions Definitions ******************/
+/****************************************************************/
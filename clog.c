@@ -0,0 +1,967 @@
+/*****************************************************************
+ * Title    : clog.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Source file of compressed sample log. Logger process
+ *            only copies samples into per-device blocks, encoder thread
+ *            codes full blocks and writes them with their index entry,
+ *            so neither sampler nor logger waits for encoding. Torn
+ *            block at end of file is cut and index caught up on reopen
+ * Version  : 1.00
+ * Options  : SELF build dumps log file: <file>
+ *            or writes and verifies steady LED load: -t <file> [samples]
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+
+//#define SELF
+//#define DEBUG
+//#define PRINT
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../header/tlpi_hdr.h"
+#include "clog.h"
+#ifdef SELF
+#include "../header/INA219.h"
+#endif // SELF
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+#define CLOG_LEN_MAX   (CLOG_BLOCK_SAMPLES * CLOG_SMP_MAX)
+
+_Static_assert(sizeof(clog_hdr_s) == 24, "clog_hdr_s layout changed");
+_Static_assert(sizeof(clog_blk_s) == 48, "clog_blk_s layout changed");
+_Static_assert(sizeof(clog_idx_s) == 32, "clog_idx_s layout changed");
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+static inline uint64_t clog_zz(int64_t v);
+static inline int64_t clog_unzz(uint64_t u);
+static inline uint8_t *clog_put_varint(uint8_t *p, uint64_t v);
+static inline int clog_get_varint(const uint8_t **p, const uint8_t *end,
+				  uint64_t *v);
+static uint32_t clog_blk_crc(const clog_blk_s *blk, const uint8_t *in);
+static void clog_hdr_init(clog_hdr_s *hdr, const char *magic);
+static int clog_hdr_ok(const clog_hdr_s *hdr, const char *magic);
+static int clog_read_blk(int fd, uint64_t off, uint64_t size,
+			 clog_blk_s *blk, uint8_t *buf);
+static int clog_idx_append(int fd, const clog_blk_s *blk, uint64_t off);
+static int clog_recover(clog_writer_s *w, uint64_t size);
+static clog_raw_s *clog_take(clog_writer_s *w, int dev);
+static void clog_queue(clog_writer_s *w, clog_raw_s *r);
+static ssize_t clog_put_block(clog_writer_s *w, const clog_raw_s *r);
+static void *clog_thread(void *arg);
+#ifdef SELF
+static void self_sample(long i, uint32_t *seed, sample_s *smp);
+static int self_test(const char *path, long n);
+#endif // SELF
+
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+#ifdef SELF
+int main(int argc, char *argv[])
+{
+  static log_rec_s recs[CLOG_BLOCK_SAMPLES];
+  clog_map_s m;
+  const clog_blk_s *blk;
+  const log_rec_s *rec;
+  uint64_t off;
+  size_t nblk = 0, nsmp = 0, bad = 0;
+  int i, n;
+
+  if (argc < 2 || strcmp(argv[1], "--help") == 0)
+    usageErr("%s <compressed log file> | -t <file> [samples]\n", argv[0]);
+
+  if (strcmp(argv[1], "-t") == 0) {
+    if (argc < 3)
+      usageErr("%s -t <file> [samples]\n", argv[0]);
+    exit(self_test(argv[2], (argc > 3)
+		   ? getLong(argv[3], GN_GT_0, "samples") : 600000)
+	 == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  if (clog_map(argv[1], &m) == -1)
+    errExit("clog_map %s", argv[1]);
+
+  printf("ts_ns,dev,seq,flags,shunt,bus,current,power\n");
+  for (off = sizeof(clog_hdr_s); off < m.size; off = clog_next(&m, off)) {
+    if ((blk = clog_block(&m, off)) == NULL) {
+      bad++;
+      break;
+    }
+    n = clog_decode(blk, (const uint8_t *)(blk + 1), m.hdr->tsQuantNs, recs);
+    if (n == -1) {
+      bad++;
+      continue;
+    }
+    nblk++;
+    for (i = 0; i < n; i++) {
+      rec = &recs[i];
+      if (rec->dev == LOG_DEV_SESSION) {
+	printf("# session realtime %lld ns\n",
+	       (long long)log_session_realtime(rec));
+	continue;
+      }
+      nsmp++;
+      printf("%lld,%u,%u,0x%02x,0x%04x,0x%04x,0x%04x,0x%04x\n",
+	     (long long)rec->tsNs, rec->dev, rec->seq, rec->flags,
+	     rec->raw[MEAS_SHUNT], rec->raw[MEAS_BUS],
+	     rec->raw[MEAS_CURR], rec->raw[MEAS_POWER]);
+    }
+  }
+  fprintf(stderr, "%zu blocks, %zu samples, %zu bad, %zu indexed, "
+	  "%.2f bytes/sample, %.1fx smaller than -l log\n",
+	  nblk, nsmp, bad, m.nidx,
+	  nsmp ? (double)m.size / nsmp : 0.0,
+	  m.size ? (double)nsmp * sizeof(log_rec_s) / m.size : 0.0);
+
+  clog_unmap(&m);
+  exit(EXIT_SUCCESS);
+}
+
+#endif // SELF
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+/* @func  clog_zz - zig-zag map, small magnitudes of either sign give
+ *                  small codes: 0, -1, 1, -2 ... -> 0, 1, 2, 3 ...
+ */
+static inline uint64_t clog_zz(int64_t v)
+{
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+
+static inline int64_t clog_unzz(uint64_t u)
+{
+  return (int64_t)((u >> 1) ^ -(u & 1));
+}
+
+
+/* @func  clog_put_varint - store 7 bits per byte, low first, high bit
+ *                          set while more bytes follow
+ * @return position after stored value
+ */
+static inline uint8_t *clog_put_varint(uint8_t *p, uint64_t v)
+{
+  while (v >= 0x80) {
+    *p++ = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  *p++ = (uint8_t)v;
+
+  return p;
+}
+
+
+/* @func  clog_get_varint - load value stored by clog_put_varint()
+ * @return SUCCESS         - 0, *p moved past value
+ *         ERROR           - -1, value runs past end or 64 bits
+ */
+static inline int clog_get_varint(const uint8_t **p, const uint8_t *end,
+				  uint64_t *v)
+{
+  const uint8_t *q = *p;
+  uint64_t r = 0;
+  int shift;
+
+  for (shift = 0; shift < 64 && q < end; shift += 7) {
+    r |= (uint64_t)(*q & 0x7f) << shift;
+    if (!(*q++ & 0x80)) {
+      *p = q;
+      *v = r;
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+
+/* @func  clog_blk_crc - checksum of block header and its coded samples */
+static uint32_t clog_blk_crc(const clog_blk_s *blk, const uint8_t *in)
+{
+  return log_crc32(log_crc32(0, blk, offsetof(clog_blk_s, crc)),
+		   in, blk->len);
+}
+
+
+static void clog_hdr_init(clog_hdr_s *hdr, const char *magic)
+{
+  memset(hdr, 0, sizeof(*hdr));
+  memcpy(hdr->magic, magic, LOG_MAGIC_LEN);
+  hdr->version = CLOG_VERSION;
+  hdr->blockSamples = CLOG_BLOCK_SAMPLES;
+  hdr->tsQuantNs = CLOG_TS_QUANT_NS;
+  hdr->crc = log_crc32(0, hdr, offsetof(clog_hdr_s, crc));
+}
+
+
+/* @func  clog_hdr_ok - verify header of log or index file
+ * @return 1 valid, 0 not file of magic or corrupted
+ */
+static int clog_hdr_ok(const clog_hdr_s *hdr, const char *magic)
+{
+  return memcmp(hdr->magic, magic, LOG_MAGIC_LEN) == 0
+    && hdr->version == CLOG_VERSION && hdr->tsQuantNs > 0
+    && hdr->crc == log_crc32(0, hdr, offsetof(clog_hdr_s, crc));
+}
+
+
+/* @func  clog_read_blk - read and verify block at off of open log
+ * @param uint64_t size    - size of log file
+ * @param uint8_t *buf     - coded samples, CLOG_LEN_MAX bytes
+ * @return SUCCESS         - 0
+ *         ERROR           - -1, no whole valid block at off
+ */
+static int clog_read_blk(int fd, uint64_t off, uint64_t size,
+			 clog_blk_s *blk, uint8_t *buf)
+{
+  if (off + sizeof(*blk) > size
+      || pread(fd, blk, sizeof(*blk), off) != sizeof(*blk)
+      || blk->magic != CLOG_BLK_MAGIC || blk->len > CLOG_LEN_MAX
+      || off + clogBlkSize(blk->len) > size
+      || pread(fd, buf, blk->len, off + sizeof(*blk)) != (ssize_t)blk->len
+      || blk->crc != clog_blk_crc(blk, buf))
+    return -1;
+
+  return 0;
+}
+
+
+static int clog_idx_append(int fd, const clog_blk_s *blk, uint64_t off)
+{
+  clog_idx_s e;
+
+  memset(&e, 0, sizeof(e));
+  e.off = off;
+  e.tsNs = blk->tsNs;
+  e.lastTsNs = blk->lastTsNs;
+  e.n = blk->n;
+  e.dev = blk->dev;
+  e.crc = log_crc32(0, &e, offsetof(clog_idx_s, crc));
+
+  return log_write_all(fd, &e, sizeof(e));
+}
+
+
+/* @func  clog_recover - find end of whole blocks, starting past last
+ *                       indexed one. Blocks written after it get their
+ *                       entries, torn block after them is cut. Invalid
+ *                       index file is rebuilt from start of log
+ * @param uint64_t size    - size of log file
+ * @return SUCCESS         - 0, w->off set to end of log
+ *         ERROR           - -1, errno set appropriately
+ */
+static int clog_recover(clog_writer_s *w, uint64_t size)
+{
+  clog_hdr_s hdr;
+  clog_idx_s e;
+  clog_blk_s blk;
+  struct stat sb;
+  uint64_t off = sizeof(clog_hdr_s);
+  off_t n = 0;
+
+  if (fstat(w->idxFd, &sb) == -1)
+    return -1;
+
+  if ((size_t)sb.st_size >= sizeof(hdr)
+      && pread(w->idxFd, &hdr, sizeof(hdr), 0) == sizeof(hdr)
+      && clog_hdr_ok(&hdr, CLOG_IDX_MAGIC)) {
+    // Entry failing checksum or not matching block is rewritten by scan
+    for (n = (sb.st_size - sizeof(hdr)) / sizeof(e); n > 0; n--) {
+      if (pread(w->idxFd, &e, sizeof(e), sizeof(hdr) + (n - 1) * sizeof(e))
+	  == sizeof(e)
+	  && e.crc == log_crc32(0, &e, offsetof(clog_idx_s, crc))
+	  && clog_read_blk(w->fd, e.off, size, &blk, w->buf) == 0
+	  && blk.tsNs == e.tsNs && blk.dev == e.dev) {
+	off = e.off + clogBlkSize(blk.len);
+	break;
+      }
+    }
+    if (ftruncate(w->idxFd, sizeof(hdr) + n * sizeof(e)) == -1)
+      return -1;
+  }
+  else {
+    clog_hdr_init(&hdr, CLOG_IDX_MAGIC);
+    if (ftruncate(w->idxFd, 0) == -1
+	|| log_write_all(w->idxFd, &hdr, sizeof(hdr)) == -1)
+      return -1;
+  }
+
+  while (clog_read_blk(w->fd, off, size, &blk, w->buf) == 0) {
+    if (clog_idx_append(w->idxFd, &blk, off) == -1)
+      return -1;
+    off += clogBlkSize(blk.len);
+  }
+  if (off < size && ftruncate(w->fd, off) == -1)
+    return -1;
+  w->off = off;
+
+  return 0;
+}
+
+
+/* @func  clog_take - get empty block, wait for encoder when all are
+ *                    queued. Only logger waits, samplers never do
+ */
+static clog_raw_s *clog_take(clog_writer_s *w, int dev)
+{
+  clog_raw_s *r;
+
+  pthread_mutex_lock(&w->lock);
+  while (w->nfree == 0)
+    pthread_cond_wait(&w->done, &w->lock);
+  r = w->free[--w->nfree];
+  pthread_mutex_unlock(&w->lock);
+
+  r->dev = dev;
+  r->n = 0;
+
+  return r;
+}
+
+
+static void clog_queue(clog_writer_s *w, clog_raw_s *r)
+{
+  pthread_mutex_lock(&w->lock);
+  w->queue[(w->qhead + w->qlen++) % CLOG_POOL] = r;
+  pthread_cond_signal(&w->ready);
+  pthread_mutex_unlock(&w->lock);
+}
+
+
+/* @func  clog_put_block - encode block, write it and its index entry
+ * @return SUCCESS         - bytes written to log
+ *         ERROR           - -1, partial block cut, samples are lost
+ */
+static ssize_t clog_put_block(clog_writer_s *w, const clog_raw_s *r)
+{
+  clog_blk_s blk;
+  size_t len, size;
+
+  len = clog_encode(r, CLOG_TS_QUANT_NS, &blk, w->buf);
+  size = clogBlkSize(len);
+  memset(w->buf + len, 0, size - sizeof(blk) - len);
+
+  if (log_write_all(w->fd, &blk, sizeof(blk)) == -1
+      || log_write_all(w->fd, w->buf, size - sizeof(blk)) == -1) {
+    // Next block must follow whole ones, reopen would cut it otherwise
+    if (ftruncate(w->fd, w->off) == -1)
+      fprintf(stderr, "{ \"WARN\":\"clog ftruncate\" } errno: %s\n",
+	      strerror(errno));
+    return -1;
+  }
+
+  // Missing entry is restored on reopen, block itself is safe
+  clog_idx_append(w->idxFd, &blk, w->off);
+  w->off += size;
+
+  return size;
+}
+
+
+/* @func  clog_thread - encoder thread, writes queued blocks in order
+ *                      until stop is requested and queue is empty
+ */
+static void *clog_thread(void *arg)
+{
+  clog_writer_s *w = arg;
+  clog_raw_s *r;
+  struct timespec lastSync, now;
+  ssize_t size;
+
+  clock_gettime(CLOCK_MONOTONIC, &lastSync);
+
+  pthread_mutex_lock(&w->lock);
+  for (;;) {
+    while (w->qlen == 0 && !w->stop)
+      pthread_cond_wait(&w->ready, &w->lock);
+    if (w->qlen == 0)
+      break;
+    r = w->queue[w->qhead];
+    w->qhead = (w->qhead + 1) % CLOG_POOL;
+    w->qlen--;
+    pthread_mutex_unlock(&w->lock);
+
+    size = clog_put_block(w, r);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (now.tv_sec - lastSync.tv_sec >= LOG_SYNC_SEC) {
+      fdatasync(w->fd);
+      fdatasync(w->idxFd);
+      lastSync = now;
+    }
+
+    pthread_mutex_lock(&w->lock);
+    if (size == -1)
+      w->lost += r->n;
+    else {
+      w->written += r->n;
+      w->bytes += size;
+    }
+    w->free[w->nfree++] = r;
+    pthread_cond_signal(&w->done);
+  }
+  pthread_mutex_unlock(&w->lock);
+
+  return NULL;
+}
+
+
+#ifdef SELF
+/* @func  self_sample - 1 kHz reading of LED driver on 12 V, 0.35 A
+ *                      through 0.1 ohm shunt, with wakeup jitter of
+ *                      +-30 us and noise of few LSB
+ */
+static void self_sample(long i, uint32_t *seed, sample_s *smp)
+{
+  long shunt, mv, current;
+
+  *seed = *seed * 1103515245U + 12345U;
+  shunt = 3500 + (long)(*seed >> 16) % 5 - 2;
+  *seed = *seed * 1103515245U + 12345U;
+  mv = 12000 + ((*seed >> 16) % 8 == 0 ? 4 : 0);
+  *seed = *seed * 1103515245U + 12345U;
+
+  memset(smp, 0, sizeof(*smp));
+  smp->tsNs = 1000000000LL + i * 1000000LL
+    + (int64_t)((*seed >> 16) % 60001) - 30000;
+  current = shunt;                    // calibration 4096
+  smp->raw[MEAS_SHUNT] = (uint16_t)shunt;
+  smp->raw[MEAS_BUS] = (uint16_t)((mv / 4) << 3 | CNVR);
+  smp->raw[MEAS_CURR] = (uint16_t)current;
+  smp->raw[MEAS_POWER] = (uint16_t)(current * (mv / 4) / 5000);
+}
+
+
+/* @func  self_test - write n samples through writer thread, map file
+ *                    and compare decoded samples with originals
+ * @return 0 round trip exact up to timestamp quantum, -1 otherwise
+ */
+static int self_test(const char *path, long n)
+{
+  static clog_writer_s w;             // pool is too big for stack
+  static log_rec_s recs[CLOG_BLOCK_SAMPLES];
+  char idxPath[PATH_MAX];
+  clog_map_s m;
+  const clog_blk_s *blk;
+  sample_s smp;
+  uint64_t off;
+  uint32_t seed = 1;
+  long i = 0, bad = 0;
+  int k, cnt;
+
+  snprintf(idxPath, sizeof(idxPath), "%s%s", path, CLOG_IDX_SUFFIX);
+  unlink(path);
+  unlink(idxPath);
+
+  if (clog_open(&w, path) == -1)
+    errExit("clog_open %s", path);
+  for (i = 0; i < n; i++) {
+    self_sample(i, &seed, &smp);
+    clog_append(&w, 0, i, &smp);
+  }
+  if (clog_close(&w) == -1)
+    errExit("clog_close %s", path);
+
+  if (clog_map(path, &m) == -1)
+    errExit("clog_map %s", path);
+  seed = 1;
+  i = 0;
+  for (off = sizeof(clog_hdr_s); off < m.size; off = clog_next(&m, off)) {
+    if ((blk = clog_block(&m, off)) == NULL) {
+      bad++;
+      break;
+    }
+    cnt = clog_decode(blk, (const uint8_t *)(blk + 1), m.hdr->tsQuantNs,
+		      recs);
+    if (cnt == -1) {
+      bad++;
+      continue;
+    }
+    if (blk->dev == LOG_DEV_SESSION)
+      continue;
+    for (k = 0; k < cnt; k++, i++) {
+      self_sample(i, &seed, &smp);
+      if (llabs(recs[k].tsNs - smp.tsNs) >= (long long)m.hdr->tsQuantNs
+	  || memcmp(recs[k].raw, smp.raw, sizeof(smp.raw)) != 0
+	  || recs[k].seq != (uint16_t)i || !log_rec_valid(&recs[k]))
+	bad++;
+    }
+  }
+
+  printf("%ld samples, %ld bad, %zu blocks indexed, %zu bytes, "
+	 "%.2f bytes/sample, %.1fx smaller than -l log\n",
+	 i, bad, m.nidx, m.size, (double)m.size / n,
+	 (double)n * sizeof(log_rec_s) / m.size);
+  clog_unmap(&m);
+
+  return (bad == 0 && i == n) ? 0 : -1;
+}
+#endif // SELF
+
+
+/****************************************************************/
+/**************** Global Functions Definitions ******************/
+/****************************************************************/
+
+/* @func  clog_encode - code samples of block, first one goes to header
+ * @param const clog_raw_s *r - samples, at least one
+ * @param uint32_t quantNs    - timestamp quantum
+ * @param clog_blk_s *blk     - header to fill, checksum included
+ * @param uint8_t *out        - coded samples, CLOG_SMP_MAX per sample
+ * @return bytes of coded samples
+ */
+size_t clog_encode(const clog_raw_s *r, uint32_t quantNs,
+		   clog_blk_s *blk, uint8_t *out)
+{
+  uint8_t *p = out, *ctrl;
+  uint64_t zz[MEAS_REGS];
+  int64_t q, prevQ, dq, prevDq = 0;
+  uint16_t step;
+  int i, k, nch, small;
+
+  memset(blk, 0, sizeof(*blk));
+  blk->magic = CLOG_BLK_MAGIC;
+  blk->tsNs = r->tsNs[0];
+  blk->lastTsNs = r->tsNs[r->n - 1];
+  memcpy(blk->raw, r->raw[0], sizeof(blk->raw));
+  blk->seq = r->seq[0];
+  blk->n = (uint16_t)r->n;
+  blk->dev = (uint8_t)r->dev;
+  blk->flags = r->flags[0];
+
+  prevQ = r->tsNs[0] / quantNs;
+  for (i = 1; i < r->n; i++) {
+    ctrl = p++;
+    *ctrl = 0;
+
+    nch = 0;
+    small = 1;
+    for (k = 0; k < MEAS_REGS; k++)
+      if (r->raw[i][k] != r->raw[i - 1][k]) {
+	*ctrl |= 1 << k;
+	zz[nch] = clog_zz((int16_t)(r->raw[i][k] - r->raw[i - 1][k]));
+	if (zz[nch++] > 0xf)
+	  small = 0;
+      }
+    if (nch > 0 && small)
+      *ctrl |= CLOG_C_NIBBLE;
+    if (r->flags[i] != r->flags[i - 1])
+      *ctrl |= CLOG_C_FLAGS;
+    step = (uint16_t)(r->seq[i] - r->seq[i - 1]);
+    if (step != 1)
+      *ctrl |= CLOG_C_SEQ;
+
+    // Steady rate makes delta-of-delta mere wakeup jitter
+    q = r->tsNs[i] / quantNs;
+    dq = q - prevQ;
+    p = clog_put_varint(p, clog_zz(dq - prevDq));
+    prevQ = q;
+    prevDq = dq;
+
+    if (*ctrl & CLOG_C_NIBBLE)
+      for (k = 0; k < nch; k += 2)
+	*p++ = (uint8_t)(zz[k] | ((k + 1 < nch) ? zz[k + 1] << 4 : 0));
+    else
+      for (k = 0; k < nch; k++)
+	p = clog_put_varint(p, zz[k]);
+    if (*ctrl & CLOG_C_FLAGS)
+      *p++ = r->flags[i];
+    if (*ctrl & CLOG_C_SEQ)
+      p = clog_put_varint(p, step);
+  }
+
+  blk->len = (uint32_t)(p - out);
+  blk->crc = clog_blk_crc(blk, out);
+
+  return blk->len;
+}
+
+
+/* @func  clog_decode - decode block into records of raw log, checksums
+ *                      of records included
+ * @param const uint8_t *in   - coded samples, blk->len bytes
+ * @param uint32_t quantNs    - timestamp quantum of file
+ * @param log_rec_s *recs     - CLOG_BLOCK_SAMPLES records
+ * @return SUCCESS            - number of samples
+ *         ERROR              - -1, block malformed
+ */
+int clog_decode(const clog_blk_s *blk, const uint8_t *in, uint32_t quantNs,
+		log_rec_s *recs)
+{
+  const uint8_t *p = in, *end = in + blk->len;
+  log_rec_s *rec = recs;
+  uint64_t u, zz[MEAS_REGS];
+  int64_t q, dq = 0;
+  uint8_t ctrl;
+  int i, k, j, nch;
+
+  if (blk->n == 0 || blk->n > CLOG_BLOCK_SAMPLES || quantNs == 0)
+    return -1;
+
+  rec->tsNs = blk->tsNs;
+  memcpy(rec->raw, blk->raw, sizeof(rec->raw));
+  rec->seq = blk->seq;
+  rec->dev = blk->dev;
+  rec->flags = blk->flags;
+  rec->crc = log_crc32(0, rec, offsetof(log_rec_s, crc));
+
+  q = blk->tsNs / quantNs;
+  for (i = 1; i < blk->n; i++) {
+    rec[1] = rec[0];
+    rec++;
+    if (p == end || (*p & 0x80))
+      return -1;
+    ctrl = *p++;
+
+    if (clog_get_varint(&p, end, &u) == -1)
+      return -1;
+    dq += clog_unzz(u);
+    q += dq;
+    rec->tsNs = q * quantNs;
+
+    for (k = nch = 0; k < MEAS_REGS; k++)
+      nch += (ctrl >> k) & 1;
+    if (ctrl & CLOG_C_NIBBLE)
+      for (j = 0; j < nch; j += 2) {
+	if (p == end)
+	  return -1;
+	zz[j] = *p & 0xf;
+	zz[j + 1] = *p++ >> 4;
+      }
+    else
+      for (j = 0; j < nch; j++)
+	if (clog_get_varint(&p, end, &zz[j]) == -1 || zz[j] > 0xffff)
+	  return -1;
+    for (k = j = 0; k < MEAS_REGS; k++)
+      if (ctrl & (1 << k))
+	rec->raw[k] = (uint16_t)(rec->raw[k] + clog_unzz(zz[j++]));
+
+    if (ctrl & CLOG_C_FLAGS) {
+      if (p == end)
+	return -1;
+      rec->flags = *p++;
+    }
+    if (ctrl & CLOG_C_SEQ) {
+      if (clog_get_varint(&p, end, &u) == -1)
+	return -1;
+      rec->seq = (uint16_t)(rec->seq + u);
+    }
+    else
+      rec->seq++;
+
+    rec->crc = log_crc32(0, rec, offsetof(log_rec_s, crc));
+  }
+
+  return (p == end) ? blk->n : -1;
+}
+
+
+/* @func  clog_open - open compressed log and its index for appending,
+ *                    create them when new, recover them when not, then
+ *                    start encoder thread and log session record
+ * @param clog_writer_s *w - writer to initialize
+ * @param const char *path - log file, index is path CLOG_IDX_SUFFIX
+ * @return SUCCESS         - 0
+ *         ERROR           - -1, errno set appropriately (EINVAL when
+ *                           file is not compressed log of this build)
+ */
+int clog_open(clog_writer_s *w, const char *path)
+{
+  char idxPath[PATH_MAX];
+  clog_hdr_s hdr;
+  struct stat sb;
+  sample_s smp;
+  int i, err;
+
+  memset(w, 0, sizeof(*w));
+  w->idxFd = -1;
+
+  if (snprintf(idxPath, sizeof(idxPath), "%s%s", path, CLOG_IDX_SUFFIX)
+      >= (int)sizeof(idxPath)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  w->fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (w->fd == -1)
+    return -1;
+  w->idxFd = open(idxPath, O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (w->idxFd == -1 || fstat(w->fd, &sb) == -1)
+    goto fail;
+
+  if (sb.st_size == 0) {
+    clog_hdr_init(&hdr, CLOG_MAGIC);
+    if (log_write_all(w->fd, &hdr, sizeof(hdr)) == -1)
+      goto fail;
+    sb.st_size = sizeof(hdr);
+  }
+  else if (pread(w->fd, &hdr, sizeof(hdr), 0) != sizeof(hdr)
+	   || !clog_hdr_ok(&hdr, CLOG_MAGIC)
+	   || hdr.tsQuantNs != CLOG_TS_QUANT_NS) {
+    errno = EINVAL;
+    goto fail;
+  }
+  if (clog_recover(w, sb.st_size) == -1)
+    goto fail;
+
+  for (i = 0; i < CLOG_POOL; i++)
+    w->free[i] = &w->pool[i];
+  w->nfree = CLOG_POOL;
+  pthread_mutex_init(&w->lock, NULL);
+  pthread_cond_init(&w->ready, NULL);
+  pthread_cond_init(&w->done, NULL);
+  if ((err = pthread_create(&w->thread, NULL, clog_thread, w)) != 0) {
+    errno = err;
+    goto fail;
+  }
+
+  log_session_sample(&smp);
+  return clog_append(w, LOG_DEV_SESSION, 0, &smp);
+
+ fail:
+  err = errno;
+  close(w->fd);
+  if (w->idxFd != -1)
+    close(w->idxFd);
+  w->fd = w->idxFd = -1;
+  errno = err;
+  return -1;
+}
+
+
+/* @func  clog_append - add sample to block of its device, full block
+ *                      goes to encoder. Session record is block alone
+ * @param int dev          - device index or LOG_DEV_SESSION
+ * @param uint64_t seq     - ring index of sample
+ * @param const sample_s *smp - sample
+ * @return SUCCESS         - 0
+ *         ERROR           - -1, errno EINVAL, dev out of range
+ */
+int clog_append(clog_writer_s *w, int dev, uint64_t seq, const sample_s *smp)
+{
+  clog_raw_s *r;
+  int i;
+
+  if (dev == LOG_DEV_SESSION)
+    r = clog_take(w, dev);
+  else if (dev >= 0 && dev < INA_MAX_DEVS) {
+    if (w->cur[dev] == NULL)
+      w->cur[dev] = clog_take(w, dev);
+    r = w->cur[dev];
+  }
+  else {
+    errno = EINVAL;
+    return -1;
+  }
+
+  i = r->n++;
+  r->tsNs[i] = smp->tsNs;
+  memcpy(r->raw[i], smp->raw, sizeof(r->raw[i]));
+  r->seq[i] = (uint16_t)seq;
+  r->flags[i] = (uint8_t)smp->flags;
+
+  if (dev == LOG_DEV_SESSION || r->n == CLOG_BLOCK_SAMPLES) {
+    if (dev != LOG_DEV_SESSION)
+      w->cur[dev] = NULL;
+    clog_queue(w, r);
+  }
+
+  return 0;
+}
+
+
+/* @func  clog_tick - pass partial blocks older than CLOG_BLOCK_NS to
+ *                    encoder, slow sampling still reaches file
+ * @param int64_t nowNs    - CLOCK_MONOTONIC time
+ */
+void clog_tick(clog_writer_s *w, int64_t nowNs)
+{
+  int d;
+
+  for (d = 0; d < INA_MAX_DEVS; d++)
+    if (w->cur[d] != NULL && w->cur[d]->n > 0
+	&& nowNs - w->cur[d]->tsNs[0] >= CLOG_BLOCK_NS) {
+      clog_queue(w, w->cur[d]);
+      w->cur[d] = NULL;
+    }
+}
+
+
+/* @func  clog_close - write partial blocks, stop encoder thread, sync
+ *                     and close log and index
+ */
+int clog_close(clog_writer_s *w)
+{
+  int d, ret = 0;
+
+  for (d = 0; d < INA_MAX_DEVS; d++)
+    if (w->cur[d] != NULL) {
+      if (w->cur[d]->n > 0)
+	clog_queue(w, w->cur[d]);
+      w->cur[d] = NULL;
+    }
+
+  pthread_mutex_lock(&w->lock);
+  w->stop = 1;
+  pthread_cond_signal(&w->ready);
+  pthread_mutex_unlock(&w->lock);
+  pthread_join(w->thread, NULL);
+
+  pthread_cond_destroy(&w->done);
+  pthread_cond_destroy(&w->ready);
+  pthread_mutex_destroy(&w->lock);
+
+  if (fdatasync(w->fd) == -1 || fdatasync(w->idxFd) == -1)
+    ret = -1;
+  if (close(w->fd) == -1)
+    ret = -1;
+  if (close(w->idxFd) == -1)
+    ret = -1;
+  w->fd = w->idxFd = -1;
+
+  return ret;
+}
+
+
+/* @func  clog_map - map compressed log read-only, with its index when
+ *                   valid one exists
+ * @param const char *path - log file
+ * @param clog_map_s *m    - mapping to fill
+ * @return SUCCESS         - 0
+ *         ERROR           - -1, errno set appropriately
+ */
+int clog_map(const char *path, clog_map_s *m)
+{
+  char idxPath[PATH_MAX];
+  struct stat sb;
+  int fd;
+
+  memset(m, 0, sizeof(*m));
+
+  fd = open(path, O_RDONLY);
+  if (fd == -1)
+    return -1;
+  if (fstat(fd, &sb) == -1) {
+    close(fd);
+    return -1;
+  }
+  if ((size_t)sb.st_size < sizeof(clog_hdr_s)) {
+    close(fd);
+    errno = EINVAL;
+    return -1;
+  }
+
+  m->base = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (m->base == MAP_FAILED)
+    return -1;
+  m->size = sb.st_size;
+
+  m->hdr = m->base;
+  if (!clog_hdr_ok(m->hdr, CLOG_MAGIC)) {
+    clog_unmap(m);
+    errno = EINVAL;
+    return -1;
+  }
+  madvise(m->base, m->size, MADV_SEQUENTIAL);
+
+  // Index only speeds up seeking, log is read without it
+  if (snprintf(idxPath, sizeof(idxPath), "%s%s", path, CLOG_IDX_SUFFIX)
+      >= (int)sizeof(idxPath) || (fd = open(idxPath, O_RDONLY)) == -1)
+    return 0;
+  if (fstat(fd, &sb) == 0 && (size_t)sb.st_size >= sizeof(clog_hdr_s)) {
+    m->idxBase = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (m->idxBase == MAP_FAILED)
+      m->idxBase = NULL;
+    else {
+      m->idxSize = sb.st_size;
+      if (clog_hdr_ok(m->idxBase, CLOG_IDX_MAGIC)) {
+	m->idx = (const clog_idx_s *)((const char *)m->idxBase
+				      + sizeof(clog_hdr_s));
+	m->nidx = (m->idxSize - sizeof(clog_hdr_s)) / sizeof(clog_idx_s);
+      }
+    }
+  }
+  close(fd);
+
+  return 0;
+}
+
+
+/* @func  clog_unmap - release mappings of log and index */
+void clog_unmap(clog_map_s *m)
+{
+  if (m->base != NULL && m->base != MAP_FAILED)
+    munmap(m->base, m->size);
+  if (m->idxBase != NULL)
+    munmap(m->idxBase, m->idxSize);
+  memset(m, 0, sizeof(*m));
+}
+
+
+/* @func  clog_block - verified block at file offset off, first one is
+ *                     at sizeof(clog_hdr_s), offsets also from index
+ * @return block header, coded samples follow it; NULL when off holds
+ *         no whole valid block
+ */
+const clog_blk_s *clog_block(const clog_map_s *m, uint64_t off)
+{
+  const clog_blk_s *blk;
+
+  if (off % CLOG_ALIGN != 0 || off < sizeof(clog_hdr_s)
+      || off + sizeof(*blk) > m->size)
+    return NULL;
+
+  blk = (const clog_blk_s *)((const char *)m->base + off);
+  if (blk->magic != CLOG_BLK_MAGIC || blk->len > CLOG_LEN_MAX
+      || off + clogBlkSize(blk->len) > m->size
+      || blk->crc != clog_blk_crc(blk, (const uint8_t *)(blk + 1)))
+    return NULL;
+
+  return blk;
+}
+
+
+/* @func  clog_next - offset of block following valid block at off */
+uint64_t clog_next(const clog_map_s *m, uint64_t off)
+{
+  const clog_blk_s *blk = (const clog_blk_s *)((const char *)m->base + off);
+
+  return off + clogBlkSize(blk->len);
+}
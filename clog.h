@@ -0,0 +1,165 @@
+/*****************************************************************
+ * Title    : clog.h
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Header file of compressed sample log. Samples of one
+ *            device are grouped into blocks, each decodable on its own:
+ *            first sample is kept whole in block header, every next
+ *            one as delta-of-delta of timestamp and deltas of changed
+ *            register words, zig-zag mapped and varint coded. Index
+ *            file next to log lists blocks by device and time. Logger
+ *            only collects samples, encoder thread codes and writes
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+#ifndef CLOG_H
+#define CLOG_H
+
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "ina_dev.h"
+#include "sample_log.h"
+
+/****************************************************************/
+/******************* Symbolic Constant Definitions **************/
+/****************************************************************/
+#define CLOG_MAGIC       "INA219CZ"
+#define CLOG_IDX_MAGIC   "INA219CI"
+#define CLOG_VERSION     1
+#define CLOG_IDX_SUFFIX  ".idx"
+#define CLOG_BLK_MAGIC   0x4b4c4243U // "CBLK"
+
+/* Timestamps are kept in multiples of quantum. 1 us is far below
+ * duration of sample read, so jitter of sampler wakeup codes to one
+ * byte; 1 ns keeps them exact at about three bytes per sample */
+#define CLOG_TS_QUANT_NS 1000
+
+#define CLOG_BLOCK_SAMPLES 1024
+#define CLOG_BLOCK_NS    10000000000LL // partial block written after 10 s
+#define CLOG_QUEUE       8          // blocks waiting for encoder
+#define CLOG_POOL        (INA_MAX_DEVS + CLOG_QUEUE + 1)
+
+// Encoded sample: control byte, timestamp, words, flags, sequence step
+#define CLOG_SMP_MAX     (1 + 10 + MEAS_REGS * 3 + 1 + 3)
+
+// Control byte, bit i of 0 - 3 flags changed register word i
+#define CLOG_C_FLAGS     0x10       // flags differ, flags byte follows
+#define CLOG_C_SEQ       0x20       // sequence step other than one
+#define CLOG_C_NIBBLE    0x40       // word deltas packed two per byte
+
+// Blocks start 8-byte aligned, so mapped headers are read in place
+#define CLOG_ALIGN       8
+#define clogBlkSize(len) \
+  (sizeof(clog_blk_s) + (((len) + CLOG_ALIGN - 1) & ~(size_t)(CLOG_ALIGN - 1)))
+
+/****************************************************************/
+/********************** New Types Definitions *******************/
+/****************************************************************/
+
+/* File layout, little-endian: clog_hdr_s followed by blocks, each of
+ * clog_blk_s and len bytes of coded samples padded to CLOG_ALIGN.
+ * Sample after first one is control byte, zig-zag varint of timestamp
+ * delta-of-delta in quanta, zig-zag deltas of changed words (varints,
+ * or nibbles when all fit), flags byte and varint of sequence step as
+ * control byte says. Blocks of devices interleave, each device in
+ * time order. Index file holds clog_hdr_s and clog_idx_s entries, it
+ * is rebuilt by scanning when lost or behind */
+typedef struct {
+  char magic[LOG_MAGIC_LEN];
+  uint16_t version;
+  uint16_t blockSamples;
+  uint32_t tsQuantNs;           // timestamp quantum in ns
+  uint32_t crc;                 // CRC-32 of preceding header bytes
+  uint32_t reserved;
+} clog_hdr_s;
+
+typedef struct {
+  uint32_t magic;               // CLOG_BLK_MAGIC
+  uint32_t len;                 // bytes of coded samples after header
+  int64_t tsNs;                 // first sample kept whole
+  int64_t lastTsNs;             // exact, decoded one is quantized
+  uint16_t raw[MEAS_REGS];
+  uint16_t seq;
+  uint16_t n;                   // samples in block, first one included
+  uint8_t dev;                  // device index or LOG_DEV_SESSION
+  uint8_t flags;
+  uint8_t reserved[6];
+  uint32_t crc;                 // CRC-32 of header before it and samples
+} clog_blk_s;
+
+typedef struct {
+  uint64_t off;                 // file offset of clog_blk_s
+  int64_t tsNs;                 // first and last sample of block
+  int64_t lastTsNs;
+  uint16_t n;
+  uint8_t dev;
+  uint8_t reserved;
+  uint32_t crc;                 // CRC-32 of preceding entry bytes
+} clog_idx_s;
+
+// Samples of one device collected for one block
+typedef struct {
+  int dev;
+  int n;
+  int64_t tsNs[CLOG_BLOCK_SAMPLES];
+  uint16_t raw[CLOG_BLOCK_SAMPLES][MEAS_REGS];
+  uint16_t seq[CLOG_BLOCK_SAMPLES];
+  uint8_t flags[CLOG_BLOCK_SAMPLES];
+} clog_raw_s;
+
+/* Logger fills blocks of cur[], full ones are queued to encoder thread
+ * and come back to free list once written. Only lists are locked */
+typedef struct {
+  int fd, idxFd;
+  uint64_t off;                 // file offset of next block
+  clog_raw_s pool[CLOG_POOL];
+  clog_raw_s *cur[INA_MAX_DEVS];
+  clog_raw_s *free[CLOG_POOL];
+  int nfree;
+  clog_raw_s *queue[CLOG_POOL];
+  int qhead, qlen;
+  int stop;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t ready;         // queue not empty or stop
+  pthread_cond_t done;          // block returned to free list
+  uint8_t buf[CLOG_BLOCK_SAMPLES * CLOG_SMP_MAX + CLOG_ALIGN]; // encoder
+  // Counters, written under lock
+  uint64_t written;             // samples written
+  uint64_t bytes;               // bytes of blocks written
+  uint64_t lost;                // samples of blocks failed to write
+} clog_writer_s;
+
+typedef struct {
+  void *base;
+  size_t size;
+  const clog_hdr_s *hdr;
+  void *idxBase;
+  size_t idxSize;
+  const clog_idx_s *idx;        // NULL without valid index file
+  size_t nidx;
+} clog_map_s;
+
+/****************************************************************/
+/******************* Global Functions Declarations **************/
+/****************************************************************/
+size_t clog_encode(const clog_raw_s *r, uint32_t quantNs,
+		   clog_blk_s *blk, uint8_t *out);
+int clog_decode(const clog_blk_s *blk, const uint8_t *in, uint32_t quantNs,
+		log_rec_s *recs);
+
+int clog_open(clog_writer_s *w, const char *path);
+int clog_append(clog_writer_s *w, int dev, uint64_t seq, const sample_s *smp);
+void clog_tick(clog_writer_s *w, int64_t nowNs);
+int clog_close(clog_writer_s *w);
+
+int clog_map(const char *path, clog_map_s *m);
+void clog_unmap(clog_map_s *m);
+const clog_blk_s *clog_block(const clog_map_s *m, uint64_t off);
+uint64_t clog_next(const clog_map_s *m, uint64_t off);
+
+#endif // CLOG_H
@@ -0,0 +1,770 @@
+/*****************************************************************
+ * Title    : command.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Source file of user commands 'log', 'accu', 'clear',
+ *            'config', 'stream' and 'stats'. Moved out of main loop, response
+ *            goes to caller's stream instead of stdout
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+
+//#define SELF
+//#define DEBUG
+//#define PRINT
+#define JSON
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <ctype.h>
+#include <signal.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/INA219.h"
+#include "sampler.h"
+#include "i2c_transport.h"
+#include "measure.h"
+#include "energy.h"
+#include "command.h"
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+static int parse_dev_arg(const char *arg, int ndev, int *first, int *last);
+static int cmd_park(cmd_ctx_s *ctx, cmd_pend_s *pend, int kind,
+		    int first, int last);
+static int cmd_acked(cmd_ctx_s *ctx, cmd_pend_s *pend);
+static void cmd_log_print(cmd_ctx_s *ctx, FILE *out, int first, int last,
+			  uint32_t lost);
+static int cmd_log(cmd_ctx_s *ctx, FILE *out, cmd_pend_s *pend,
+		   const char *spec, int first, int last);
+static void cmd_accu(cmd_ctx_s *ctx, FILE *out, int first, int last);
+static int cmd_clear(cmd_ctx_s *ctx, cmd_pend_s *pend, int first, int last);
+static void cmd_stats(cmd_ctx_s *ctx, FILE *out, int first, int last);
+static void cmd_metrics(cmd_ctx_s *ctx, FILE *out, int first, int last);
+static void cmd_jitter(cmd_ctx_s *ctx, FILE *out, int first, int last);
+static int cmd_config(cmd_ctx_s *ctx, FILE *out, cmd_pend_s *pend,
+		      const char *spec, int first, int last);
+static int cmd_config_issue(cmd_ctx_s *ctx, FILE *out, cmd_pend_s *pend);
+static void cmd_config_finish(cmd_ctx_s *ctx, FILE *out);
+static void cmd_config_print(cmd_ctx_s *ctx, FILE *out, int first, int last);
+static void cmd_stream(cmd_ctx_s *ctx, FILE *out, stream_s *st,
+		       const char *spec, int first, int last);
+
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+/* @func  parse_dev_arg - resolve optional device index of command
+ * @param const char *arg - index or empty string for all devices
+ * @param int ndev        - number of devices
+ * @param int *first      - first selected device
+ * @param int *last       - last selected device
+ * @return SUCCESS        - 0
+ *         ERROR          - -1, index out of range
+ */
+static int parse_dev_arg(const char *arg, int ndev, int *first, int *last)
+{
+  char *endptr;
+  long idx;
+
+  if (arg[0] == '\0') {
+    *first = 0;
+    *last = ndev - 1;
+    return 0;
+  }
+
+  idx = strtol(arg, &endptr, 10);
+  if (*endptr != '\0' || idx < 0 || idx >= ndev)
+    return -1;
+
+  *first = *last = (int)idx;
+  return 0;
+}
+
+
+/* @func  cmd_park - leave command waiting for requests posted to
+ *                   workers, cmd_poll() finishes it
+ * @param int kind    - CMD_PEND_* of command
+ * @return CMD_PENDING
+ */
+static int cmd_park(cmd_ctx_s *ctx, cmd_pend_s *pend, int kind,
+		    int first, int last)
+{
+  pend->kind = kind;
+  pend->ctx = ctx;
+  pend->first = first;
+  pend->last = last;
+  pend->issued = 1;
+  pend->deadlineNs = meas_now_ns() + CLEAR_WAIT_MS * 1000000LL;
+
+  return CMD_PENDING;
+}
+
+
+/* @func  cmd_acked - drop devices which acknowledged from wait set
+ * @return 1 all acknowledged or CLEAR_WAIT_MS passed, devices left
+ *         in wait set did not answer; 0 still waiting
+ */
+static int cmd_acked(cmd_ctx_s *ctx, cmd_pend_s *pend)
+{
+  dev_share_s *ds;
+  int d, done;
+
+  for (d = pend->first; d <= pend->last; d++) {
+    if (!(pend->wait & 1U << d))
+      continue;
+    ds = &ctx->share->dev[d];
+    if (pend->kind == CMD_PEND_LOG)
+      done = shm_read_done(ds, pend->req[d]);
+    else if (pend->kind == CMD_PEND_CLEAR)
+      done = shm_clear_done(ds, pend->req[d]);
+    else
+      done = shm_config_done(ds, pend->req[d]);
+    if (done)
+      pend->wait &= ~(1U << d);
+  }
+
+  return pend->wait == 0 || meas_now_ns() >= pend->deadlineNs;
+}
+
+
+/* @func  cmd_log_print - latest sample of devices with its age
+ * @param uint32_t lost - bit per device whose fresh sample did not come
+ */
+static void cmd_log_print(cmd_ctx_s *ctx, FILE *out, int first, int last,
+			  uint32_t lost)
+{
+  char tsBuf[TS_BUF_LEN];
+  sample_s smp;
+  double ageMs;
+  int d;
+
+  for (d = first; d <= last; d++) {
+    if ((lost & 1U << d)
+	|| ring_latest(&ctx->share->dev[d].ring, &smp) == -1) {
+      fprintf(out, "{ \"WARN\":\"no sample yet\", \"device\":%d }\n", d);
+      continue;
+    }
+    meas_eng(&smp);
+    ageMs = (meas_now_ns() - smp.tsNs) / 1e6;
+    if (smp.flags & SMPL_F_STALE)
+      fprintf(out, "Bus voltage not measured this time\n");
+
+#ifdef DEBUG
+    fprintf(out, "The value of busRegVal: 0x%02hx\n", smp.raw[MEAS_BUS]);
+#endif // DEBUG
+
+#ifdef JSON
+    fprintf(out, "{\n\"log\":{ \"device\":%d, \"addr\":\"0x%02x\", \"timestamp\":\"%s\", \"age_ms\":%.1f, \"voltage\":%.2f, \"current\":%.2f, \"power\":%.2f }\n}\n",
+	    d, ctx->devs[d].addr,
+	    ts_format(&ctx->tsFmt, ts_mono_to_real(&ctx->tsClock, smp.tsNs),
+		      tsBuf, sizeof(tsBuf)),
+	    ageMs,
+	    smp.busVolt + (smp.shuntVolt / 1000) ,
+	    smp.current,
+	    smp.power);
+#else // JSON
+    fprintf(out, "Device %d (%s@0x%02x)\n", d, ctx->devs[d].bus,
+	    ctx->devs[d].addr);
+    fprintf(out, "The actual value of current : %.2f A\n", smp.current);
+    fprintf(out, "The actual value of shunt voltage: %.2f mV\n", smp.shuntVolt);
+    fprintf(out, "The actual value of bus voltage: %.2f\n", smp.busVolt);
+    fprintf(out, "The actual value of power: %.2f\n", smp.power);
+    fprintf(out, "Sample age: %.1f ms\n", ageMs);
+#endif // JSON
+  }
+}
+
+
+/* @func  cmd_log - actual voltage, current and power. Latest sample
+ *                  published by sampler is shown, so UI load costs no
+ *                  bus traffic. Parent never touches bus, whose
+ *                  register pointer would race with bus worker: 'fresh'
+ *                  sample older than LOG_FRESH_MS is requested from
+ *                  worker, which serves it after its scheduled reads,
+ *                  and requests of all clients pending at once share
+ *                  one transaction
+ * @param const char *spec - NULL or "fresh" to have sampler read device
+ * @return CMD_DONE or CMD_PENDING, response printed by cmd_poll()
+ */
+static int cmd_log(cmd_ctx_s *ctx, FILE *out, cmd_pend_s *pend,
+		   const char *spec, int first, int last)
+{
+  dev_share_s *ds;
+  sample_s smp;
+  int d;
+
+  if (spec != NULL && strcmp(spec, "fresh") != 0) {
+    fprintf(out, "{ \"WARN\":\"Usage: log [fresh] [dev]\" }\n");
+    return CMD_DONE;
+  }
+
+  pend->wait = 0;
+  for (d = first; d <= last && spec != NULL; d++) {
+    ds = &ctx->share->dev[d];
+    if (ring_latest(&ds->ring, &smp) == 0
+	&& meas_now_ns() - smp.tsNs <= LOG_FRESH_MS * 1000000LL)
+      continue;
+    pend->req[d] = shm_request_read(ds);
+    pend->wait |= 1U << d;
+    kill(ctx->workers[ctx->devs[d].busIdx], SIGUSR2);
+  }
+  if (pend->wait != 0)
+    return cmd_park(ctx, pend, CMD_PEND_LOG, first, last);
+
+  cmd_log_print(ctx, out, first, last, 0);
+  return CMD_DONE;
+}
+
+
+/* @func  cmd_accu - accumulated energy */
+static void cmd_accu(cmd_ctx_s *ctx, FILE *out, int first, int last)
+{
+  char tsBuf[TS_BUF_LEN];
+  accu_data_s accu;
+  double energyJ;
+  int d;
+
+  for (d = first; d <= last; d++) {
+    accu_read(&ctx->share->dev[d].accu, &accu);
+    energyJ = energy_q_joules(&accu.energy);
+
+#ifdef JSON
+    fprintf(out, "{ \"device\":%d, \"timestamp\":\"%s\", \"energy_Wh\":%.6f, \"energy_J\":%.3f, \"samples\":%llu, \"missed\":%llu, \"gaps\":%llu, \"gap_s\":%.3f };\n",
+	    d, ts_format(&ctx->tsFmt, accu.samples > 0
+			 ? ts_mono_to_real(&ctx->tsClock, accu.lastTsNs)
+			 : ctx->tsClock.realNs, tsBuf, sizeof(tsBuf)),
+	    energyJ / J_PER_WH,
+	    energyJ, (unsigned long long)accu.samples,
+	    (unsigned long long)accu.missed, (unsigned long long)accu.gaps,
+	    accu.gapNs / 1e9);
+#else // JSON
+    fprintf(out, "Device %d accumulated energy: %.6f Wh (%.3f J)\n",
+	    d, energyJ / J_PER_WH, energyJ);
+#endif //JSON
+  }
+}
+
+
+/* @func  cmd_clear - zero accumulated energy. Worker zeroes
+ *                    accumulator itself, all selected devices are
+ *                    asked at once
+ * @return CMD_PENDING, missing acknowledgements reported by cmd_poll()
+ */
+static int cmd_clear(cmd_ctx_s *ctx, cmd_pend_s *pend, int first, int last)
+{
+  dev_share_s *ds;
+  int d;
+
+  pend->wait = 0;
+  for (d = first; d <= last; d++) {
+    ds = &ctx->share->dev[d];
+    pend->req[d] = shm_request_clear(ds);
+    pend->wait |= 1U << d;
+    kill(ctx->workers[ctx->devs[d].busIdx], SIGUSR2);
+  }
+
+  return cmd_park(ctx, pend, CMD_PEND_CLEAR, first, last);
+}
+
+
+/* @func  cmd_stats - statistics of last completed 1 s, 1 min and 1 h
+ *                    windows, window still filling until first one
+ *                    completes. Served from shared memory only
+ */
+static void cmd_stats(cmd_ctx_s *ctx, FILE *out, int first, int last)
+{
+  char tsBuf[TS_BUF_LEN];
+  rollup_data_s rd;
+  rollup_win_s *w;
+  rollup_res_s r;
+  int d, i, ch;
+
+  for (d = first; d <= last; d++) {
+    rollup_read(&ctx->share->dev[d].rollup, &rd);
+
+    for (i = 0; i < ROLLUP_WINDOWS; i++) {
+      w = rd.last[i].used ? &rd.last[i] : &rd.cur[i];
+      if (!w->used) {
+	fprintf(out, "{ \"WARN\":\"no sample yet\", \"device\":%d }\n", d);
+	break;
+      }
+
+      fprintf(out, "{ \"stats\":{ \"device\":%d, \"window\":\"%s\", \"complete\":%s, \"start\":\"%s\", \"samples\":%llu",
+	      d, rollupNames[i], (w == &rd.last[i]) ? "true" : "false",
+	      ts_format(&ctx->tsFmt, ts_mono_to_real(&ctx->tsClock, w->startNs),
+			tsBuf, sizeof(tsBuf)),
+	      (unsigned long long)w->ch[0].n);
+      for (ch = 0; ch < ROLLUP_CH; ch++) {
+	rollup_result(w, ch, &r);
+	fprintf(out, ", \"%s\":{ \"min\":%.4f, \"max\":%.4f, \"mean\":%.4f, \"stddev\":%.4f, \"p50\":%.4f, \"p99\":%.4f }",
+		rollupChNames[ch], r.min, r.max, r.mean, r.stddev, r.p50, r.p99);
+      }
+      fprintf(out, " } }\n");
+    }
+  }
+}
+
+
+/* @func  cmd_metrics - sampler wakeup jitter, latency of I2C
+ *                      transactions by operation and register and
+ *                      failures by errno. Served from shared memory only
+ */
+static void cmd_metrics(cmd_ctx_s *ctx, FILE *out, int first, int last)
+{
+  smpl_stats_s *st;
+  i2c_stats_s *is;
+  accu_data_s accu;
+  const hist_s *h;
+  uint64_t n;
+  int d, op, reg, e;
+
+  for (d = first; d <= last; d++) {
+    st = &ctx->share->dev[d].stats;
+    is = &ctx->share->dev[d].i2c;
+    accu_read(&ctx->share->dev[d].accu, &accu);
+
+    fprintf(out, "{ \"metrics\":{ \"device\":%d, \"sampler\":{ \"wakeups\":%llu, \"late_p50_us\":%.1f, \"late_p99_us\":%.1f, \"late_max_us\":%.1f, \"deadline_misses\":%llu, \"missed_conversions\":%llu }, \"faults\":{ \"i2c_retries\":%llu, \"i2c_reopens\":%llu, \"outages\":%llu, \"gaps\":%llu }, \"range\":{ \"switches\":%llu, \"marked\":%llu, \"overflows\":%llu } } }\n",
+	    d, (unsigned long long)hist_count(&st->lateHist),
+	    hist_quantile(&st->lateHist, 0.50) / 1e3,
+	    hist_quantile(&st->lateHist, 0.99) / 1e3,
+	    atomic_load_explicit(&st->lateHist.maxNs, memory_order_relaxed) / 1e3,
+	    (unsigned long long)atomic_load_explicit(&st->overruns,
+						     memory_order_relaxed),
+	    (unsigned long long)accu.missed,
+	    (unsigned long long)atomic_load_explicit(&is->retries,
+						     memory_order_relaxed),
+	    (unsigned long long)atomic_load_explicit(&is->reopens,
+						     memory_order_relaxed),
+	    (unsigned long long)atomic_load_explicit(&st->outages,
+						     memory_order_relaxed),
+	    (unsigned long long)accu.gaps,
+	    (unsigned long long)atomic_load_explicit(&st->rangeSwitches,
+						     memory_order_relaxed),
+	    (unsigned long long)atomic_load_explicit(&st->rangeMarked,
+						     memory_order_relaxed),
+	    (unsigned long long)atomic_load_explicit(&st->ovfSamples,
+						     memory_order_relaxed));
+
+    for (op = 0; op < I2C_OPS; op++)
+      for (reg = 0; reg < I2C_REGS; reg++) {
+	h = &is->lat[op][reg];
+	if ((n = hist_count(h)) == 0)
+	  continue;
+	fprintf(out, "{ \"metrics\":{ \"device\":%d, \"op\":\"%s\", \"reg\":\"%s\", \"count\":%llu, \"fails\":%llu, \"p50_us\":%.1f, \"p90_us\":%.1f, \"p99_us\":%.1f, \"max_us\":%.1f } }\n",
+		d, i2cOpNames[op], i2cRegNames[reg], (unsigned long long)n,
+		(unsigned long long)atomic_load_explicit(&is->fails[op][reg],
+							 memory_order_relaxed),
+		hist_quantile(h, 0.50) / 1e3, hist_quantile(h, 0.90) / 1e3,
+		hist_quantile(h, 0.99) / 1e3,
+		atomic_load_explicit(&h->maxNs, memory_order_relaxed) / 1e3);
+      }
+
+    for (e = 0; e <= I2C_ERRNO_MAX; e++) {
+      n = atomic_load_explicit(&is->errnos[e], memory_order_relaxed);
+      if (n == 0)
+	continue;
+      fprintf(out, "{ \"metrics\":{ \"device\":%d, \"errno\":%d, \"error\":\"%s\", \"count\":%llu } }\n",
+	      d, e, (e < I2C_ERRNO_MAX) ? strerror(e) : "other",
+	      (unsigned long long)n);
+    }
+  }
+}
+
+
+/* @func  cmd_jitter - wakeup of bus worker past scheduled sample time,
+ *                     quantiles and count per power of two, together
+ *                     with real-time mode worker actually runs in
+ */
+static void cmd_jitter(cmd_ctx_s *ctx, FILE *out, int first, int last)
+{
+  uint64_t oct[HIST_MAX_BITS];
+  smpl_stats_s *st;
+  const char *sep;
+  int d, e;
+
+  for (d = first; d <= last; d++) {
+    st = &ctx->share->dev[d].stats;
+    fprintf(out, "{ \"jitter\":{ \"device\":%d, \"rt\":{ \"prio\":%d, \"cpu\":%d, \"locked\":%d }, \"wakeups\":%llu, \"p50_us\":%.1f, \"p99_us\":%.1f, \"p999_us\":%.1f, \"max_us\":%.1f, \"below_us\":{ ",
+	    d, (int)atomic_load_explicit(&st->rtPrio, memory_order_relaxed),
+	    (int)atomic_load_explicit(&st->rtCpu, memory_order_relaxed),
+	    (int)atomic_load_explicit(&st->rtLocked, memory_order_relaxed),
+	    (unsigned long long)hist_count(&st->lateHist),
+	    hist_quantile(&st->lateHist, 0.50) / 1e3,
+	    hist_quantile(&st->lateHist, 0.99) / 1e3,
+	    hist_quantile(&st->lateHist, 0.999) / 1e3,
+	    atomic_load_explicit(&st->lateHist.maxNs, memory_order_relaxed) / 1e3);
+
+    // Octave e holds 2^e - 2^(e+1) ns, keyed by its upper bound
+    hist_octaves(&st->lateHist, oct);
+    sep = "";
+    for (e = 0; e < HIST_MAX_BITS; e++) {
+      if (oct[e] == 0)
+	continue;
+      fprintf(out, "%s\"%.1f\":%llu", sep, (double)(2ULL << e) / 1e3,
+	      (unsigned long long)oct[e]);
+      sep = ", ";
+    }
+    fprintf(out, " } } }\n");
+  }
+}
+
+
+/* @func  cmd_config - show ADC configuration, or change it by spec.
+ *                     Change waits until no other 'config' is in
+ *                     flight, see cmd_poll()
+ * @return CMD_DONE or CMD_PENDING
+ */
+static int cmd_config(cmd_ctx_s *ctx, FILE *out, cmd_pend_s *pend,
+		      const char *spec, int first, int last)
+{
+  if (spec == NULL) {
+    cmd_config_print(ctx, out, first, last);
+    return CMD_DONE;
+  }
+
+  pend->kind = CMD_PEND_CONFIG;
+  pend->ctx = ctx;
+  pend->first = first;
+  pend->last = last;
+  pend->issued = 0;
+  snprintf(pend->spec, sizeof(pend->spec), "%s", spec);
+
+  return cmd_poll(pend, out);
+}
+
+
+/* @func  cmd_config_issue - check new settings of devices selected by
+ *                           pend and post them to workers, which own
+ *                           bus and write registers
+ * @return CMD_PENDING  - posted, ctx->cfg waits for acknowledgements
+ *         CMD_DONE     - spec refused, warning printed
+ */
+static int cmd_config_issue(cmd_ctx_s *ctx, FILE *out, cmd_pend_s *pend)
+{
+  cmd_pend_s *cfg = &ctx->cfg;
+  dev_share_s *ds;
+  long newRate;
+  int d;
+
+  // Check new settings of all selected devices before applying any
+  newRate = ctx->rate;
+  for (d = pend->first; d <= pend->last; d++) {
+    cfg->newCfg[d] = ctx->devCfg[d];
+    cfg->newCfg[d].rate = ctx->rate;
+    if (ina_config_parse(pend->spec, &cfg->newCfg[d]) == -1)
+      break;
+    newRate = cfg->newCfg[d].rate;
+  }
+  if (d <= pend->last) {
+    fprintf(out, "{ \"WARN\":\"Bad config spec '%s'\" }\n", pend->spec);
+    return CMD_DONE;
+  }
+
+  // Rate is common to all devices, none may be sampled too fast
+  for (d = 0; d < ctx->ndev && newRate != SMPL_RATE_CNVR; d++) {
+    if (newRate > ina219_max_rate((d >= pend->first && d <= pend->last)
+				  ? cfg->newCfg[d].conf : ctx->devCfg[d].conf))
+      break;
+  }
+  if (newRate != SMPL_RATE_CNVR && d < ctx->ndev) {
+    fprintf(out, "{ \"WARN\":\"rate %ld Hz above ADC limit of device %d\" }\n",
+	    newRate, d);
+    return CMD_DONE;
+  }
+
+  cfg->newRate = newRate;
+  cfg->wait = 0;
+  for (d = pend->first; d <= pend->last; d++) {
+    ds = &ctx->share->dev[d];
+    cfg->req[d] = shm_request_config(ds, cfg->newCfg[d].conf,
+				     cfg->newCfg[d].calib);
+    cfg->wait |= 1U << d;
+    kill(ctx->workers[ctx->devs[d].busIdx], SIGUSR2);
+  }
+  ctx->cfgOwner = pend;
+  pend->issued = 1;
+
+  return cmd_park(ctx, cfg, CMD_PEND_CONFIG, pend->first, pend->last);
+}
+
+
+/* @func  cmd_config_finish - take settings acknowledged by workers and
+ *                            set rate. Device not acknowledging keeps
+ *                            its old ADC setting, rate checked against
+ *                            new one may be too fast for it. Slowest
+ *                            device sets rate then
+ * @param FILE *out - response stream, NULL when client is gone
+ */
+static void cmd_config_finish(cmd_ctx_s *ctx, FILE *out)
+{
+  cmd_pend_s *cfg = &ctx->cfg;
+  long newRate = cfg->newRate, maxRate;
+  int d, i;
+
+  for (d = cfg->first; d <= cfg->last; d++) {
+    if (!(cfg->wait & 1U << d))
+      ctx->devCfg[d] = cfg->newCfg[d];
+    else if (out != NULL)
+      fprintf(out, "{ \"WARN\":\"config not acknowledged by sampler\", \"device\":%d }\n", d);
+  }
+
+  for (d = 0; d < ctx->ndev && newRate != SMPL_RATE_CNVR; d++) {
+    maxRate = ina219_max_rate(ctx->devCfg[d].conf);
+    if (newRate > maxRate) {
+      if (out != NULL)
+	fprintf(out, "{ \"WARN\":\"rate lowered to %ld Hz, ADC limit of device %d\" }\n",
+		maxRate, d);
+      newRate = maxRate;
+    }
+  }
+
+  ctx->rate = newRate;
+  atomic_store(&ctx->share->rate, ctx->rate);
+  for (i = 0; i < ctx->nbus; i++)
+    kill(ctx->workers[i], SIGUSR2);
+
+  if (out != NULL)
+    cmd_config_print(ctx, out, cfg->first, cfg->last);
+  cfg->kind = CMD_PEND_NONE;
+  ctx->cfgOwner = NULL;
+}
+
+
+/* @func  cmd_config_print - ADC configuration of devices. Auto-ranged
+ *                           device shows calibration of /8, worker
+ *                           scales it
+ */
+static void cmd_config_print(cmd_ctx_s *ctx, FILE *out, int first, int last)
+{
+  unsigned short conf;
+  char pga[8];
+  int d;
+
+  for (d = first; d <= last; d++) {
+    conf = ctx->devCfg[d].conf;
+    if (conf & CONF_AUTO_PGA)
+      snprintf(pga, sizeof(pga), "auto");
+    else
+      snprintf(pga, sizeof(pga), "%d",
+	       1 << ((conf >> CONF_PG_SHIFT) & CONF_PG_MASK));
+    fprintf(out, "{ \"config\":{ \"device\":%d, \"conf\":\"0x%04hx\", \"calib\":\"0x%04hx\", \"pga\":\"%s\", \"conv_us\":%.1f, \"rate\":%ld } }\n",
+	    d, (unsigned short)(conf & ~CONF_AUTO_PGA), ctx->devCfg[d].calib,
+	    pga, ina219_conv_time_ns(conf) / 1000.0, ctx->rate);
+  }
+}
+
+
+/* @func  cmd_stream - start, stop or show sample stream of caller */
+static void cmd_stream(cmd_ctx_s *ctx, FILE *out, stream_s *st,
+		       const char *spec, int first, int last)
+{
+  char *endptr;
+  long rate;
+
+  if (spec != NULL && !strcmp(spec, "off"))
+    stream_stop(st);
+  else if (spec != NULL) {
+    rate = strtol(spec, &endptr, 10);
+    if (*endptr != '\0' || rate <= 0) {
+      fprintf(out, "{ \"WARN\":\"Stream rate must be positive number or 'off'\" }\n");
+      return;
+    }
+    stream_start(st, ctx->share, rate, first, last);
+  }
+
+  fprintf(out, "{ \"stream\":{ \"active\":%d, \"rate\":%ld, \"emitted\":%llu, \"decimated\":%llu, \"dropped\":%llu, \"lost\":%llu } }\n",
+	  st->active, st->rate,
+	  (unsigned long long)st->emitted,
+	  (unsigned long long)st->decimated,
+	  (unsigned long long)st->dropped,
+	  (unsigned long long)st->lost);
+}
+
+
+/****************************************************************/
+/**************** Global Functions Definitions ******************/
+/****************************************************************/
+
+/* @func  cmd_exec - execute one command line
+ * @param cmd_ctx_s *ctx  - application state
+ * @param const char *line - command and arguments, no newline
+ * @param FILE *out       - response stream
+ * @param stream_s *st    - sample stream of caller, 'stream' controls it
+ * @param cmd_pend_s *pend - idle parking place of caller
+ * @return CMD_DONE       - command executed, or warning printed
+ *         CMD_EXIT       - 'exit' entered, nothing printed
+ *         CMD_PENDING    - waits for sampler in pend, response comes
+ *                          from cmd_poll()
+ */
+int cmd_exec(cmd_ctx_s *ctx, const char *line, FILE *out, stream_s *st,
+	     cmd_pend_s *pend)
+{
+  char command[16], arg[64], arg2[16];
+  const char *spec, *devArg;
+  int first, last;
+
+  command[0] = arg[0] = arg2[0] = '\0';
+  sscanf(line, "%15s %63s %15s", command, arg, arg2);
+
+  if (command[0] == '\0')
+    return CMD_DONE;
+  if (strcmp(command, "exit") == 0)
+    return CMD_EXIT;
+
+  // Re-pair clocks per command, wall clock may have been stepped
+  if (!ctx->tsFixed)
+    ts_clock_sync(&ctx->tsClock);
+
+  /* 'config' takes optional spec, 'log' optional 'fresh', 'stream'
+   * rate or 'off', before device */
+  spec = NULL;
+  devArg = arg;
+  if (((!strcmp(command, "config") || !strcmp(command, "log"))
+       && arg[0] != '\0' && !isdigit((unsigned char)arg[0]))
+      || (!strcmp(command, "stream") && arg[0] != '\0')) {
+    spec = arg;
+    devArg = arg2;
+  }
+
+  // Optional device index selects one device, default is all of them
+  if (parse_dev_arg(devArg, ctx->ndev, &first, &last) == -1) {
+    fprintf(out, "{ \"WARN\":\"Device index must be 0 - %d\" }\n",
+	    ctx->ndev - 1);
+    return CMD_DONE;
+  }
+
+  if (!strcmp(command, "log"))
+    return cmd_log(ctx, out, pend, spec, first, last);
+  else if (!strcmp(command, "accu"))
+    cmd_accu(ctx, out, first, last);
+  else if (!strcmp(command, "clear"))
+    return cmd_clear(ctx, pend, first, last);
+  else if (!strcmp(command, "stats"))
+    cmd_stats(ctx, out, first, last);
+  else if (!strcmp(command, "metrics"))
+    cmd_metrics(ctx, out, first, last);
+  else if (!strcmp(command, "jitter"))
+    cmd_jitter(ctx, out, first, last);
+  else if (!strcmp(command, "config"))
+    return cmd_config(ctx, out, pend, spec, first, last);
+  else if (!strcmp(command, "stream"))
+    cmd_stream(ctx, out, st, spec, first, last);
+  else {
+#ifdef JSON
+    fprintf(out, "{ \"WARN\":\"Unrecognized command! Valid commands are: " CMD_LIST "\" }\n");
+#else // JSON
+    fprintf(out, "Unrecognized command!\n"
+	    "Valid commands are: " CMD_LIST "\n");
+#endif // JSON
+  }
+
+  return CMD_DONE;
+}
+
+
+/* @func  cmd_poll - finish parked command once workers acknowledged
+ *                   it or CLEAR_WAIT_MS passed. Call on every pass of
+ *                   caller's loop while pend is not idle
+ * @param cmd_pend_s *pend - command parked by cmd_exec()
+ * @param FILE *out       - response stream
+ * @return CMD_DONE       - response printed, pend idle again
+ *         CMD_PENDING    - still waiting
+ */
+int cmd_poll(cmd_pend_s *pend, FILE *out)
+{
+  cmd_ctx_s *ctx = pend->ctx;
+  int d;
+
+  switch (pend->kind) {
+  case CMD_PEND_NONE:
+    return CMD_DONE;
+
+  case CMD_PEND_CONFIG:
+    if (!pend->issued) {
+      if (ctx->cfg.kind != CMD_PEND_NONE
+	  || cmd_config_issue(ctx, out, pend) == CMD_PENDING)
+	return CMD_PENDING;
+      break;
+    }
+    if (!cmd_acked(ctx, &ctx->cfg))
+      return CMD_PENDING;
+    cmd_config_finish(ctx, out);
+    break;
+
+  default:
+    if (!cmd_acked(ctx, pend))
+      return CMD_PENDING;
+    if (pend->kind == CMD_PEND_LOG)
+      cmd_log_print(ctx, out, pend->first, pend->last, pend->wait);
+    else
+      for (d = pend->first; d <= pend->last; d++)
+	if (pend->wait & 1U << d)
+	  fprintf(out, "{ \"WARN\":\"clear not acknowledged by sampler\", \"device\":%d }\n", d);
+    break;
+  }
+
+  pend->kind = CMD_PEND_NONE;
+  return CMD_DONE;
+}
+
+
+/* @func  cmd_cancel - forget parked command of client gone. Its
+ *                     'config' in flight is finished by cmd_service()
+ */
+void cmd_cancel(cmd_pend_s *pend)
+{
+  if (pend->kind != CMD_PEND_NONE && pend->ctx->cfgOwner == pend)
+    pend->ctx->cfgOwner = NULL;
+  pend->kind = CMD_PEND_NONE;
+}
+
+
+/* @func  cmd_service - finish 'config' whose client is gone, settings
+ *                      acknowledged are taken without response. Call
+ *                      on every pass of main loop
+ * @return 1 while 'config' is in flight, caller keeps polling; 0 otherwise
+ */
+int cmd_service(cmd_ctx_s *ctx)
+{
+  if (ctx->cfg.kind == CMD_PEND_NONE)
+    return 0;
+
+  if (ctx->cfgOwner == NULL && cmd_acked(ctx, &ctx->cfg))
+    cmd_config_finish(ctx, NULL);
+
+  return ctx->cfg.kind != CMD_PEND_NONE;
+}
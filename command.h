@@ -0,0 +1,103 @@
+/*****************************************************************
+ * Title    : command.h
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Header file of user commands. One command line is
+ *            executed against shared application state and its
+ *            response is printed to given stream, so console and
+ *            socket clients share one implementation. Command waiting
+ *            for sampler never blocks caller's loop, it is parked and
+ *            finished by cmd_poll() on later pass
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+#ifndef COMMAND_H
+#define COMMAND_H
+
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <stdio.h>
+#include <sys/types.h>
+#include "ina_dev.h"
+#include "ina_config.h"
+#include "shm_ring.h"
+#include "stream.h"
+#include "ts_fmt.h"
+
+/****************************************************************/
+/******************* Symbolic Constant Definitions **************/
+/****************************************************************/
+#define CMD_LIST "'accu [dev]', 'log [fresh] [dev]', 'clear [dev]', 'config [spec] [dev]', 'stream [rate|off] [dev]', 'stats [dev]', 'metrics [dev]', 'jitter [dev]', 'exit'"
+
+// Results of cmd_exec() and cmd_poll()
+#define CMD_DONE      0
+#define CMD_EXIT      1             // 'exit', caller shuts down
+#define CMD_PENDING   2             // parked, caller polls it to finish
+
+// Kinds of parked command
+#define CMD_PEND_NONE   0           // idle, zeroed cmd_pend_s is idle
+#define CMD_PEND_LOG    1           // 'log fresh'
+#define CMD_PEND_CLEAR  2
+#define CMD_PEND_CONFIG 3
+
+#define CMD_SPEC_MAX  64            // longest spec of 'config'
+
+// How long 'log fresh', 'clear' and 'config' wait for sampler to acknowledge, in ms
+#define CLEAR_WAIT_MS 1000
+
+// 'log fresh' answers from sample younger than this without touching bus
+#define LOG_FRESH_MS  50
+
+// Sub-second digits of timestamps, milliseconds
+#define TS_FRAC_DIGITS 3
+
+/****************************************************************/
+/********************** New Types Definitions *******************/
+/****************************************************************/
+typedef struct cmd_ctx_s cmd_ctx_s;
+
+/* Command waiting for workers to acknowledge its requests. Caller
+ * owning it runs no further command until cmd_poll() finishes it, so
+ * responses keep order of commands */
+typedef struct {
+  int kind;                         // CMD_PEND_*
+  cmd_ctx_s *ctx;
+  int first, last;                  // selected devices
+  int issued;                       // requests posted to workers
+  uint32_t wait;                    // bit per device not acknowledged yet
+  uint32_t req[INA_MAX_DEVS];       // request number per device
+  int64_t deadlineNs;               // CLOCK_MONOTONIC, gives up then
+  char spec[CMD_SPEC_MAX];          // of 'config'
+  ina_config_s newCfg[INA_MAX_DEVS];
+  long newRate;
+} cmd_pend_s;
+
+// Application state commands work on, owned by parent process
+struct cmd_ctx_s {
+  ina_dev_s *devs;
+  int ndev;
+  int nbus;
+  pid_t *workers;                   // sampler of bus i
+  shm_share_s *share;
+  long rate;                        // common sample rate or SMPL_RATE_CNVR
+  ina_config_s devCfg[INA_MAX_DEVS];
+  ts_clock_s tsClock;
+  int tsFixed;                      // tsClock pairs recorded session
+  ts_fmt_s tsFmt;
+  /* 'config' in flight, one at a time as request of device is one
+   * register word. Its owner is NULL once client is gone */
+  cmd_pend_s cfg;
+  cmd_pend_s *cfgOwner;
+};
+
+/****************************************************************/
+/******************* Global Functions Declarations **************/
+/****************************************************************/
+int cmd_exec(cmd_ctx_s *ctx, const char *line, FILE *out, stream_s *st,
+	     cmd_pend_s *pend);
+int cmd_poll(cmd_pend_s *pend, FILE *out);
+void cmd_cancel(cmd_pend_s *pend);
+int cmd_service(cmd_ctx_s *ctx);
+
+#endif // COMMAND_H
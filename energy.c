@@ -0,0 +1,249 @@
+/*****************************************************************
+ * Title    : energy.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Source file of energy integrator. Each sample adds
+ *            trapezoid between it and previous sample over measured
+ *            CLOCK_MONOTONIC dt, so neither timer jitter nor missed
+ *            ticks bias the total. Raw power words times dt are summed
+ *            in 128-bit integer, so no rounding error grows with
+ *            sample count; sum is converted to J only when reported
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+
+//#define SELF
+//#define DEBUG
+//#define PRINT
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <math.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/INA219.h"
+#include "measure.h"
+#include "energy.h"
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+// J per unit of sum, power in LSB of finest range
+#define ENERGY_Q_LSB_J   (pwrConv(1.0) / (1 << MEAS_SCALE_MAX) * 0.5e-9)
+#define TWO_POW_64       18446744073709551616.0
+
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+#ifdef SELF
+int main(int argc, char *argv[])
+{
+  energy_q_s q;
+  u128_s acc;
+  double naive = 0.0;
+  int64_t ts = 0, ts0 = 0;
+  long i, n = 500L * 3600 * 24;     // one day at 500 Hz
+  uint64_t a, b, seed = 88172645463325252ULL;
+  int fails = 0;
+
+  // 6.1 W load sampled at 500 Hz with +-100 us jitter
+  energy_q_reset(&q);
+  for (i = 0; i <= n; i++) {
+    ts = i * 2000000LL + ((i * 7919) % 200001) - 100000;
+    energy_q_add(&q, ts,
+		 (uint32_t)lround(6.1 / pwrConv(1.0)) << MEAS_SCALE_MAX);
+    if (i == 0)
+      ts0 = ts;
+    else
+      naive += 6.1 / 500;
+  }
+
+  printf("expected %.6f J, exact %.6f J, naive %.6f J\n",
+	 lround(6.1 / pwrConv(1.0)) * pwrConv(1.0) * (ts - ts0) / 1e9,
+	 energy_q_joules(&q.sum), naive);
+
+  // Carry from low to high word
+  acc.hi = 0;
+  acc.lo = UINT64_MAX - 5;
+  u128_add_mul(&acc, 3, 4);
+  if (acc.hi != 1 || acc.lo != 6) {
+    printf("carry: hi %llu lo %llu\n",
+	   (unsigned long long)acc.hi, (unsigned long long)acc.lo);
+    fails++;
+  }
+
+  // Sums of parts merge with carry, (2^64 + 6) + (2^64 - 6)
+  b = acc.lo;
+  acc.lo = -b;
+  acc.hi = 0;
+  u128_add(&acc, &(u128_s){ 1, b });
+  if (acc.hi != 2 || acc.lo != 0) {
+    printf("merge: hi %llu lo %llu\n",
+	   (unsigned long long)acc.hi, (unsigned long long)acc.lo);
+    fails++;
+  }
+
+  // Largest product, (2^64 - 1)^2 = 2^128 - 2^65 + 1
+  acc.hi = acc.lo = 0;
+  u128_add_mul(&acc, UINT64_MAX, UINT64_MAX);
+  if (acc.hi != UINT64_MAX - 1 || acc.lo != 1) {
+    printf("max product: hi %llx lo %llx\n",
+	   (unsigned long long)acc.hi, (unsigned long long)acc.lo);
+    fails++;
+  }
+
+  // Sum of 128-bit wraps modulo 2^128
+  u128_add_mul(&acc, UINT64_MAX, 2);
+  u128_add_mul(&acc, 1, 1);
+  if (acc.hi != 0 || acc.lo != 0) {
+    printf("wrap: hi %llx lo %llx\n",
+	   (unsigned long long)acc.hi, (unsigned long long)acc.lo);
+    fails++;
+  }
+
+#ifdef __SIZEOF_INT128__
+  // Random products against compiler 128-bit arithmetic
+  {
+    unsigned __int128 ref = 0;
+
+    acc.hi = acc.lo = 0;
+    for (i = 0; i < 1000000; i++) {
+      seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+      a = seed;
+      seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+      b = seed >> (i % 64);
+      u128_add_mul(&acc, a, b);
+      ref += (unsigned __int128)a * b;
+    }
+    if (acc.hi != (uint64_t)(ref >> 64) || acc.lo != (uint64_t)ref) {
+      printf("random products differ from __int128\n");
+      fails++;
+    }
+  }
+#else
+  (void)a; (void)b; (void)seed;
+#endif // __SIZEOF_INT128__
+
+  printf("128-bit checks: %s\n", fails ? "FAILED" : "passed");
+  exit(fails ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+#endif // SELF
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+
+/****************************************************************/
+/**************** Global Functions Definitions ******************/
+/****************************************************************/
+
+/* @func  u128_add_mul - acc += a * b, full 128-bit product from four
+ *                       32 x 32 bit partial products, wraps modulo 2^128
+ */
+void u128_add_mul(u128_s *acc, uint64_t a, uint64_t b)
+{
+  uint64_t aLo = (uint32_t)a, aHi = a >> 32;
+  uint64_t bLo = (uint32_t)b, bHi = b >> 32;
+  uint64_t ll = aLo * bLo, lh = aLo * bHi, hl = aHi * bLo, hh = aHi * bHi;
+  uint64_t mid, lo, hi;
+
+  mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+  lo = (mid << 32) | (uint32_t)ll;
+  hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+
+  acc->lo += lo;
+  acc->hi += hi + (acc->lo < lo);
+}
+
+
+/* @func  u128_add - acc += x, sums of parts merge exactly */
+void u128_add(u128_s *acc, const u128_s *x)
+{
+  acc->lo += x->lo;
+  acc->hi += x->hi + (acc->lo < x->lo);
+}
+
+
+/* @func  u128_to_double - nearest double, for reporting only */
+double u128_to_double(const u128_s *x)
+{
+  return (double)x->hi * TWO_POW_64 + (double)x->lo;
+}
+
+
+/* @func  energy_q_reset - zero exact integrator */
+void energy_q_reset(energy_q_s *e)
+{
+  e->sum.hi = 0;
+  e->sum.lo = 0;
+  e->prevTsNs = 0;
+  e->prevPower = 0;
+  e->primed = 0;
+}
+
+
+/* @func  energy_q_add - integrate raw power word into exact total
+ * @param energy_q_s *e    - integrator
+ * @param int64_t tsNs     - CLOCK_MONOTONIC timestamp of sample in ns
+ * @param uint32_t power   - power as given by meas_power_fine()
+ */
+void energy_q_add(energy_q_s *e, int64_t tsNs, uint32_t power)
+{
+  if (e->primed && tsNs > e->prevTsNs)
+    u128_add_mul(&e->sum, (uint64_t)e->prevPower + power,
+		 (uint64_t)(tsNs - e->prevTsNs));
+
+  e->prevTsNs = tsNs;
+  e->prevPower = power;
+  e->primed = 1;
+}
+
+
+/* @func  energy_q_gap - samples were lost, next sample starts new
+ *                       interval instead of bridging gap by trapezoid
+ */
+void energy_q_gap(energy_q_s *e)
+{
+  e->primed = 0;
+}
+
+
+/* @func  energy_q_joules - convert exact sum to engineering units
+ * @param const u128_s *sum - sum of energy_q_s
+ * @return energy in J
+ */
+double energy_q_joules(const u128_s *sum)
+{
+  return u128_to_double(sum) * ENERGY_Q_LSB_J;
+}
@@ -0,0 +1,59 @@
+/*****************************************************************
+ * Title    : energy.h
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Header file of energy integrator. Trapezoidal rule over
+ *            real time between samples, summed exactly in 128-bit
+ *            integer
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+#ifndef ENERGY_H
+#define ENERGY_H
+
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <stdint.h>
+
+/****************************************************************/
+/******************* Symbolic Constant Definitions **************/
+/****************************************************************/
+#define J_PER_WH     3600.0
+
+/****************************************************************/
+/********************** New Types Definitions *******************/
+/****************************************************************/
+// Portable unsigned 128-bit integer, 32-bit ARM has no __int128
+typedef struct {
+  uint64_t hi;
+  uint64_t lo;
+} u128_s;
+
+/* Exact integrator of raw power register words, no floating point.
+ * Power is in LSB of finest auto-ranged range, power register LSB / 8,
+ * so samples of every range add exactly. Unit of sum is that LSB x
+ * ns / 2, each trapezoid adds (P[k-1] + P[k]) * dt. Term is below
+ * 2^20 * dt, so 64-bit sum would wrap after 2^64 / (2^20 * 1e9) s =
+ * 4.9 hours at full scale, 128-bit sum wraps after 1e16 years. Same
+ * samples give same sum bit for bit */
+typedef struct {
+  u128_s sum;             // sum of (P[k-1] + P[k]) * dt_ns
+  int64_t prevTsNs;       // timestamp of previous sample
+  uint32_t prevPower;     // power of previous sample
+  int primed;             // previous sample valid
+} energy_q_s;
+
+/****************************************************************/
+/******************* Global Functions Declarations **************/
+/****************************************************************/
+void u128_add_mul(u128_s *acc, uint64_t a, uint64_t b);
+void u128_add(u128_s *acc, const u128_s *x);
+double u128_to_double(const u128_s *x);
+
+void energy_q_reset(energy_q_s *e);
+void energy_q_add(energy_q_s *e, int64_t tsNs, uint32_t power);
+void energy_q_gap(energy_q_s *e);
+double energy_q_joules(const u128_s *sum);
+
+#endif // ENERGY_H
@@ -33,6 +33,7 @@
 					functions */
 #include "../header/INA219.h"
 #include "../header/i2c.h"
+#include "i2c_rdwr.h"
 
 /****************************************************************/
 /***************** Global Variable Definitions ******************/
@@ -276,6 +277,53 @@ int i2c_read_data_word(int i2cfd, const unsigned char *reg, char *word)
 }
 
 
+/* @func  i2c_read_data_words - function to read words from several
+ *                               registers in one combined transaction.
+ *                               Pointer write and data read of each
+ *                               register are joined by repeated start,
+ *                               whole transfer is one ioctl(I2C_RDWR)
+ * @param  int i2cfd         - i2c device file descriptor
+ * @param  char slv_addr     - slave address of device to read from
+ * @param  const unsigned char *regs - addresses of registers to read from
+ * @param  char (*words)[2]  - buffers to store read data, one per register
+ * @param  int nregs         - number of registers, max I2C_RDWR_MAX_REGS
+ * @return SUCCESS           - number of read bytes
+ *         ERROR             - -1 value, errno set appropriately
+ */
+int i2c_read_data_words(int i2cfd, char slv_addr, const unsigned char *regs,
+			char (*words)[2], int nregs)
+{
+  struct i2c_msg msgs[2 * I2C_RDWR_MAX_REGS];
+  struct i2c_rdwr_ioctl_data xfer;
+  int i;
+
+  if (nregs < 1 || nregs > I2C_RDWR_MAX_REGS) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (i = 0; i < nregs; i++) {
+    msgs[2 * i].addr = slv_addr;
+    msgs[2 * i].flags = 0;
+    msgs[2 * i].len = 1;
+    msgs[2 * i].buf = (unsigned char *)&regs[i];
+
+    msgs[2 * i + 1].addr = slv_addr;
+    msgs[2 * i + 1].flags = I2C_M_RD;
+    msgs[2 * i + 1].len = 2;
+    msgs[2 * i + 1].buf = (unsigned char *)words[i];
+  }
+
+  xfer.msgs = msgs;
+  xfer.nmsgs = 2 * nregs;
+
+  if (ioctl(i2cfd, I2C_RDWR, &xfer) == -1)
+    return -1;
+
+  return 2 * nregs;
+}
+
+
 /*
  * @func  i2c_read_byte_reg - function to read byte to RDbyte 
  *                            from register reg
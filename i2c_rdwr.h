@@ -0,0 +1,26 @@
+/*****************************************************************
+ * Title    : i2c_rdwr.h
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Header file of combined I2C transactions. Reads several
+ *            registers of slave device in one ioctl(I2C_RDWR)
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+#ifndef I2C_RDWR_H
+#define I2C_RDWR_H
+
+/****************************************************************/
+/******************* Symbolic Constant Definitions **************/
+/****************************************************************/
+// Kernel refuses more than I2C_RDWR_IOCTL_MAX_MSGS (42) messages,
+// each register costs pointer write + data read message
+#define I2C_RDWR_MAX_REGS  21
+
+/****************************************************************/
+/******************* Global Functions Declarations **************/
+/****************************************************************/
+int i2c_read_data_words(int i2cfd, char slv_addr, const unsigned char *regs,
+			char (*words)[2], int nregs);
+
+#endif // I2C_RDWR_H
@@ -0,0 +1,177 @@
+/*****************************************************************
+ * Title    : i2c_transport.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Source file of pluggable I2C transport and its Linux
+ *            i2c-dev backend built on functions from i2c.c
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+
+//#define SELF
+//#define DEBUG
+//#define PRINT
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/i2c.h"
+#include "../header/INA219.h"
+#include "i2c_rdwr.h"
+#include "i2c_transport.h"
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+static int dev_open(i2c_transport_s *t, const char *device, char slv_addr);
+static int dev_read_word(i2c_transport_s *t, const unsigned char *reg,
+			 char *word);
+static int dev_write_word(i2c_transport_s *t, const unsigned char *reg,
+			  short word);
+static int dev_read_words(i2c_transport_s *t, const unsigned char *regs,
+			  char (*words)[2], int nregs);
+static int dev_close(i2c_transport_s *t);
+
+const i2c_ops_s i2c_dev_ops = {
+  "i2c-dev",
+  dev_open,
+  dev_read_word,
+  dev_write_word,
+  dev_read_words,
+  dev_close
+};
+
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+#ifdef SELF
+int main(int argc, char *argv[])
+{
+  i2c_transport_s t;
+  unsigned char confReg = config_reg;
+  char RDbuf[2];
+
+  if (argc < 2 || strcmp(argv[1], "--help") == 0)
+    usageErr("%s </dev/i2c-* | sim[:opts]>\n", argv[0]);
+
+  if (i2c_transport_open(&t, argv[1], INA_SLV_ADDR) == -1)
+    errExit("i2c_transport_open");
+
+  if (i2c_tr_read_data_word(&t, &confReg, RDbuf) == -1)
+    errExit("i2c_tr_read_data_word");
+
+  printf("%s: value of conf reg: 0x%02x%02x\n", t.ops->name,
+	 (unsigned char)RDbuf[0], (unsigned char)RDbuf[1]);
+
+  i2c_tr_close(&t);
+  exit(EXIT_SUCCESS);
+}
+
+#endif // SELF
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+/* i2c-dev backend. Unlike i2c_init() it reports failure to caller
+ * instead of exiting, so caller decides how to surface the error */
+static int dev_open(i2c_transport_s *t, const char *device, char slv_addr)
+{
+  t->fd = open(device, O_RDWR);
+  if (t->fd == -1)
+    return -1;
+
+  if (ioctl(t->fd, I2C_SLAVE, slv_addr) == -1) {
+    close(t->fd);
+    t->fd = -1;
+    return -1;
+  }
+
+  return 0;
+}
+
+static int dev_read_word(i2c_transport_s *t, const unsigned char *reg,
+			 char *word)
+{
+  return i2c_read_data_word(t->fd, reg, word);
+}
+
+static int dev_write_word(i2c_transport_s *t, const unsigned char *reg,
+			  short word)
+{
+  return i2c_write_data_word(t->fd, reg, word);
+}
+
+static int dev_read_words(i2c_transport_s *t, const unsigned char *regs,
+			  char (*words)[2], int nregs)
+{
+  return i2c_read_data_words(t->fd, t->slvAddr, regs, words, nregs);
+}
+
+static int dev_close(i2c_transport_s *t)
+{
+  int ret = close(t->fd);
+
+  t->fd = -1;
+  return ret;
+}
+
+
+/****************************************************************/
+/**************** Global Functions Definitions ******************/
+/****************************************************************/
+
+/* @func  i2c_transport_open - select backend by device name and open it
+ * @param i2c_transport_s *t  - transport to initialize
+ * @param const char *device  - /dev/i2c-* file or "sim[:opts]" for
+ *                              simulated INA219
+ * @param char slv_addr       - slave address of INA219
+ * @return SUCCESS            - 0
+ *         ERROR              - -1, errno set appropriately
+ */
+int i2c_transport_open(i2c_transport_s *t, const char *device, char slv_addr)
+{
+  memset(t, 0, sizeof(*t));
+  t->fd = -1;
+  t->slvAddr = slv_addr;
+
+  if (strncmp(device, I2C_SIM_PREFIX, strlen(I2C_SIM_PREFIX)) == 0)
+    t->ops = &ina219_sim_ops;
+  else
+    t->ops = &i2c_dev_ops;
+
+  return t->ops->open(t, device, slv_addr);
+}
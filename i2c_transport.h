@@ -0,0 +1,115 @@
+/*****************************************************************
+ * Title    : i2c_transport.h
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Header file of pluggable I2C transport. Application
+ *            talks to INA219 through table of function pointers,
+ *            backed either by Linux i2c-dev or by simulated INA219
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+#ifndef I2C_TRANSPORT_H
+#define I2C_TRANSPORT_H
+
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include "measure.h"
+#include "lat_hist.h"
+
+/****************************************************************/
+/******************* Symbolic Constant Definitions **************/
+/****************************************************************/
+// Device names starting with this prefix select simulated INA219,
+// e.g. "sim:wave=square,i=0.2,i2=1.5,f=1,lat=150"
+#define I2C_SIM_PREFIX  "sim"
+
+/****************************************************************/
+/********************** New Types Definitions *******************/
+/****************************************************************/
+typedef struct i2c_transport_s i2c_transport_s;
+
+/* Operations every transport backend implements. Semantics and return
+ * values follow i2c_read_data_word(), i2c_write_data_word() and
+ * i2c_read_data_words() of i2c-dev implementation */
+typedef struct {
+  const char *name;
+  int (*open)(i2c_transport_s *t, const char *device, char slv_addr);
+  int (*read_word)(i2c_transport_s *t, const unsigned char *reg, char *word);
+  int (*write_word)(i2c_transport_s *t, const unsigned char *reg, short word);
+  int (*read_words)(i2c_transport_s *t, const unsigned char *regs,
+		    char (*words)[2], int nregs);
+  int (*close)(i2c_transport_s *t);
+} i2c_ops_s;
+
+struct i2c_transport_s {
+  const i2c_ops_s *ops;
+  int fd;                   // i2c device file descriptor (i2c-dev backend)
+  char slvAddr;             // slave address of INA219
+  void *priv;               // backend private state (simulator)
+  i2c_stats_s *stats;       // transaction statistics, NULL when not kept
+};
+
+/****************************************************************/
+/******************* Global Variable Declarations ***************/
+/****************************************************************/
+extern const i2c_ops_s i2c_dev_ops;
+extern const i2c_ops_s ina219_sim_ops;
+
+/****************************************************************/
+/******************* Global Functions Declarations **************/
+/****************************************************************/
+int i2c_transport_open(i2c_transport_s *t, const char *device, char slv_addr);
+
+static inline int i2c_tr_read_data_word(i2c_transport_s *t,
+					const unsigned char *reg, char *word)
+{
+  int64_t startNs;
+  int ret;
+
+  if (t->stats == NULL)
+    return t->ops->read_word(t, reg, word);
+
+  startNs = meas_now_ns();
+  ret = t->ops->read_word(t, reg, word);
+  i2c_stats_record(t->stats, I2C_OP_READ, *reg, startNs, ret);
+  return ret;
+}
+
+static inline int i2c_tr_write_data_word(i2c_transport_s *t,
+					 const unsigned char *reg, short word)
+{
+  int64_t startNs;
+  int ret;
+
+  if (t->stats == NULL)
+    return t->ops->write_word(t, reg, word);
+
+  startNs = meas_now_ns();
+  ret = t->ops->write_word(t, reg, word);
+  i2c_stats_record(t->stats, I2C_OP_WRITE, *reg, startNs, ret);
+  return ret;
+}
+
+static inline int i2c_tr_read_data_words(i2c_transport_s *t,
+					 const unsigned char *regs,
+					 char (*words)[2], int nregs)
+{
+  int64_t startNs;
+  int ret;
+
+  if (t->stats == NULL)
+    return t->ops->read_words(t, regs, words, nregs);
+
+  startNs = meas_now_ns();
+  ret = t->ops->read_words(t, regs, words, nregs);
+  i2c_stats_record(t->stats, I2C_OP_BLOCK, regs[0], startNs, ret);
+  return ret;
+}
+
+static inline int i2c_tr_close(i2c_transport_s *t)
+{
+  return t->ops->close(t);
+}
+
+#endif // I2C_TRANSPORT_H
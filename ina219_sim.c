@@ -0,0 +1,499 @@
+/*****************************************************************
+ * Title    : ina219_sim.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Source file of simulated INA219 transport backend.
+ *            Register values are computed the way datasheet
+ *            describes, so application code runs unchanged on any
+ *            Linux box without bench hardware
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+
+//#define SELF
+//#define DEBUG
+//#define PRINT
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <math.h>
+#include <time.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/INA219.h"
+#include "i2c_transport.h"
+#include "ina219_sim.h"
+#include "sampler.h"
+#include "ina_config.h"
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+#define CALIB_MASK      0xfffe      // bit 0 of calibration is read-only
+
+#define SHUNT_LSB       10e-6       // 10 uV
+#define BUS_LSB         4e-3        // 4 mV
+#define BUS_SHIFT       3
+
+#define AVG_POINTS      8           // waveform points averaged per conversion
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+static int sim_open(i2c_transport_s *t, const char *device, char slv_addr);
+static int sim_read_word(i2c_transport_s *t, const unsigned char *reg,
+			 char *word);
+static int sim_write_word(i2c_transport_s *t, const unsigned char *reg,
+			  short word);
+static int sim_read_words(i2c_transport_s *t, const unsigned char *regs,
+			  char (*words)[2], int nregs);
+static int sim_close(i2c_transport_s *t);
+
+static void sim_reset(ina219_sim_s *sim);
+static int sim_transaction(i2c_transport_s *t);
+static void sim_convert(ina219_sim_s *sim);
+static void sim_latch(ina219_sim_s *sim, double tEnd, double convSec);
+static unsigned short sim_get(ina219_sim_s *sim, unsigned char reg);
+static void sim_put(ina219_sim_s *sim, unsigned char reg, unsigned short val);
+
+const i2c_ops_s ina219_sim_ops = {
+  "ina219-sim",
+  sim_open,
+  sim_read_word,
+  sim_write_word,
+  sim_read_words,
+  sim_close
+};
+
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+#ifdef SELF
+int main(int argc, char *argv[])
+{
+  i2c_transport_s t;
+  const unsigned char regs[4] = {
+    shunt_volt_reg, bus_volt_reg, curr_data_reg, power_data_reg
+  };
+  unsigned char confReg = config_reg, calReg = calib_reg;
+  char words[4][2];
+  int i, j;
+
+  if (i2c_transport_open(&t, (argc > 1) ? argv[1] : "sim:wave=square",
+			 INA_SLV_ADDR) == -1)
+    errExit("i2c_transport_open");
+
+  i2c_tr_write_data_word(&t, &confReg, 0x1fff);
+  i2c_tr_write_data_word(&t, &calReg, 0x1400);
+
+  for (i = 0; i < 10; i++) {
+    usleep(100000);
+    i2c_tr_read_data_words(&t, regs, words, 4);
+    for (j = 0; j < 4; j++)
+      printf("0x%02x%02x ", (unsigned char)words[j][0],
+	     (unsigned char)words[j][1]);
+    printf("\n");
+  }
+
+  i2c_tr_close(&t);
+  exit(EXIT_SUCCESS);
+}
+
+#endif // SELF
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+static int sim_open(i2c_transport_s *t, const char *device, char slv_addr)
+{
+  ina219_sim_s *sim;
+  const char *opts;
+
+  sim = calloc(1, sizeof(*sim));
+  if (sim == NULL)
+    return -1;
+
+  // Defaults: 12 V board drawing 0.5 A through 0.1 ohm shunt
+  sim->rshunt = 0.1;
+  sim->load.wave = SIM_WAVE_CONST;
+  sim->load.busVolt = 12.0;
+  sim->load.currLow = 0.5;
+  sim->load.currHigh = 1.0;
+  sim->load.freq = 1.0;
+  sim->load.duty = 0.5;
+  sim->addr = INA_SLV_ADDR;
+
+  opts = strchr(device, ':');
+  if (opts != NULL && ina219_sim_parse(sim, opts + 1) == -1) {
+    free(sim);
+    errno = EINVAL;
+    return -1;
+  }
+
+  sim_reset(sim);
+  t->priv = sim;
+
+  return 0;
+}
+
+static int sim_read_word(i2c_transport_s *t, const unsigned char *reg,
+			 char *word)
+{
+  ina219_sim_s *sim = t->priv;
+  unsigned short val;
+
+  // Pointer write and data read are two transactions, as on i2c-dev
+  if (reg != NULL) {
+    if (sim_transaction(t) == -1)
+      return -1;
+    sim->ptr = *reg;
+  }
+  if (sim_transaction(t) == -1)
+    return -1;
+
+  val = sim_get(sim, sim->ptr);
+  word[0] = (char)(val >> 8);
+  word[1] = (char)(val & 0x00ff);
+
+  return 2;
+}
+
+static int sim_write_word(i2c_transport_s *t, const unsigned char *reg,
+			  short word)
+{
+  ina219_sim_s *sim = t->priv;
+
+  if (sim_transaction(t) == -1)
+    return -1;
+  if (*reg >= SIM_REGS) {
+    errno = EIO;
+    return -1;
+  }
+  sim->ptr = *reg;
+  sim_put(sim, *reg, (unsigned short)word);
+
+  return 3;
+}
+
+static int sim_read_words(i2c_transport_s *t, const unsigned char *regs,
+			  char (*words)[2], int nregs)
+{
+  ina219_sim_s *sim = t->priv;
+  unsigned short val;
+  int i;
+
+  // Combined transaction, one bus latency for all registers
+  if (sim_transaction(t) == -1)
+    return -1;
+  for (i = 0; i < nregs; i++) {
+    sim->ptr = regs[i];
+    val = sim_get(sim, regs[i]);
+    words[i][0] = (char)(val >> 8);
+    words[i][1] = (char)(val & 0x00ff);
+  }
+
+  return 2 * nregs;
+}
+
+static int sim_close(i2c_transport_s *t)
+{
+  free(t->priv);
+  t->priv = NULL;
+
+  return 0;
+}
+
+
+/* @func  sim_reset - power-on reset of simulated register map */
+static void sim_reset(ina219_sim_s *sim)
+{
+  memset(sim->regs, 0, sizeof(sim->regs));
+  sim->regs[config_reg] = SIM_CONF_POR;
+  sim->ptr = 0;
+  sim->lastConv = 0;
+  clock_gettime(CLOCK_MONOTONIC, &sim->start);
+}
+
+
+/* @func  sim_transaction - account one bus transaction and its latency,
+ *                           fail like NACK when addressed to other slave
+ *                           or when fault is injected
+ */
+static int sim_transaction(i2c_transport_s *t)
+{
+  ina219_sim_s *sim = t->priv;
+  struct timespec lat, now;
+
+  sim->transactions++;
+  if (sim->latencyNs > 0) {
+    lat.tv_sec = sim->latencyNs / NSEC_PER_SEC;
+    lat.tv_nsec = sim->latencyNs % NSEC_PER_SEC;
+    while (nanosleep(&lat, &lat) == -1 && errno == EINTR);
+  }
+
+  if (t->slvAddr != sim->addr) {
+    errno = EREMOTEIO;
+    return -1;
+  }
+
+  // Injected faults, glitch fails like timeout, cut device does not ACK
+  if (sim->errEvery > 0 && sim->transactions % sim->errEvery == 0) {
+    errno = ETIMEDOUT;
+    return -1;
+  }
+  if (sim->cutPeriod > 0) {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (fmod(now.tv_sec + now.tv_nsec / 1e9, sim->cutPeriod) < sim->cutLen) {
+      sim->cut = 1;
+      errno = EREMOTEIO;
+      return -1;
+    }
+    if (sim->cut) {
+      sim->cut = 0;
+      sim_reset(sim);
+    }
+  }
+
+  return 0;
+}
+
+
+/* @func  sim_convert - latch result of newest completed conversion.
+ *                      Conversions run back to back from start of
+ *                      sequence (reset or configuration write);
+ *                      triggered modes convert once only
+ */
+static void sim_convert(ina219_sim_s *sim)
+{
+  struct timespec now;
+  unsigned short conf = sim->regs[config_reg];
+  long convNs;
+  long long elapsedNs, conv;
+
+  convNs = ina219_conv_time_ns(conf);
+  if (convNs == 0)                   // power-down or ADC off
+    return;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  elapsedNs = (long long)(now.tv_sec - sim->start.tv_sec) * NSEC_PER_SEC
+    + (now.tv_nsec - sim->start.tv_nsec);
+
+  conv = elapsedNs / convNs;
+  if (!(conf & CONF_MODE_CONT) && conv > 1)
+    conv = 1;
+  if (conv <= sim->lastConv)
+    return;
+
+  sim->lastConv = conv;
+  sim_latch(sim, sim->start.tv_sec + sim->start.tv_nsec / 1e9
+	    + (double)conv * convNs / 1e9, convNs / 1e9);
+}
+
+
+/* @func  sim_latch - compute shunt, bus, current and power registers
+ *                    from load averaged over conversion window ending
+ *                    at tEnd, set CNVR and OVF flags
+ */
+static void sim_latch(ina219_sim_s *sim, double tEnd, double convSec)
+{
+  unsigned short conf = sim->regs[config_reg];
+  unsigned short mode = conf & CONF_MODE_MASK;
+  double curr = 0.0, shuntMax, busMax;
+  long shunt, bus, current, power;
+  int i, ovf = 0;
+
+  for (i = 0; i < AVG_POINTS; i++)
+    curr += ina219_sim_current(&sim->load,
+			       tEnd - convSec * (i + 0.5) / AVG_POINTS);
+  curr /= AVG_POINTS;
+
+  // Shunt voltage, full scale 40 mV divided by PGA gain 1/2/4/8
+  shuntMax = 0.040 * (1 << ((conf >> CONF_PG_SHIFT) & CONF_PG_MASK));
+  shunt = lround(curr * sim->rshunt / SHUNT_LSB);
+  if (labs(shunt) > lround(shuntMax / SHUNT_LSB)) {
+    shunt = (shunt < 0) ? -lround(shuntMax / SHUNT_LSB)
+      : lround(shuntMax / SHUNT_LSB);
+    ovf = 1;
+  }
+
+  busMax = (conf & CONF_BRNG) ? 32.0 : 16.0;
+  bus = lround(((sim->load.busVolt < busMax) ? sim->load.busVolt : busMax)
+	       / BUS_LSB);
+
+  // Current and power registers per datasheet equations 4 and 5
+  current = shunt * sim->regs[calib_reg] / 4096;
+  if (current > 32767 || current < -32768) {
+    current = (current < 0) ? -32768 : 32767;
+    ovf = 1;
+  }
+  power = labs(current) * bus / 5000;
+  if (power > 0xffff) {
+    power = 0xffff;
+    ovf = 1;
+  }
+
+  if (mode & 0x1)
+    sim->regs[shunt_volt_reg] = (unsigned short)(short)shunt;
+  if (mode & 0x2)
+    sim->regs[bus_volt_reg] = (unsigned short)(bus << BUS_SHIFT);
+  sim->regs[curr_data_reg] = (unsigned short)(short)current;
+  sim->regs[power_data_reg] = (unsigned short)power;
+
+  sim->regs[bus_volt_reg] |= CNVR;
+  if (ovf)
+    sim->regs[bus_volt_reg] |= OVF;
+  else
+    sim->regs[bus_volt_reg] &= ~OVF;
+}
+
+
+/* @func  sim_get - read register, reading power register clears CNVR */
+static unsigned short sim_get(ina219_sim_s *sim, unsigned char reg)
+{
+  unsigned short val;
+
+  if (reg >= SIM_REGS)
+    return 0;
+
+  sim_convert(sim);
+  val = sim->regs[reg];
+  if (reg == power_data_reg)
+    sim->regs[bus_volt_reg] &= ~CNVR;
+
+  return val;
+}
+
+
+/* @func  sim_put - write register, configuration write restarts
+ *                  conversion sequence and clears CNVR
+ */
+static void sim_put(ina219_sim_s *sim, unsigned char reg, unsigned short val)
+{
+  if (reg == config_reg) {
+    if (val & CONF_RST) {
+      sim_reset(sim);
+      return;
+    }
+    sim->regs[config_reg] = val;
+    sim->regs[bus_volt_reg] &= ~CNVR;
+    sim->lastConv = 0;
+    clock_gettime(CLOCK_MONOTONIC, &sim->start);
+  }
+  else if (reg == calib_reg)
+    sim->regs[calib_reg] = val & CALIB_MASK;
+  // Measurement registers are read-only
+}
+
+
+/****************************************************************/
+/**************** Global Functions Definitions ******************/
+/****************************************************************/
+
+/* @func  ina219_sim_parse - parse comma separated key=val options
+ * @param ina219_sim_s *sim - simulator to configure
+ * @param const char *opts  - e.g. "wave=sine,i=0.1,i2=2,f=0.2,lat=150"
+ * @return SUCCESS          - 0
+ *         ERROR            - -1, unknown key or value
+ */
+int ina219_sim_parse(ina219_sim_s *sim, const char *opts)
+{
+  char buf[256], *tok, *save, *val;
+
+  snprintf(buf, sizeof(buf), "%s", opts);
+
+  for (tok = strtok_r(buf, ",", &save); tok != NULL;
+       tok = strtok_r(NULL, ",", &save)) {
+    val = strchr(tok, '=');
+    if (val == NULL)
+      return -1;
+    *val++ = '\0';
+
+    if (strcmp(tok, "wave") == 0) {
+      if (strcmp(val, "const") == 0)
+	sim->load.wave = SIM_WAVE_CONST;
+      else if (strcmp(val, "square") == 0)
+	sim->load.wave = SIM_WAVE_SQUARE;
+      else if (strcmp(val, "sine") == 0)
+	sim->load.wave = SIM_WAVE_SINE;
+      else if (strcmp(val, "ramp") == 0)
+	sim->load.wave = SIM_WAVE_RAMP;
+      else
+	return -1;
+    }
+    else if (strcmp(tok, "v") == 0)
+      sim->load.busVolt = atof(val);
+    else if (strcmp(tok, "i") == 0)
+      sim->load.currLow = atof(val);
+    else if (strcmp(tok, "i2") == 0)
+      sim->load.currHigh = atof(val);
+    else if (strcmp(tok, "f") == 0)
+      sim->load.freq = atof(val);
+    else if (strcmp(tok, "duty") == 0)
+      sim->load.duty = atof(val) / 100.0;
+    else if (strcmp(tok, "r") == 0)
+      sim->rshunt = atof(val);
+    else if (strcmp(tok, "lat") == 0)
+      sim->latencyNs = atol(val) * 1000L;
+    else if (strcmp(tok, "addr") == 0)
+      sim->addr = (char)strtol(val, NULL, 0);
+    else if (strcmp(tok, "err") == 0)
+      sim->errEvery = strtoul(val, NULL, 0);
+    else if (strcmp(tok, "cut") == 0)
+      sim->cutPeriod = atof(val);
+    else if (strcmp(tok, "cutms") == 0)
+      sim->cutLen = atof(val) / 1000.0;
+    else
+      return -1;
+  }
+
+  return 0;
+}
+
+
+/* @func  ina219_sim_current - load current of waveform at time t
+ * @param const sim_load_s *load - load description
+ * @param double t               - time in seconds (CLOCK_MONOTONIC)
+ * @return current in A
+ */
+double ina219_sim_current(const sim_load_s *load, double t)
+{
+  double phase = (load->freq > 0.0) ? fmod(t * load->freq, 1.0) : 0.0;
+
+  switch (load->wave) {
+  case SIM_WAVE_SQUARE:
+    return (phase < load->duty) ? load->currHigh : load->currLow;
+  case SIM_WAVE_SINE:
+    return load->currLow + (load->currHigh - load->currLow)
+      * (1.0 + sin(2.0 * M_PI * phase)) / 2.0;
+  case SIM_WAVE_RAMP:
+    return load->currLow + (load->currHigh - load->currLow) * phase;
+  case SIM_WAVE_CONST:
+  default:
+    return load->currLow;
+  }
+}
@@ -0,0 +1,73 @@
+/*****************************************************************
+ * Title    : ina219_sim.h
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Header file of in-process simulated INA219. Models
+ *            register map, calibration, conversion timing, CNVR/OVF
+ *            bits, bus latency and programmable load waveforms
+ * Version  : 1.00
+ * Options  : sim[:key=val,...] - wave=const|square|sine|ramp,
+ *            v=<bus V>, i=<A>, i2=<A>, f=<Hz>, duty=<%>,
+ *            r=<shunt ohm>, lat=<us per transaction>,
+ *            addr=<slave address, default 0x40>,
+ *            err=<every Nth transaction fails>,
+ *            cut=<period s>, cutms=<ms device is gone each period,
+ *            power-on reset when it returns>
+ ****************************************************************/
+#ifndef INA219_SIM_H
+#define INA219_SIM_H
+
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <time.h>
+
+/****************************************************************/
+/******************* Symbolic Constant Definitions **************/
+/****************************************************************/
+#define SIM_REGS        6           // configuration .. calibration
+#define SIM_CONF_POR    0x399f      // configuration after power-on reset
+
+/****************************************************************/
+/********************** New Types Definitions *******************/
+/****************************************************************/
+typedef enum {
+  SIM_WAVE_CONST = 0,
+  SIM_WAVE_SQUARE,
+  SIM_WAVE_SINE,
+  SIM_WAVE_RAMP
+} sim_wave_e;
+
+// Load drawn by simulated board
+typedef struct {
+  sim_wave_e wave;
+  double busVolt;             // bus voltage in V
+  double currLow;             // current in A (const, low level)
+  double currHigh;            // current in A (high level)
+  double freq;                // waveform frequency in Hz
+  double duty;                // square wave high time 0.0 - 1.0
+} sim_load_s;
+
+typedef struct {
+  unsigned short regs[SIM_REGS];
+  unsigned char ptr;          // register pointer
+  char addr;                  // slave address device answers on
+  double rshunt;              // shunt resistor in ohm
+  long latencyNs;             // added to every bus transaction
+  sim_load_s load;
+  struct timespec start;      // start of current conversion sequence
+  long long lastConv;         // index of last latched conversion
+  unsigned long transactions; // bus transactions served
+  unsigned long errEvery;     // fail every Nth transaction, 0 never
+  double cutPeriod;           // device disconnected periodically, s
+  double cutLen;              // length of disconnection, s
+  int cut;                    // device disconnected at last transaction
+} ina219_sim_s;
+
+/****************************************************************/
+/******************* Global Functions Declarations **************/
+/****************************************************************/
+int ina219_sim_parse(ina219_sim_s *sim, const char *opts);
+double ina219_sim_current(const sim_load_s *load, double t);
+
+#endif // INA219_SIM_H
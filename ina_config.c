@@ -0,0 +1,230 @@
+/*****************************************************************
+ * Title    : ina_config.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Source file of INA219 ADC configuration. Turns profile
+ *            name or key=val list into configuration register value
+ *            and sample rate, applied at start or by 'config' command
+ * Version  : 1.00
+ * Options  : SELF build parses spec: <spec> [confRegVal]
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+
+//#define SELF
+//#define DEBUG
+//#define PRINT
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include "../header/tlpi_hdr.h"
+#include "sampler.h"
+#include "ina_config.h"
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+#define SPEC_LEN         256
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+
+/* Shunt and bus ADC set alike. Rates keep sampling below ADC limit:
+ * fast 2x84 us, balanced 2x8.51 ms (16 samples), precise 2x68.1 ms */
+static const ina_profile_s profiles[] = {
+  { "fast",     CONF_ADC_9BIT,         1000 },
+  { "balanced", CONF_ADC_AVG | 0x4,      50 },
+  { "precise",  CONF_ADC_AVG | 0x7,       7 }
+};
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+static int adc_code(const char *val, unsigned short *code);
+static void conf_field(unsigned short *conf, unsigned short val,
+		       int shift, unsigned short mask);
+
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+#ifdef SELF
+int main(int argc, char *argv[])
+{
+  ina_config_s cfg = { 0x399f, 0x1400, SMPL_RATE_DEF };
+
+  if (argc < 2 || strcmp(argv[1], "--help") == 0)
+    usageErr("%s <spec> [confRegVal]\n", argv[0]);
+  if (argc > 2)
+    cfg.conf = (unsigned short)getInt(argv[2], GN_ANY_BASE, "confRegVal");
+
+  if (ina_config_parse(argv[1], &cfg) == -1)
+    errExit("ina_config_parse %s", argv[1]);
+
+  printf("conf 0x%04hx calib 0x%04hx conv %ld ns rate %ld Hz (max %ld Hz)\n",
+	 cfg.conf, cfg.calib, ina219_conv_time_ns(cfg.conf), cfg.rate,
+	 ina219_max_rate(cfg.conf));
+
+  exit(EXIT_SUCCESS);
+}
+
+#endif // SELF
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+/* @func  adc_code - ADC field value of "9bit".."12bit" resolution or
+ *                   1..128 averaged samples (power of two)
+ * @return SUCCESS  - 0
+ *         ERROR    - -1, unknown value
+ */
+static int adc_code(const char *val, unsigned short *code)
+{
+  char *endptr;
+  long n;
+  int i;
+
+  n = strtol(val, &endptr, 10);
+  if (strcmp(endptr, "bit") == 0 && n >= 9 && n <= 12) {
+    *code = CONF_ADC_9BIT + (n - 9);
+    return 0;
+  }
+  if (*endptr != '\0')
+    return -1;
+
+  for (i = 0; i <= 7; i++) {
+    if (n == 1L << i) {
+      *code = CONF_ADC_AVG | i;
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+
+/* @func  conf_field - replace bit field of configuration register */
+static void conf_field(unsigned short *conf, unsigned short val,
+		       int shift, unsigned short mask)
+{
+  *conf = (*conf & ~(mask << shift)) | ((val & mask) << shift);
+}
+
+
+/****************************************************************/
+/**************** Global Functions Definitions ******************/
+/****************************************************************/
+
+/* @func  ina_config_parse - apply profile or key=val list to config.
+ *                           Fields not named in spec keep their value,
+ *                           profile leaves rate of CNVR pacing alone
+ * @param const char *spec   - profile name or key=val,...
+ * @param ina_config_s *cfg  - current config, updated only on success
+ * @return SUCCESS           - 0
+ *         ERROR             - -1, errno EINVAL
+ */
+int ina_config_parse(const char *spec, ina_config_s *cfg)
+{
+  char buf[SPEC_LEN], *tok, *save, *val, *endptr;
+  ina_config_s c = *cfg;
+  unsigned short code;
+  long n;
+  size_t i;
+
+  for (i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+    if (strcmp(spec, profiles[i].name) == 0) {
+      conf_field(&cfg->conf, profiles[i].adc, CONF_SADC_SHIFT, CONF_ADC_MASK);
+      conf_field(&cfg->conf, profiles[i].adc, CONF_BADC_SHIFT, CONF_ADC_MASK);
+      if (cfg->rate != SMPL_RATE_CNVR)
+	cfg->rate = profiles[i].rate;
+      return 0;
+    }
+  }
+
+  snprintf(buf, sizeof(buf), "%s", spec);
+
+  for (tok = strtok_r(buf, ",", &save); tok != NULL;
+       tok = strtok_r(NULL, ",", &save)) {
+    val = strchr(tok, '=');
+    if (val == NULL)
+      goto inval;
+    *val++ = '\0';
+
+    if (strcmp(tok, "adc") == 0 || strcmp(tok, "sadc") == 0
+	|| strcmp(tok, "badc") == 0) {
+      if (adc_code(val, &code) == -1)
+	goto inval;
+      if (tok[0] != 'b')
+	conf_field(&c.conf, code, CONF_SADC_SHIFT, CONF_ADC_MASK);
+      if (tok[0] != 's')
+	conf_field(&c.conf, code, CONF_BADC_SHIFT, CONF_ADC_MASK);
+    }
+    else if (strcmp(tok, "pga") == 0) {
+      // Auto-ranged gain starts at /8, no shunt voltage overflows it
+      if (strcmp(val, "auto") == 0) {
+	c.conf |= CONF_AUTO_PGA;
+	conf_field(&c.conf, 3, CONF_PG_SHIFT, CONF_PG_MASK);
+	continue;
+      }
+      n = strtol(val, &endptr, 10);
+      if (*endptr != '\0' || (n != 1 && n != 2 && n != 4 && n != 8))
+	goto inval;
+      c.conf &= ~CONF_AUTO_PGA;
+      conf_field(&c.conf, (n == 8) ? 3 : n / 2, CONF_PG_SHIFT, CONF_PG_MASK);
+    }
+    else if (strcmp(tok, "brng") == 0) {
+      if (strcmp(val, "16") == 0)
+	c.conf &= ~CONF_BRNG;
+      else if (strcmp(val, "32") == 0)
+	c.conf |= CONF_BRNG;
+      else
+	goto inval;
+    }
+    else if (strcmp(tok, "mode") == 0) {
+      if (strcmp(val, "both") == 0)
+	code = CONF_MODE_CONT | CONF_MODE_SHUNT | CONF_MODE_BUS;
+      else if (strcmp(val, "shunt") == 0)
+	code = CONF_MODE_CONT | CONF_MODE_SHUNT;
+      else if (strcmp(val, "bus") == 0)
+	code = CONF_MODE_CONT | CONF_MODE_BUS;
+      else
+	goto inval;
+      conf_field(&c.conf, code, 0, CONF_MODE_MASK);
+    }
+    else if (strcmp(tok, "rate") == 0) {
+      n = strtol(val, &endptr, 10);
+      if (*endptr != '\0' || n < SMPL_RATE_MIN)
+	goto inval;
+      if (c.rate != SMPL_RATE_CNVR)
+	c.rate = n;
+    }
+    else
+      goto inval;
+  }
+
+  *cfg = c;
+  return 0;
+
+ inval:
+  errno = EINVAL;
+  return -1;
+}
@@ -0,0 +1,65 @@
+/*****************************************************************
+ * Title    : ina_config.h
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Header file of INA219 ADC configuration. Bit fields of
+ *            configuration register, named latency/noise profiles and
+ *            parser of configuration specs used by -p option and
+ *            'config' command
+ * Version  : 1.00
+ * Options  : spec is profile name (fast, balanced, precise) or
+ *            key=val,... - adc|sadc|badc=9bit..12bit or 1..128
+ *            samples, pga=1|2|4|8|auto, brng=16|32, mode=both|shunt|bus,
+ *            rate=<Hz>. Calibration stays 0x1400, LSB of currConv()
+ *            and pwrConv() holds only for it
+ ****************************************************************/
+#ifndef INA_CONFIG_H
+#define INA_CONFIG_H
+
+/****************************************************************/
+/******************* Symbolic Constant Definitions **************/
+/****************************************************************/
+
+// Bit fields of INA219 configuration register (datasheet figure 19)
+#define CONF_RST         0x8000
+#define CONF_AUTO_PGA    0x4000      // not written: unused bit marks auto gain
+#define CONF_BRNG        0x2000      // 0 - 16 V, 1 - 32 V bus range
+#define CONF_PG_SHIFT    11
+#define CONF_PG_MASK     0x0003      // gain /1, /2, /4, /8
+#define CONF_BADC_SHIFT  7
+#define CONF_SADC_SHIFT  3
+#define CONF_ADC_MASK    0x000f
+#define CONF_MODE_MASK   0x0007
+#define CONF_MODE_SHUNT  0x0001      // mode bits measuring shunt
+#define CONF_MODE_BUS    0x0002      // mode bits measuring bus
+#define CONF_MODE_CONT   0x0004      // continuous modes 5-7
+
+// ADC field values, 0x0-0x3 resolution, 0x8-0xf averaging 1-128 samples
+#define CONF_ADC_9BIT    0x0
+#define CONF_ADC_12BIT   0x3
+#define CONF_ADC_AVG     0x8
+
+#define CONF_NAME_LEN    16
+
+/****************************************************************/
+/********************** New Types Definitions *******************/
+/****************************************************************/
+typedef struct {
+  unsigned short conf;        // configuration register
+  unsigned short calib;       // calibration register, of /8 range
+  long rate;                  // sample rate in Hz or SMPL_RATE_CNVR
+} ina_config_s;
+
+// Named trade-off between latency and noise, PGA is left to hardware
+typedef struct {
+  char name[CONF_NAME_LEN];
+  unsigned short adc;         // SADC and BADC field value
+  long rate;                  // sample rate in Hz
+} ina_profile_s;
+
+/****************************************************************/
+/******************* Global Functions Declarations **************/
+/****************************************************************/
+int ina_config_parse(const char *spec, ina_config_s *cfg);
+
+#endif // INA_CONFIG_H
@@ -0,0 +1,504 @@
+/*****************************************************************
+ * Title    : ina_dev.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Source file of INA219 device list. Several boards are
+ *            measured at once, each device is (bus, slave address)
+ *            pair, devices sharing bus are served by one worker.
+ *            Register access repeats failed transactions with backoff
+ *            and reopens bus, restoring registers lost by reset
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+
+//#define SELF
+#define DEBUG
+//#define PRINT
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <time.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/INA219.h"
+#include "i2c_transport.h"
+#include "ina_dev.h"
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+
+// Bits reading always zero, used to tell INA219 from other devices
+#define CONF_UNUSED_BIT  0x4000
+#define BUS_UNUSED_BIT   0x0004
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+// Kinds of transaction repeated by ina_dev_xfer()
+typedef enum {
+  XFER_READ = 0,
+  XFER_READ_BLOCK,
+  XFER_WRITE
+} xfer_e;
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+static gid_t busGid = (gid_t)-1;    // effective gid buses were opened with
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+static int ina_dev_try(ina_dev_s *dev, xfer_e kind, const unsigned char *regs,
+		       char (*words)[2], int nregs, short word);
+static int ina_dev_xfer(ina_dev_s *dev, xfer_e kind, const unsigned char *regs,
+			char (*words)[2], int nregs, short word);
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+#ifdef SELF
+int main(int argc, char *argv[])
+{
+  ina_dev_s devs[INA_MAX_DEVS];
+  int i, n;
+
+  if (argc < 2 || strcmp(argv[1], "--help") == 0)
+    usageErr("%s <file /dev/i2c-* | sim[:opts]>\n", argv[0]);
+
+  n = ina_dev_scan(argv[1], devs, INA_MAX_DEVS);
+  for (i = 0; i < n; i++)
+    printf("INA219 found on %s at 0x%02x\n", devs[i].bus, devs[i].addr);
+
+  exit(EXIT_SUCCESS);
+}
+
+#endif // SELF
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+/* @func  ina_dev_try - one attempt of transaction */
+static int ina_dev_try(ina_dev_s *dev, xfer_e kind, const unsigned char *regs,
+		       char (*words)[2], int nregs, short word)
+{
+  switch (kind) {
+  case XFER_READ:
+    return i2c_tr_read_data_word(&dev->tr, regs, words[0]);
+  case XFER_READ_BLOCK:
+    return i2c_tr_read_data_words(&dev->tr, regs, words, nregs);
+  default:
+    return i2c_tr_write_data_word(&dev->tr, regs, word);
+  }
+}
+
+
+/* @func  ina_dev_xfer - transaction repeated up to INA_RETRIES times,
+ *                       backoff doubling from INA_RETRY_NS. Glitch of
+ *                       long cable costs few ms, device which still
+ *                       does not answer gets bus reopened once
+ * @return SUCCESS        - result of transaction
+ *         ERROR          - -1, errno set by last attempt
+ */
+static int ina_dev_xfer(ina_dev_s *dev, xfer_e kind, const unsigned char *regs,
+			char (*words)[2], int nregs, short word)
+{
+  struct timespec backoff;
+  long ns = INA_RETRY_NS;
+  int ret, i, err;
+
+  for (i = 0; ; i++) {
+    if ((ret = ina_dev_try(dev, kind, regs, words, nregs, word)) != -1)
+      return ret;
+    if (i == INA_RETRIES)
+      break;
+
+    // INA_RETRY_NS << INA_RETRIES stays below one second
+    backoff.tv_sec = 0;
+    backoff.tv_nsec = ns;
+    nanosleep(&backoff, NULL);
+    ns *= 2;
+    i2c_stats_retry(dev->tr.stats);
+  }
+
+  err = errno;
+  if (ina_dev_recover(dev) == -1) {
+    errno = err;
+    return -1;
+  }
+  return ina_dev_try(dev, kind, regs, words, nregs, word);
+}
+
+
+/****************************************************************/
+/**************** Global Functions Definitions ******************/
+/****************************************************************/
+
+/* @func  ina_dev_parse - parse device specification <bus>[@addr]
+ * @param const char *spec - specification, address defaults to
+ *                           INA_SLV_ADDR
+ * @param ina_dev_s *dev   - device to fill
+ * @return SUCCESS         - 0
+ *         ERROR           - -1, errno set to EINVAL
+ */
+int ina_dev_parse(const char *spec, ina_dev_s *dev)
+{
+  const char *sep;
+  char *endptr;
+  size_t len;
+  long addr = INA_SLV_ADDR;
+
+  memset(dev, 0, sizeof(*dev));
+  dev->tr.fd = -1;
+
+  sep = strrchr(spec, INA_ADDR_SEP);
+  len = (sep != NULL) ? (size_t)(sep - spec) : strlen(spec);
+  if (len == 0 || len >= INA_BUS_LEN) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (sep != NULL) {
+    errno = 0;
+    addr = strtol(sep + 1, &endptr, 0);
+    if (errno != 0 || *endptr != '\0' || addr < 0x03 || addr > 0x77) {
+      errno = EINVAL;
+      return -1;
+    }
+  }
+
+  memcpy(dev->bus, spec, len);
+  dev->bus[len] = '\0';
+  dev->addr = (char)addr;
+
+  return 0;
+}
+
+
+/* @func  ina_dev_probe - check INA219 answers on given address.
+ *                        Only reads registers, never writes to
+ *                        unknown device
+ * @param const char *bus - /dev/i2c-* or sim[:opts]
+ * @param char addr       - slave address to probe
+ * @return 1 INA219 found, 0 otherwise
+ */
+int ina_dev_probe(const char *bus, char addr)
+{
+  i2c_transport_s tr;
+  const unsigned char regs[2] = { config_reg, bus_volt_reg };
+  char words[2][2];
+  unsigned short conf, busv;
+  int found = 0;
+
+  if (i2c_transport_open(&tr, bus, addr) == -1)
+    return 0;
+
+  if (i2c_tr_read_data_words(&tr, regs, words, 2) != -1) {
+    conf = (unsigned short)(((unsigned char)words[0][0] << 8)
+			    | (unsigned char)words[0][1]);
+    busv = (unsigned short)(((unsigned char)words[1][0] << 8)
+			    | (unsigned char)words[1][1]);
+    found = !(conf & CONF_UNUSED_BIT) && !(busv & BUS_UNUSED_BIT);
+  }
+
+  i2c_tr_close(&tr);
+  return found;
+}
+
+
+/* @func  ina_dev_scan - find all INA219 on bus
+ * @param const char *bus  - /dev/i2c-* or sim[:opts]
+ * @param ina_dev_s *devs  - array to append found devices to
+ * @param int maxDevs      - capacity of devs
+ * @return number of devices found
+ */
+int ina_dev_scan(const char *bus, ina_dev_s *devs, int maxDevs)
+{
+  int addr, n = 0;
+
+  if (strlen(bus) >= INA_BUS_LEN)
+    return 0;
+
+  for (addr = INA_ADDR_FIRST; addr <= INA_ADDR_LAST && n < maxDevs; addr++) {
+    if (!ina_dev_probe(bus, (char)addr))
+      continue;
+
+    memset(&devs[n], 0, sizeof(devs[n]));
+    strcpy(devs[n].bus, bus);
+    devs[n].addr = (char)addr;
+    devs[n].tr.fd = -1;
+    n++;
+  }
+
+  return n;
+}
+
+
+/* @func  ina_dev_group - assign bus worker index to every device,
+ *                        devices on same bus get same index
+ * @return number of distinct buses
+ */
+int ina_dev_group(ina_dev_s *devs, int ndev)
+{
+  int i, j, nbus = 0;
+
+  for (i = 0; i < ndev; i++) {
+    for (j = 0; j < i; j++)
+      if (strcmp(devs[i].bus, devs[j].bus) == 0)
+	break;
+    devs[i].busIdx = (j < i) ? devs[j].busIdx : nbus++;
+  }
+
+  return nbus;
+}
+
+
+/* @func  ina_dev_open - open transport of device
+ * @return SUCCESS      - 0
+ *         ERROR        - -1, errno set appropriately
+ */
+int ina_dev_open(ina_dev_s *dev)
+{
+  return i2c_transport_open(&dev->tr, dev->bus, dev->addr);
+}
+
+
+/* @func  ina_dev_setup - reset INA219, write configuration and
+ *                        calibration registers
+ * @param ina_dev_s *dev     - opened device
+ * @param short confRegVal   - value of configuration register,
+ *                            CONF_AUTO_PGA starts gain ranging
+ * @param short calibRegVal  - value of calibration register, of /8
+ *                            range when gain is ranged
+ * @return SUCCESS           - 0
+ *         ERROR             - -1, error reported on stderr
+ */
+int ina_dev_setup(ina_dev_s *dev, short confRegVal, short calibRegVal)
+{
+  unsigned char configuration = config_reg;
+  unsigned char calibration = calib_reg;
+  int numWritten;
+#ifdef DEBUG
+  char RDbuf[2];
+  short regVal;
+#endif // DEBUG
+
+  /************************ Registers configuration **************************/
+  // Reset configuration register on each start
+  dev->conf = (unsigned short)confRegVal;
+  dev->calib = (unsigned short)calibRegVal;
+  autorange_init(&dev->range, &dev->conf, &dev->calib);
+  numWritten = ina_dev_write_word(dev, configuration, setreg(reset, 0, 0, 0));
+  if (numWritten == -1) {
+    fprintf(stderr,
+	    "{ \"ERROR\":\"i2c_write_data_word(reset-config-reg)\" }\n");
+    return -1;
+  }
+
+#ifdef DEBUG
+  // Read init data from configuration register of INA219
+  if (i2c_tr_read_data_word(&dev->tr, &configuration, RDbuf) == -1) {
+    fprintf(stderr,
+	    "{ \"ERROR\":\"i2c_read_data_word(configuration_reg)\" }\n");
+    return -1;
+  }
+  strtosh(RDbuf, regVal);
+  fprintf(stderr, "[0x%02x] The init value of configuration register: 0x%02hx\n",
+	  dev->addr, regVal);
+#endif // DEBUG
+
+  // Write confRegVal value in configuration register
+  numWritten = ina_dev_write_word(dev, configuration, (short)dev->conf);
+  if (numWritten == -1) {
+    fprintf(stderr,
+	    "{ \"ERROR\":\"i2c_write_data_word(set-config-reg)\" }\n");
+    return -1;
+  }
+
+#ifdef DEBUG
+  // Re-read, if confRegVal value set correctly in configuration register
+  if (i2c_tr_read_data_word(&dev->tr, &configuration, RDbuf) == -1) {
+    fprintf(stderr,
+	    "read-set-conf-register\n");
+    return -1;
+  }
+  strtosh(RDbuf, regVal);
+  fprintf(stderr, "[0x%02x] The set value of config register: 0x%02hx\n",
+	  dev->addr, regVal);
+#endif // DEBUG
+
+  // Write calibRegVal value in calibration register
+  numWritten = ina_dev_write_word(dev, calibration, (short)dev->calib);
+  if (numWritten == -1) {
+    fprintf(stderr,
+	    "{ \"ERROR\":\"i2c_write_data_word(set-calib-reg)\" }\n");
+    return -1;
+  }
+
+#ifdef DEBUG
+  // Re-read calibRegVal value set correctly in calibration register
+  if (i2c_tr_read_data_word(&dev->tr, &calibration, RDbuf) == -1) {
+    fprintf(stderr,
+	    "i2c_read_data_word-calib-reg-set\n");
+    return -1;
+  }
+  strtosh(RDbuf, regVal);
+  fprintf(stderr, "[0x%02x] The set value of calibration register: 0x%02hx\n",
+	  dev->addr, regVal);
+#endif // DEBUG
+
+  return 0;
+}
+
+
+/* @func  ina_dev_config - write configuration and calibration registers
+ *                         of running device, conversion restarts with
+ *                         new settings. Values are kept even when write
+ *                         fails, recovery of device applies them
+ * @param ina_dev_s *dev     - opened device
+ * @param short confRegVal   - value of configuration register,
+ *                            CONF_AUTO_PGA starts gain ranging
+ * @param short calibRegVal  - value of calibration register, of /8
+ *                            range when gain is ranged
+ * @return SUCCESS           - 0
+ *         ERROR             - -1, errno set appropriately
+ */
+int ina_dev_config(ina_dev_s *dev, short confRegVal, short calibRegVal)
+{
+  dev->conf = (unsigned short)confRegVal;
+  dev->calib = (unsigned short)calibRegVal;
+  autorange_init(&dev->range, &dev->conf, &dev->calib);
+
+  if (ina_dev_write_word(dev, config_reg, (short)dev->conf) == -1)
+    return -1;
+
+  return ina_dev_write_word(dev, calib_reg, (short)dev->calib);
+}
+
+
+/* @func  ina_dev_read_word - read register, failures repeated
+ * @return SUCCESS        - 2
+ *         ERROR          - -1, errno set appropriately
+ */
+int ina_dev_read_word(ina_dev_s *dev, unsigned char reg, char *word)
+{
+  return ina_dev_xfer(dev, XFER_READ, &reg, (char (*)[2])word, 1, 0);
+}
+
+
+/* @func  ina_dev_read_words - read registers in one transaction,
+ *                             failures repeated
+ * @return SUCCESS        - 2 * nregs
+ *         ERROR          - -1, errno set appropriately
+ */
+int ina_dev_read_words(ina_dev_s *dev, const unsigned char *regs,
+		       char (*words)[2], int nregs)
+{
+  return ina_dev_xfer(dev, XFER_READ_BLOCK, regs, words, nregs, 0);
+}
+
+
+/* @func  ina_dev_write_word - write register, failures repeated
+ * @return SUCCESS        - 3
+ *         ERROR          - -1, errno set appropriately
+ */
+int ina_dev_write_word(ina_dev_s *dev, unsigned char reg, short word)
+{
+  return ina_dev_xfer(dev, XFER_WRITE, &reg, NULL, 1, word);
+}
+
+
+/* @func  ina_dev_check - compare configuration and calibration of
+ *                        device with values written. Power-on reset
+ *                        clears calibration, so current and power
+ *                        would read zero; both are written back then
+ * @return SUCCESS        - 0 registers intact, 1 registers restored
+ *         ERROR          - -1, errno set appropriately
+ */
+int ina_dev_check(ina_dev_s *dev)
+{
+  static const unsigned char regs[2] = { config_reg, calib_reg };
+  unsigned char reg;
+  char words[2][2];
+  unsigned short conf, calib;
+
+  if (i2c_tr_read_data_words(&dev->tr, regs, words, 2) == -1)
+    return -1;
+
+  conf = (unsigned short)(((unsigned char)words[0][0] << 8)
+			  | (unsigned char)words[0][1]);
+  calib = (unsigned short)(((unsigned char)words[1][0] << 8)
+			   | (unsigned char)words[1][1]);
+  if (conf == dev->conf && calib == dev->calib)
+    return 0;
+
+  reg = config_reg;
+  if (i2c_tr_write_data_word(&dev->tr, &reg, (short)dev->conf) == -1)
+    return -1;
+  reg = calib_reg;
+  if (i2c_tr_write_data_word(&dev->tr, &reg, (short)dev->calib) == -1)
+    return -1;
+
+  return 1;
+}
+
+
+/* @func  ina_dev_keep_gid - remember effective gid buses were opened
+ *                           with, before caller drops it. Saved
+ *                           set-group-ID keeps it, so ina_dev_recover()
+ *                           can take it back around open() only
+ * @param gid_t gid       - effective gid of setgid install, usually i2c
+ */
+void ina_dev_keep_gid(gid_t gid)
+{
+  busGid = gid;
+}
+
+
+/* @func  ina_dev_recover - reopen bus of device which stopped answering
+ *                          and restore its registers. Transaction
+ *                          statistics stay attached. Bus device is
+ *                          opened with gid of ina_dev_keep_gid(), real
+ *                          gid is effective again right after
+ * @return SUCCESS        - 0
+ *         ERROR          - -1, errno set appropriately
+ */
+int ina_dev_recover(ina_dev_s *dev)
+{
+  i2c_stats_s *stats = dev->tr.stats;
+  int ret, err;
+
+  i2c_stats_reopen(stats);
+  i2c_tr_close(&dev->tr);
+  if (busGid != (gid_t)-1 && setegid(busGid) == -1) {
+    dev->tr.stats = stats;
+    return -1;
+  }
+  ret = ina_dev_open(dev);
+  err = errno;
+  if (busGid != (gid_t)-1 && setegid(getgid()) == -1)
+    errExit("setegid-back-real-gid");
+  dev->tr.stats = stats;
+  if (ret == -1) {
+    errno = err;
+    return -1;
+  }
+
+  return (ina_dev_check(dev) == -1) ? -1 : 0;
+}
@@ -0,0 +1,74 @@
+/*****************************************************************
+ * Title    : ina_dev.h
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Header file of INA219 device list. Parses (bus, address)
+ *            specifications, scans buses for INA219 and groups
+ *            devices by physical bus
+ * Version  : 1.00
+ * Options  : <bus>[@addr], e.g. /dev/i2c-1@0x41 or sim:i=0.2@0x40
+ ****************************************************************/
+#ifndef INA_DEV_H
+#define INA_DEV_H
+
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <stdint.h>
+#include <sys/types.h>
+#include "i2c_transport.h"
+#include "autorange.h"
+
+/****************************************************************/
+/******************* Symbolic Constant Definitions **************/
+/****************************************************************/
+#define INA_MAX_DEVS     16
+#define INA_ADDR_FIRST   0x40      // A1/A0 strapping gives 0x40 - 0x4f
+#define INA_ADDR_LAST    0x4f
+#define INA_ADDR_SEP     '@'
+#define INA_BUS_LEN      128
+
+// Fault handling, failed transaction is repeated after backoff
+#define INA_RETRIES      3              // repeats, backoff doubles
+#define INA_RETRY_NS     1000000L       // backoff before first repeat
+#define INA_REOPEN_MIN_NS 10000000LL    // offline device, first recovery
+#define INA_REOPEN_MAX_NS 1000000000LL  // longest wait between recoveries
+#define INA_VERIFY_NS    1000000000LL   // registers checked for reset
+
+/****************************************************************/
+/********************** New Types Definitions *******************/
+/****************************************************************/
+typedef struct {
+  char bus[INA_BUS_LEN];      // /dev/i2c-* or sim[:opts]
+  char addr;                  // slave address
+  int busIdx;                 // index of bus worker serving device
+  i2c_transport_s tr;
+  unsigned short conf;        // configuration written, restored after reset
+  unsigned short calib;       // calibration written, restored after reset
+  int64_t reopenNs;           // next recovery of offline device, 0 online
+  int64_t reopenStepNs;       // wait between recoveries, doubles
+  int64_t verifyNs;           // next check of registers for reset
+  int lost;                   // samples lost, next one marks gap
+  int cleared;                // clear served, next sample marks it
+  autorange_s range;          // PGA gain ranging, conf and calib follow it
+} ina_dev_s;
+
+/****************************************************************/
+/******************* Global Functions Declarations **************/
+/****************************************************************/
+int ina_dev_parse(const char *spec, ina_dev_s *dev);
+int ina_dev_probe(const char *bus, char addr);
+int ina_dev_scan(const char *bus, ina_dev_s *devs, int maxDevs);
+int ina_dev_group(ina_dev_s *devs, int ndev);
+int ina_dev_open(ina_dev_s *dev);
+int ina_dev_setup(ina_dev_s *dev, short confRegVal, short calibRegVal);
+int ina_dev_config(ina_dev_s *dev, short confRegVal, short calibRegVal);
+int ina_dev_read_word(ina_dev_s *dev, unsigned char reg, char *word);
+int ina_dev_read_words(ina_dev_s *dev, const unsigned char *regs,
+		       char (*words)[2], int nregs);
+int ina_dev_write_word(ina_dev_s *dev, unsigned char reg, short word);
+int ina_dev_check(ina_dev_s *dev);
+void ina_dev_keep_gid(gid_t gid);
+int ina_dev_recover(ina_dev_s *dev);
+
+#endif // INA_DEV_H
@@ -0,0 +1,278 @@
+/*****************************************************************
+ * Title    : lat_hist.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Source file of latency histograms. Writer owns histogram
+ *            and updates it with relaxed load and store, readers see
+ *            every counter whole and tolerate skew between them
+ * Version  : 1.00
+ * Options  : SELF build checks quantiles against exact values:
+ *            [samples]
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+
+//#define SELF
+//#define DEBUG
+//#define PRINT
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include "../header/tlpi_hdr.h"
+#include "measure.h"
+#include "lat_hist.h"
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+const char *i2cOpNames[I2C_OPS] = { "read", "write", "block_read" };
+const char *i2cRegNames[I2C_REGS] = {
+  "config", "shunt", "bus", "power", "current", "calib"
+};
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+static int hist_bucket(uint64_t v);
+static uint64_t hist_low(int idx);
+static void hist_inc(_Atomic uint64_t *cnt, uint64_t n);
+#ifdef SELF
+static int cmp_i64(const void *a, const void *b);
+#endif // SELF
+
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+#ifdef SELF
+int main(int argc, char *argv[])
+{
+  static hist_s h;
+  static const double qs[] = { 0.5, 0.9, 0.99, 0.999 };
+  int64_t *x;
+  size_t i;
+  int n = (argc > 1) ? atoi(argv[1]) : 100000;
+
+  x = malloc(n * sizeof(*x));
+  if (n < 1 || x == NULL)
+    usageErr("%s [samples]\n", argv[0]);
+
+  // Transaction-like latencies, about 200 us with rare 5 - 25 ms stalls
+  srand(1);
+  for (i = 0; i < (size_t)n; i++) {
+    x[i] = 150000 + rand() % 100000;
+    if (rand() % 200 == 0)
+      x[i] += 5000000 + rand() % 20000000;
+    hist_add(&h, x[i]);
+  }
+  qsort(x, n, sizeof(*x), cmp_i64);
+
+  printf("count %llu\n", (unsigned long long)hist_count(&h));
+  for (i = 0; i < sizeof(qs) / sizeof(qs[0]); i++)
+    printf("p%-5g %10lld exact %10lld\n", qs[i] * 100,
+	   (long long)hist_quantile(&h, qs[i]),
+	   (long long)x[(size_t)(qs[i] * (n - 1))]);
+  printf("max    %10lld exact %10lld\n",
+	 (long long)atomic_load(&h.maxNs), (long long)x[n - 1]);
+
+  free(x);
+  exit(EXIT_SUCCESS);
+}
+
+#endif // SELF
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+#ifdef SELF
+static int cmp_i64(const void *a, const void *b)
+{
+  int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+
+  return (x > y) - (x < y);
+}
+#endif // SELF
+
+
+/* @func  hist_bucket - bucket of value, values below HIST_SUB have
+ *                      own bucket, above it exponent selects group of
+ *                      HIST_SUB buckets and next bits step within it
+ */
+static int hist_bucket(uint64_t v)
+{
+  int e;
+
+  if (v < HIST_SUB)
+    return (int)v;
+
+  e = 63 - __builtin_clzll(v);
+  if (e >= HIST_MAX_BITS)
+    return HIST_BUCKETS - 1;
+
+  return (e - HIST_SUB_BITS + 1) * HIST_SUB
+    + (int)((v >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+
+/* @func  hist_low - lowest value falling into bucket */
+static uint64_t hist_low(int idx)
+{
+  int e;
+
+  if (idx < HIST_SUB)
+    return idx;
+
+  e = idx / HIST_SUB + HIST_SUB_BITS - 1;
+  return (uint64_t)(HIST_SUB + idx % HIST_SUB) << (e - HIST_SUB_BITS);
+}
+
+
+/* @func  hist_inc - count into counter of single writer */
+static void hist_inc(_Atomic uint64_t *cnt, uint64_t n)
+{
+  atomic_store_explicit(cnt, atomic_load_explicit(cnt, memory_order_relaxed)
+			+ n, memory_order_relaxed);
+}
+
+
+/****************************************************************/
+/**************** Global Functions Definitions ******************/
+/****************************************************************/
+
+/* @func  hist_add - record one duration, only owner of histogram may
+ *                   call it
+ * @param int64_t ns      - duration in ns, negative counts as zero
+ */
+void hist_add(hist_s *h, int64_t ns)
+{
+  if (ns < 0)
+    ns = 0;
+
+  hist_inc(&h->b[hist_bucket((uint64_t)ns)], 1);
+  hist_inc(&h->count, 1);
+  hist_inc(&h->sumNs, (uint64_t)ns);
+  if (ns > atomic_load_explicit(&h->maxNs, memory_order_relaxed))
+    atomic_store_explicit(&h->maxNs, ns, memory_order_relaxed);
+}
+
+
+/* @func  hist_count - number of recorded durations */
+uint64_t hist_count(const hist_s *h)
+{
+  return atomic_load_explicit(&h->count, memory_order_relaxed);
+}
+
+
+/* @func  hist_quantile - estimate of quantile, middle of bucket holding
+ *                        it, never above recorded maximum
+ * @param double q        - quantile, 0 - 1
+ * @return duration in ns, 0 when histogram is empty
+ */
+int64_t hist_quantile(const hist_s *h, double q)
+{
+  uint64_t b[HIST_BUCKETS], total = 0, rank, seen = 0;
+  int64_t v, maxNs;
+  int i;
+
+  // Buckets copied first, rank is taken from the copy itself
+  for (i = 0; i < HIST_BUCKETS; i++)
+    total += b[i] = atomic_load_explicit(&h->b[i], memory_order_relaxed);
+  if (total == 0)
+    return 0;
+
+  rank = (uint64_t)(q * total);
+  if (rank >= total)
+    rank = total - 1;
+  for (i = 0; i < HIST_BUCKETS - 1; i++) {
+    seen += b[i];
+    if (seen > rank)
+      break;
+  }
+
+  v = (int64_t)((hist_low(i) + hist_low(i + 1)) / 2);
+  maxNs = atomic_load_explicit(&h->maxNs, memory_order_relaxed);
+  return (v > maxNs) ? maxNs : v;
+}
+
+
+/* @func  hist_octaves - coarse view of histogram, one count per power
+ *                       of two, enough for report to fit on one line
+ * @param uint64_t oct[] - oct[e] counts durations of 2^e - 2^(e+1) ns,
+ *                         last one also those beyond it
+ */
+void hist_octaves(const hist_s *h, uint64_t oct[HIST_MAX_BITS])
+{
+  uint64_t low;
+  int i;
+
+  memset(oct, 0, HIST_MAX_BITS * sizeof(oct[0]));
+  for (i = 0; i < HIST_BUCKETS; i++) {
+    low = hist_low(i);
+    oct[(low == 0) ? 0 : 63 - __builtin_clzll(low)]
+      += atomic_load_explicit(&h->b[i], memory_order_relaxed);
+  }
+}
+
+
+/* @func  i2c_stats_record - record finished I2C transaction, errno
+ *                           is left as transaction set it
+ * @param int op             - I2C_OP_*
+ * @param unsigned char reg  - register, first one of block read
+ * @param int64_t startNs    - meas_now_ns() before transaction
+ * @param int ret            - result of transaction, -1 on failure
+ */
+void i2c_stats_record(i2c_stats_s *st, int op, unsigned char reg,
+		      int64_t startNs, int ret)
+{
+  int err = errno;
+
+  if (reg >= I2C_REGS)
+    reg = I2C_REGS - 1;
+  hist_add(&st->lat[op][reg], meas_now_ns() - startNs);
+
+  if (ret == -1) {
+    hist_inc(&st->fails[op][reg], 1);
+    hist_inc(&st->errnos[(err > 0 && err < I2C_ERRNO_MAX)
+			 ? err : I2C_ERRNO_MAX], 1);
+  }
+  errno = err;
+}
+
+
+/* @func  i2c_stats_retry - count repeated transaction, NULL st ignored */
+void i2c_stats_retry(i2c_stats_s *st)
+{
+  if (st != NULL)
+    hist_inc(&st->retries, 1);
+}
+
+
+/* @func  i2c_stats_reopen - count reopened bus, NULL st ignored */
+void i2c_stats_reopen(i2c_stats_s *st)
+{
+  if (st != NULL)
+    hist_inc(&st->reopens, 1);
+}
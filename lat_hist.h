@@ -0,0 +1,77 @@
+/*****************************************************************
+ * Title    : lat_hist.h
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Header file of latency histograms. Log-linear buckets,
+ *            every power of two split into HIST_SUB linear steps, so
+ *            relative error stays below 1/HIST_SUB over ns to seconds.
+ *            Recording is one bucket index and few relaxed stores by
+ *            single writer, cheap enough for every I2C transaction
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+#ifndef LAT_HIST_H
+#define LAT_HIST_H
+
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <stdint.h>
+#include <stdatomic.h>
+
+/****************************************************************/
+/******************* Symbolic Constant Definitions **************/
+/****************************************************************/
+#define HIST_SUB_BITS    3
+#define HIST_SUB         (1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS    32         // longer than 4.29 s lands in last bucket
+#define HIST_BUCKETS     ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB)
+
+// I2C operations, block read takes all measurement registers at once
+#define I2C_OP_READ      0
+#define I2C_OP_WRITE     1
+#define I2C_OP_BLOCK     2          // keyed by its first register
+#define I2C_OPS          3
+#define I2C_REGS         6          // configuration - calibration
+
+#define I2C_ERRNO_MAX    134        // higher errno counted in last slot
+
+/****************************************************************/
+/********************** New Types Definitions *******************/
+/****************************************************************/
+typedef struct {
+  _Atomic uint64_t count;
+  _Atomic uint64_t sumNs;
+  _Atomic int64_t maxNs;
+  _Atomic uint64_t b[HIST_BUCKETS];
+} hist_s;
+
+/* Transactions of one device, written only by its bus worker */
+typedef struct {
+  hist_s lat[I2C_OPS][I2C_REGS];    // successful and failed alike
+  _Atomic uint64_t fails[I2C_OPS][I2C_REGS];
+  _Atomic uint64_t errnos[I2C_ERRNO_MAX + 1];
+  _Atomic uint64_t retries;         // transactions repeated after failure
+  _Atomic uint64_t reopens;         // bus device reopened to recover
+} i2c_stats_s;
+
+/****************************************************************/
+/******************* Global Variable Declarations ***************/
+/****************************************************************/
+extern const char *i2cOpNames[I2C_OPS];
+extern const char *i2cRegNames[I2C_REGS];
+
+/****************************************************************/
+/******************* Global Functions Declarations **************/
+/****************************************************************/
+void hist_add(hist_s *h, int64_t ns);
+uint64_t hist_count(const hist_s *h);
+int64_t hist_quantile(const hist_s *h, double q);
+void hist_octaves(const hist_s *h, uint64_t oct[HIST_MAX_BITS]);
+
+void i2c_stats_record(i2c_stats_s *st, int op, unsigned char reg,
+		      int64_t startNs, int ret);
+void i2c_stats_retry(i2c_stats_s *st);
+void i2c_stats_reopen(i2c_stats_s *st);
+
+#endif // LAT_HIST_H
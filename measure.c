@@ -0,0 +1,178 @@
+/*****************************************************************
+ * Title    : measure.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Source file of measurement pipeline. One place where
+ *            raw INA219 register words turn into engineering values,
+ *            shared by sampler and log command
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+
+//#define SELF
+//#define DEBUG
+//#define PRINT
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <time.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/INA219.h"
+#include "measure.h"
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+
+// Shunt, bus, current and power registers in MEAS_* order
+const unsigned char measRegs[MEAS_REGS] = {
+  shunt_volt_reg, bus_volt_reg, curr_data_reg, power_data_reg
+};
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+#ifdef SELF
+int main(int argc, char *argv[])
+{
+  const char words[MEAS_REGS][2] = {
+    { 0x13, (char)0x88 }, { 0x5d, (char)0xc2 }, { 0x18, 0x6a }, { 0x0e, (char)0xa6 }
+  };
+  sample_s smp;
+
+  meas_convert(words, meas_now_ns(), &smp);
+  printf("shunt %.2f bus %.2f curr %.2f power %.2f flags 0x%x\n",
+	 smp.shuntVolt, smp.busVolt, smp.current, smp.power, smp.flags);
+
+  exit(EXIT_SUCCESS);
+}
+
+#endif // SELF
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+
+/****************************************************************/
+/**************** Global Functions Definitions ******************/
+/****************************************************************/
+
+/* @func  meas_decode - take register words of one read cycle apart
+ *                      without floating point, as sampler hot loop does
+ * @param const char (*words)[2] - shunt, bus, current and power register
+ *                                 words in MEAS_* order, MSB first
+ * @param int64_t tsNs           - CLOCK_MONOTONIC time of read
+ * @param sample_s *smp          - sample to fill, engineering values
+ *                                 are left to meas_eng()
+ */
+void meas_decode(const char (*words)[2], int64_t tsNs, sample_s *smp)
+{
+  int i;
+
+  for (i = 0; i < MEAS_REGS; i++)
+    smp->raw[i] = (uint16_t)(((unsigned char)words[i][0] << 8)
+			     | (unsigned char)words[i][1]);
+
+  smp->tsNs = tsNs;
+  smp->flags = 0;
+  if (!(smp->raw[MEAS_BUS] & CNVR))
+    smp->flags |= SMPL_F_STALE;
+  if (smp->raw[MEAS_BUS] & OVF)
+    smp->flags |= SMPL_F_OVF;
+}
+
+
+/* @func  meas_eng - convert raw register words of sample to engineering
+ *                   values, done by readers when they report
+ * @param sample_s *smp - sample filled by meas_decode()
+ */
+void meas_eng(sample_s *smp)
+{
+  measured_data_s m;
+
+  m.shuntRegVal = (short)smp->raw[MEAS_SHUNT];
+  m.busRegVal = (short)smp->raw[MEAS_BUS];
+  m.currRegVal = (short)smp->raw[MEAS_CURR];
+  m.powerRegVal = (short)smp->raw[MEAS_POWER];
+
+  // Shunt voltage. If negative voltage convert it to positive
+  if (sign(m.shuntRegVal) == -1) {
+    m.complVal = complement(m.shuntRegVal);
+    smp->shuntVolt = shuntVoltConv(m.complVal);
+  }
+  else
+    smp->shuntVolt = shuntVoltConv(m.shuntRegVal);
+
+  smp->busVolt = busVoltConv(m.busRegVal);
+  smp->current = currConv(m.currRegVal) / (1 << smplScale(smp->flags));
+  // Power register is unsigned, above 32767 LSB it is not negative
+  smp->power = pwrConv((unsigned short)m.powerRegVal)
+    / (1 << smplScale(smp->flags));
+}
+
+
+/* @func  meas_power_fine - power register word in LSB of finest range,
+ *                          so samples of different ranges add exactly
+ * @return power in pwrConv(1) / 2^MEAS_SCALE_MAX units
+ */
+uint32_t meas_power_fine(const sample_s *smp)
+{
+  return (uint32_t)smp->raw[MEAS_POWER]
+    << (MEAS_SCALE_MAX - smplScale(smp->flags));
+}
+
+
+/* @func  meas_convert - decode and convert register words of one read
+ *                       cycle, for readers reading device directly
+ * @param const char (*words)[2] - shunt, bus, current and power register
+ *                                 words in MEAS_* order, MSB first
+ * @param int64_t tsNs           - CLOCK_MONOTONIC time of read
+ * @param sample_s *smp          - sample to fill
+ */
+void meas_convert(const char (*words)[2], int64_t tsNs, sample_s *smp)
+{
+  meas_decode(words, tsNs, smp);
+  meas_eng(smp);
+}
+
+
+/* @func  meas_now_ns - CLOCK_MONOTONIC time in ns used to stamp samples
+ * @return monotonic time in ns
+ */
+int64_t meas_now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
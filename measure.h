@@ -0,0 +1,71 @@
+/*****************************************************************
+ * Title    : measure.h
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Header file of measurement pipeline. Converts raw
+ *            INA219 register words into timestamped sample
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+#ifndef MEASURE_H
+#define MEASURE_H
+
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <stdint.h>
+
+/****************************************************************/
+/******************* Symbolic Constant Definitions **************/
+/****************************************************************/
+// Indexes of measurement registers read in one combined transaction
+#define MEAS_SHUNT   0
+#define MEAS_BUS     1
+#define MEAS_CURR    2
+#define MEAS_POWER   3
+#define MEAS_REGS    4
+
+// Sample flags
+#define SMPL_F_STALE 0x0001     // CNVR not set, no new conversion since last read
+#define SMPL_F_OVF   0x0002     // OVF set, current or power out of range
+#define SMPL_F_GAP   0x0004     // first sample after outage, samples lost
+#define SMPL_F_RANGE 0x0008     // read while PGA range switched, not counted
+#define SMPL_F_CLEAR 0x0040     // first sample after clear, totals restart
+// Current and power of these are not valid, left out of energy and rollup
+#define SMPL_F_SKIP  (SMPL_F_RANGE | SMPL_F_OVF)
+
+// Current and power LSB of sample divided by 2^scale, auto-ranged gain
+#define SMPL_F_SCALE_SHIFT 4
+#define SMPL_F_SCALE_MASK  0x3
+#define MEAS_SCALE_MAX     3    // /1 range, calibration eight times /8
+#define smplScale(flags)   (((flags) >> SMPL_F_SCALE_SHIFT) & SMPL_F_SCALE_MASK)
+
+/****************************************************************/
+/********************** New Types Definitions *******************/
+/****************************************************************/
+typedef struct {
+  int64_t tsNs;                 // CLOCK_MONOTONIC time of read in ns
+  uint16_t raw[MEAS_REGS];      // register words in MEAS_* order
+  uint32_t flags;               // SMPL_F_* flags
+  // Filled by meas_eng(), sample ring carries raw words only
+  double shuntVolt;             // as converted by shuntVoltConv()
+  double busVolt;               // as converted by busVoltConv()
+  double current;               // currConv() scaled by SMPL_F_SCALE
+  double power;                 // pwrConv() scaled by SMPL_F_SCALE
+} sample_s;
+
+/****************************************************************/
+/******************* Global Variable Declarations ***************/
+/****************************************************************/
+extern const unsigned char measRegs[MEAS_REGS];
+
+/****************************************************************/
+/******************* Global Functions Declarations **************/
+/****************************************************************/
+void meas_decode(const char (*words)[2], int64_t tsNs, sample_s *smp);
+void meas_eng(sample_s *smp);
+uint32_t meas_power_fine(const sample_s *smp);
+void meas_convert(const char (*words)[2], int64_t tsNs, sample_s *smp);
+int64_t meas_now_ns(void);
+
+#endif // MEASURE_H
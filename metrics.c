@@ -0,0 +1,399 @@
+/*****************************************************************
+ * Title    : metrics.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Source file of Prometheus metrics. All devices are
+ *            copied out of shared memory first, then every metric
+ *            family is printed once with one line per device
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+
+//#define SELF
+//#define DEBUG
+//#define PRINT
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include "../header/tlpi_hdr.h"
+#include "measure.h"
+#include "energy.h"
+#include "metrics.h"
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+#define NS_TO_SEC(ns)    ((double)(ns) / 1e9)
+
+#define M_I2C_SECONDS    "ina219_i2c_transaction_seconds"
+#define M_JITTER         "ina219_sampler_jitter_seconds"
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+// Values of one device, taken once per scrape
+typedef struct {
+  int haveSample;                   // ring holds at least one sample
+  sample_s smp;
+  accu_data_s accu;
+  uint64_t i2cErrors;
+  uint64_t retries, reopens, outages;
+  uint64_t rangeSwitches, rangeMarked, ovfSamples;
+  uint64_t overruns;
+  int64_t readNs, readMaxNs;
+  int64_t lateNs, lateMaxNs;
+} metrics_snap_s;
+
+typedef enum {
+  M_BUS_VOLT = 0,
+  M_SHUNT_VOLT,
+  M_CURRENT,
+  M_POWER,
+  M_SAMPLE_AGE,
+  M_ENERGY,
+  M_SAMPLES,
+  M_MISSED,
+  M_I2C_ERRORS,
+  M_RETRIES,
+  M_REOPENS,
+  M_OUTAGES,
+  M_GAPS,
+  M_GAP_TIME,
+  M_RANGE_SWITCHES,
+  M_RANGE_MARKED,
+  M_OVF_SAMPLES,
+  M_OVERRUNS,
+  M_READ,
+  M_READ_MAX,
+  M_LATE,
+  M_LATE_MAX
+} metric_id_e;
+
+typedef struct {
+  const char *name;
+  const char *type;
+  const char *help;
+  metric_id_e id;
+} metric_def_s;
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+static const double summaryQs[] = { 0.5, 0.9, 0.99 };
+
+static const metric_def_s metricDefs[] = {
+  { "ina219_bus_voltage_volts", "gauge",
+    "Bus voltage of latest sample", M_BUS_VOLT },
+  { "ina219_shunt_voltage_volts", "gauge",
+    "Shunt voltage of latest sample", M_SHUNT_VOLT },
+  { "ina219_current_amperes", "gauge",
+    "Current of latest sample", M_CURRENT },
+  { "ina219_power_watts", "gauge",
+    "Power of latest sample", M_POWER },
+  { "ina219_sample_age_seconds", "gauge",
+    "Time since latest sample was read", M_SAMPLE_AGE },
+  { "ina219_energy_joules_total", "counter",
+    "Energy accumulated since start or clear", M_ENERGY },
+  { "ina219_samples_total", "counter",
+    "Samples accumulated since start or clear", M_SAMPLES },
+  { "ina219_missed_conversions_total", "counter",
+    "Conversions never read, CNVR pacing", M_MISSED },
+  { "ina219_i2c_errors_total", "counter",
+    "Failed register transactions", M_I2C_ERRORS },
+  { "ina219_i2c_retries_total", "counter",
+    "Transactions repeated after failure", M_RETRIES },
+  { "ina219_i2c_reopens_total", "counter",
+    "Bus device reopened to recover", M_REOPENS },
+  { "ina219_outages_total", "counter",
+    "Device taken offline after retries failed", M_OUTAGES },
+  { "ina219_gaps_total", "counter",
+    "Outages since start or clear, energy not integrated over", M_GAPS },
+  { "ina219_gap_seconds_total", "counter",
+    "Time of outages since start or clear", M_GAP_TIME },
+  { "ina219_range_switches_total", "counter",
+    "PGA gain switched by auto-ranging", M_RANGE_SWITCHES },
+  { "ina219_range_marked_samples_total", "counter",
+    "Samples read during range switch, left out of statistics",
+    M_RANGE_MARKED },
+  { "ina219_overflow_samples_total", "counter",
+    "Samples with OVF set, left out of statistics and energy",
+    M_OVF_SAMPLES },
+  { "ina219_sampler_overruns_total", "counter",
+    "Sample ticks skipped because bus worker ran late", M_OVERRUNS },
+  { "ina219_sample_read_seconds", "gauge",
+    "Duration of last sample read", M_READ },
+  { "ina219_sample_read_max_seconds", "gauge",
+    "Longest sample read", M_READ_MAX },
+  { "ina219_sampler_late_seconds", "gauge",
+    "Wakeup of bus worker past deadline, last tick", M_LATE },
+  { "ina219_sampler_late_max_seconds", "gauge",
+    "Longest wakeup past deadline", M_LATE_MAX }
+};
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+static void metrics_snap(const cmd_ctx_s *ctx, int d, metrics_snap_s *ms);
+static int metrics_value(const metrics_snap_s *ms, metric_id_e id,
+			 int64_t nowNs, double *v);
+static void metrics_label(FILE *out, const char *s);
+static void metrics_dev(FILE *out, const cmd_ctx_s *ctx, int d);
+static void metrics_summary(FILE *out, const cmd_ctx_s *ctx, int d,
+			    const char *name, const char *extra,
+			    const hist_s *h);
+
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+/* @func  metrics_snap - copy shared state of device */
+static void metrics_snap(const cmd_ctx_s *ctx, int d, metrics_snap_s *ms)
+{
+  dev_share_s *ds = &ctx->share->dev[d];
+
+  ms->haveSample = (ring_latest(&ds->ring, &ms->smp) == 0);
+  if (ms->haveSample)
+    meas_eng(&ms->smp);
+  accu_read(&ds->accu, &ms->accu);
+
+  ms->i2cErrors = atomic_load_explicit(&ds->stats.i2cErrors, memory_order_relaxed);
+  ms->retries = atomic_load_explicit(&ds->i2c.retries, memory_order_relaxed);
+  ms->reopens = atomic_load_explicit(&ds->i2c.reopens, memory_order_relaxed);
+  ms->outages = atomic_load_explicit(&ds->stats.outages, memory_order_relaxed);
+  ms->rangeSwitches = atomic_load_explicit(&ds->stats.rangeSwitches,
+					   memory_order_relaxed);
+  ms->rangeMarked = atomic_load_explicit(&ds->stats.rangeMarked,
+					 memory_order_relaxed);
+  ms->ovfSamples = atomic_load_explicit(&ds->stats.ovfSamples,
+					memory_order_relaxed);
+  ms->overruns = atomic_load_explicit(&ds->stats.overruns, memory_order_relaxed);
+  ms->readNs = atomic_load_explicit(&ds->stats.readNs, memory_order_relaxed);
+  ms->readMaxNs = atomic_load_explicit(&ds->stats.readMaxNs, memory_order_relaxed);
+  ms->lateNs = atomic_load_explicit(&ds->stats.lateNs, memory_order_relaxed);
+  ms->lateMaxNs = atomic_load_explicit(&ds->stats.lateMaxNs, memory_order_relaxed);
+}
+
+
+/* @func  metrics_value - value of metric in base units
+ * @return SUCCESS     - 0
+ *         ERROR       - -1, no sample yet, metric is left out
+ */
+static int metrics_value(const metrics_snap_s *ms, metric_id_e id,
+			 int64_t nowNs, double *v)
+{
+  switch (id) {
+  case M_BUS_VOLT:
+  case M_SHUNT_VOLT:
+  case M_CURRENT:
+  case M_POWER:
+  case M_SAMPLE_AGE:
+    if (!ms->haveSample)
+      return -1;
+    *v = (id == M_BUS_VOLT) ? ms->smp.busVolt
+      : (id == M_SHUNT_VOLT) ? ms->smp.shuntVolt / 1000
+      : (id == M_CURRENT) ? ms->smp.current
+      : (id == M_POWER) ? ms->smp.power
+      : NS_TO_SEC(nowNs - ms->smp.tsNs);
+    return 0;
+  case M_ENERGY:
+    *v = energy_q_joules(&ms->accu.energy);
+    return 0;
+  case M_SAMPLES:
+    *v = (double)ms->accu.samples;
+    return 0;
+  case M_MISSED:
+    *v = (double)ms->accu.missed;
+    return 0;
+  case M_I2C_ERRORS:
+    *v = (double)ms->i2cErrors;
+    return 0;
+  case M_RETRIES:
+    *v = (double)ms->retries;
+    return 0;
+  case M_REOPENS:
+    *v = (double)ms->reopens;
+    return 0;
+  case M_OUTAGES:
+    *v = (double)ms->outages;
+    return 0;
+  case M_GAPS:
+    *v = (double)ms->accu.gaps;
+    return 0;
+  case M_GAP_TIME:
+    *v = NS_TO_SEC(ms->accu.gapNs);
+    return 0;
+  case M_RANGE_SWITCHES:
+    *v = (double)ms->rangeSwitches;
+    return 0;
+  case M_RANGE_MARKED:
+    *v = (double)ms->rangeMarked;
+    return 0;
+  case M_OVF_SAMPLES:
+    *v = (double)ms->ovfSamples;
+    return 0;
+  case M_OVERRUNS:
+    *v = (double)ms->overruns;
+    return 0;
+  case M_READ:
+    *v = NS_TO_SEC(ms->readNs);
+    return 0;
+  case M_READ_MAX:
+    *v = NS_TO_SEC(ms->readMaxNs);
+    return 0;
+  case M_LATE:
+    *v = NS_TO_SEC(ms->lateNs);
+    return 0;
+  case M_LATE_MAX:
+    *v = NS_TO_SEC(ms->lateMaxNs);
+    return 0;
+  }
+
+  return -1;
+}
+
+
+/* @func  metrics_label - print label value, backslash, quote and
+ *                        newline escaped as exposition format requires
+ */
+static void metrics_label(FILE *out, const char *s)
+{
+  for (; *s != '\0'; s++) {
+    if (*s == '\\' || *s == '"')
+      fputc('\\', out);
+    if (*s == '\n')
+      fputs("\\n", out);
+    else
+      fputc(*s, out);
+  }
+}
+
+
+/* @func  metrics_dev - print labels identifying device */
+static void metrics_dev(FILE *out, const cmd_ctx_s *ctx, int d)
+{
+  fprintf(out, "device=\"%d\",bus=\"", d);
+  metrics_label(out, ctx->devs[d].bus);
+  fprintf(out, "\",addr=\"0x%02x\"", ctx->devs[d].addr);
+}
+
+
+/* @func  metrics_summary - print histogram as summary of quantiles
+ * @param const char *extra - labels after device ones, "" for none
+ */
+static void metrics_summary(FILE *out, const cmd_ctx_s *ctx, int d,
+			    const char *name, const char *extra,
+			    const hist_s *h)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof(summaryQs) / sizeof(summaryQs[0]); i++) {
+    fprintf(out, "%s{", name);
+    metrics_dev(out, ctx, d);
+    fprintf(out, "%s,quantile=\"%g\"} %.9g\n", extra, summaryQs[i],
+	    NS_TO_SEC(hist_quantile(h, summaryQs[i])));
+  }
+  fprintf(out, "%s_sum{", name);
+  metrics_dev(out, ctx, d);
+  fprintf(out, "%s} %.9g\n%s_count{", extra,
+	  NS_TO_SEC(atomic_load_explicit(&h->sumNs, memory_order_relaxed)),
+	  name);
+  metrics_dev(out, ctx, d);
+  fprintf(out, "%s} %llu\n", extra, (unsigned long long)hist_count(h));
+}
+
+
+/****************************************************************/
+/**************** Global Functions Definitions ******************/
+/****************************************************************/
+
+/* @func  metrics_write - print all metrics in Prometheus text format
+ * @param FILE *out           - output stream
+ * @param const cmd_ctx_s *ctx - devices and shared memory
+ */
+void metrics_write(FILE *out, const cmd_ctx_s *ctx)
+{
+  metrics_snap_s snap[INA_MAX_DEVS];
+  const metric_def_s *m;
+  const hist_s *h;
+  char extra[64];
+  int64_t nowNs;
+  uint64_t n;
+  double v;
+  size_t i;
+  int d, op, reg, e;
+
+  for (d = 0; d < ctx->ndev; d++)
+    metrics_snap(ctx, d, &snap[d]);
+  nowNs = meas_now_ns();
+
+  fprintf(out, "# HELP ina219_sample_rate_hz Sample rate, 0 when paced by conversion-ready bit\n"
+	  "# TYPE ina219_sample_rate_hz gauge\n"
+	  "ina219_sample_rate_hz %ld\n", ctx->rate);
+
+  for (i = 0; i < sizeof(metricDefs) / sizeof(metricDefs[0]); i++) {
+    m = &metricDefs[i];
+    fprintf(out, "# HELP %s %s\n# TYPE %s %s\n",
+	    m->name, m->help, m->name, m->type);
+
+    for (d = 0; d < ctx->ndev; d++) {
+      if (metrics_value(&snap[d], m->id, nowNs, &v) == -1)
+	continue;
+      fprintf(out, "%s{", m->name);
+      metrics_dev(out, ctx, d);
+      fprintf(out, "} %.9g\n", v);
+    }
+  }
+
+  // Histograms are read in place, too big to snapshot
+  fprintf(out, "# HELP " M_JITTER " Wakeup of bus worker past deadline\n"
+	  "# TYPE " M_JITTER " summary\n");
+  for (d = 0; d < ctx->ndev; d++)
+    metrics_summary(out, ctx, d, M_JITTER, "",
+		    &ctx->share->dev[d].stats.lateHist);
+
+  fprintf(out, "# HELP " M_I2C_SECONDS " Duration of I2C transaction by operation and register\n"
+	  "# TYPE " M_I2C_SECONDS " summary\n");
+  for (d = 0; d < ctx->ndev; d++)
+    for (op = 0; op < I2C_OPS; op++)
+      for (reg = 0; reg < I2C_REGS; reg++) {
+	h = &ctx->share->dev[d].i2c.lat[op][reg];
+	if (hist_count(h) == 0)
+	  continue;
+	snprintf(extra, sizeof(extra), ",op=\"%s\",reg=\"%s\"",
+		 i2cOpNames[op], i2cRegNames[reg]);
+	metrics_summary(out, ctx, d, M_I2C_SECONDS, extra, h);
+      }
+
+  fprintf(out, "# HELP ina219_i2c_errno_total Failed I2C transactions by errno, 0 for unknown or too high\n"
+	  "# TYPE ina219_i2c_errno_total counter\n");
+  for (d = 0; d < ctx->ndev; d++)
+    for (e = 0; e <= I2C_ERRNO_MAX; e++) {
+      n = atomic_load_explicit(&ctx->share->dev[d].i2c.errnos[e],
+			       memory_order_relaxed);
+      if (n == 0)
+	continue;
+      fprintf(out, "ina219_i2c_errno_total{");
+      metrics_dev(out, ctx, d);
+      fprintf(out, ",errno=\"%d\"} %llu\n", (e < I2C_ERRNO_MAX) ? e : 0,
+	      (unsigned long long)n);
+    }
+}
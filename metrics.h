@@ -0,0 +1,32 @@
+/*****************************************************************
+ * Title    : metrics.h
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Header file of Prometheus metrics. Renders text
+ *            exposition format from snapshot of shared memory only,
+ *            latest ring sample, accumulator and sampler stats, so
+ *            scrape never touches I2C bus
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+#ifndef METRICS_H
+#define METRICS_H
+
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <stdio.h>
+#include "command.h"
+
+/****************************************************************/
+/******************* Symbolic Constant Definitions **************/
+/****************************************************************/
+#define METRICS_PATH     "/metrics"
+#define METRICS_TYPE     "text/plain; version=0.0.4"
+
+/****************************************************************/
+/******************* Global Functions Declarations **************/
+/****************************************************************/
+void metrics_write(FILE *out, const cmd_ctx_s *ctx);
+
+#endif // METRICS_H
@@ -0,0 +1,527 @@
+/*****************************************************************
+ * Title    : reduce.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Parallel reducer of large captures. Mapped capture is cut
+ *            into chunks, pool of threads takes them one by one and
+ *            reduces each to energy, min/max/mean of channels and time
+ *            above power threshold per device. Chunk keeps its first
+ *            and last sample, so merge in file order adds trapezoid of
+ *            seam between chunks: total is the same integer sum as one
+ *            pass gives, whatever the chunking or thread count. Energy
+ *            and time follow sampler_account(): gaps, clears and
+ *            sessions are not bridged, SMPL_F_RANGE and SMPL_F_OVF
+ *            samples are left out. Totals span whole capture, clears
+ *            are only counted
+ * Version  : 1.00
+ * Options  : [-j threads] [-c records] [-w watts] <capture>,
+ *            capture is -l or -z log file, threads default to online
+ *            CPUs, -c sets records per chunk, -w threshold of time
+ *            above (default 0 W)
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+
+#define SELF
+//#define DEBUG
+//#define PRINT
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <fcntl.h>
+#include <getopt.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/get_num.h"
+#include "../header/INA219.h"
+#include "measure.h"
+#include "energy.h"
+#include "rollup.h"
+#include "ina_dev.h"
+#include "sample_log.h"
+#include "clog.h"
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+#define RED_CHUNK_DEF    (1 << 20)  // records per chunk, 24 MB of -l log
+#define RED_THREADS_MAX  256
+#define RED_MEAN_TOL     0.05       // mean power x time against energy
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+// Channel in raw counts as rollup_values() gives them, exact sums
+typedef struct {
+  uint64_t n;
+  int32_t min, max;
+  int64_t sum;
+} red_ch_s;
+
+/* Reduction of one device over chunk or whole capture. Trapezoids
+ * inside chunk are in e, seam to neighbour needs first and last
+ * accounted sample and whether break (gap, session) separates them */
+typedef struct {
+  int any;                          // accounted sample seen
+  int brk;                          // break since last sample
+  int headBreak;                    // break before first sample
+  int64_t firstTsNs, lastTsNs;
+  uint32_t firstPower, lastPower;   // meas_power_fine()
+  energy_q_s e;
+  int64_t timeNs;                   // time integrated over
+  int64_t aboveNs;                  // of it, power above threshold
+  uint64_t samples, range, ovf, gaps, clears;
+  red_ch_s ch[ROLLUP_CH];
+} red_dev_s;
+
+typedef struct {
+  red_dev_s dev[INA_MAX_DEVS];
+  uint64_t records, bad, sessions;
+} red_chunk_s;
+
+typedef struct {
+  const log_rec_s *recs;            // -l log, NULL for -z
+  size_t nrec;
+  const clog_map_s *cm;             // -z log
+  const uint64_t *offs;             // block offsets of -z log
+  size_t nblk;
+  size_t chunkLen;                  // records or blocks per chunk
+  size_t nchunk;
+  double thr;                       // threshold, LSB of finest power
+  red_chunk_s *res;                 // result of every chunk
+  _Atomic size_t next;              // next chunk to take
+} red_job_s;
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+static void red_interval(red_dev_s *r, double thr, int64_t t0, uint32_t p0,
+			 int64_t t1, uint32_t p1);
+static void red_rec(red_chunk_s *c, double thr, const log_rec_s *rec);
+static void red_chunk(red_job_s *job, size_t n);
+static void *red_worker(void *arg);
+static void red_merge(red_dev_s *tot, int *primed, const red_dev_s *r,
+		      double thr);
+static size_t red_blocks(const clog_map_s *m, uint64_t **offs);
+static void red_report(int d, const red_dev_s *r, double watts);
+
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+#ifdef SELF
+int main(int argc, char *argv[])
+{
+  static red_job_s job;
+  static red_dev_s tot[INA_MAX_DEVS];
+  int primed[INA_MAX_DEVS] = { 0 };
+  pthread_t tid[RED_THREADS_MAX];
+  char magic[LOG_MAGIC_LEN];
+  log_map_s lm;
+  clog_map_s cm;
+  uint64_t *offs = NULL, records = 0, bad = 0, sessions = 0;
+  size_t chunk = RED_CHUNK_DEF, c;
+  double watts = 0, secs;
+  int64_t startNs;
+  long nthr = sysconf(_SC_NPROCESSORS_ONLN);
+  int fd, opt, d, i, err, isClog;
+
+  while ((opt = getopt(argc, argv, "j:c:w:")) != -1) {
+    switch (opt) {
+    case 'j':
+      nthr = getLong(optarg, GN_GT_0, "threads");
+      break;
+    case 'c':
+      chunk = getLong(optarg, GN_GT_0, "records per chunk");
+      break;
+    case 'w':
+      watts = atof(optarg);
+      break;
+    default:
+      usageErr("%s [-j threads] [-c records] [-w watts] <capture>\n", argv[0]);
+    }
+  }
+  if (optind >= argc)
+    usageErr("%s [-j threads] [-c records] [-w watts] <capture>\n", argv[0]);
+  if (nthr < 1)
+    nthr = 1;
+  if (nthr > RED_THREADS_MAX)
+    nthr = RED_THREADS_MAX;
+
+  fd = open(argv[optind], O_RDONLY);
+  if (fd == -1 || read(fd, magic, sizeof(magic)) != sizeof(magic))
+    errExit("read %s", argv[optind]);
+  close(fd);
+  isClog = (memcmp(magic, CLOG_MAGIC, LOG_MAGIC_LEN) == 0);
+
+  startNs = meas_now_ns();
+  if (isClog) {
+    if (clog_map(argv[optind], &cm) == -1)
+      errExit("clog_map %s", argv[optind]);
+    job.cm = &cm;
+    job.nblk = red_blocks(&cm, &offs);
+    job.offs = offs;
+    job.chunkLen = (chunk + CLOG_BLOCK_SAMPLES - 1) / CLOG_BLOCK_SAMPLES;
+    job.nchunk = (job.nblk + job.chunkLen - 1) / job.chunkLen;
+  }
+  else {
+    if (log_map(argv[optind], &lm) == -1)
+      errExit("log_map %s", argv[optind]);
+    // Chunks are taken in any order, read-ahead of whole file is wrong
+    madvise(lm.base, lm.size, MADV_NORMAL);
+    job.recs = lm.recs;
+    job.nrec = lm.nrec;
+    job.chunkLen = chunk;
+    job.nchunk = (job.nrec + job.chunkLen - 1) / job.chunkLen;
+  }
+  job.thr = watts / (pwrConv(1) / (1 << MEAS_SCALE_MAX));
+  job.res = calloc(job.nchunk ? job.nchunk : 1, sizeof(red_chunk_s));
+  if (job.res == NULL)
+    errExit("calloc");
+  atomic_init(&job.next, 0);
+
+  if ((size_t)nthr > job.nchunk)
+    nthr = job.nchunk ? job.nchunk : 1;
+  for (i = 0; i < nthr; i++)
+    if ((err = pthread_create(&tid[i], NULL, red_worker, &job)) != 0)
+      errExitEN(err, "pthread_create");
+  for (i = 0; i < nthr; i++)
+    pthread_join(tid[i], NULL);
+
+  // Chunks merge in file order, seams need order
+  for (c = 0; c < job.nchunk; c++) {
+    records += job.res[c].records;
+    bad += job.res[c].bad;
+    sessions += job.res[c].sessions;
+    for (d = 0; d < INA_MAX_DEVS; d++)
+      red_merge(&tot[d], &primed[d], &job.res[c].dev[d], job.thr);
+  }
+  secs = (meas_now_ns() - startNs) / 1e9;
+
+  printf("{ \"reduce\":{ \"file\":\"%s\", \"threads\":%ld, \"chunks\":%zu, \"records\":%llu, \"bad\":%llu, \"sessions\":%llu, \"elapsed_s\":%.3f, \"records_per_s\":%.0f } }\n",
+	 argv[optind], nthr, job.nchunk, (unsigned long long)records,
+	 (unsigned long long)bad, (unsigned long long)sessions, secs,
+	 (secs > 0) ? records / secs : 0.0);
+  for (d = 0; d < INA_MAX_DEVS; d++)
+    if (tot[d].samples > 0)
+      red_report(d, &tot[d], watts);
+
+  free(job.res);
+  free(offs);
+  if (isClog)
+    clog_unmap(&cm);
+  else
+    log_unmap(&lm);
+  exit(EXIT_SUCCESS);
+}
+
+#endif // SELF
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+/* @func  red_interval - account interval between two samples: its
+ *                       time and time power is above threshold, power
+ *                       linear in between as trapezoid of energy takes
+ * @param double thr     - threshold, LSB of finest power
+ */
+static void red_interval(red_dev_s *r, double thr, int64_t t0, uint32_t p0,
+			 int64_t t1, uint32_t p1)
+{
+  uint32_t hi = (p0 > p1) ? p0 : p1, lo = (p0 > p1) ? p1 : p0;
+  int64_t dt = t1 - t0;
+
+  if (dt <= 0)
+    return;
+
+  r->timeNs += dt;
+  if (lo > thr)
+    r->aboveNs += dt;
+  else if (hi > thr)
+    r->aboveNs += (int64_t)(dt * ((hi - thr) / (hi - lo)));
+}
+
+
+/* @func  red_rec - reduce one record into chunk, as sampler_account()
+ *                  folds sample. Session record breaks every device
+ */
+static void red_rec(red_chunk_s *c, double thr, const log_rec_s *rec)
+{
+  red_dev_s *r;
+  sample_s smp;
+  int32_t v[ROLLUP_CH];
+  uint32_t p;
+  int d, ch;
+
+  c->records++;
+  if (!log_rec_valid(rec)) {
+    c->bad++;
+    return;
+  }
+  if (rec->dev == LOG_DEV_SESSION) {
+    c->sessions++;
+    for (d = 0; d < INA_MAX_DEVS; d++) {
+      c->dev[d].brk = 1;
+      energy_q_gap(&c->dev[d].e);
+    }
+    return;
+  }
+  if (rec->dev >= INA_MAX_DEVS) {
+    c->bad++;
+    return;
+  }
+
+  r = &c->dev[rec->dev];
+  r->samples++;
+  if (rec->flags & SMPL_F_GAP)
+    r->gaps++;
+  if (rec->flags & SMPL_F_CLEAR)
+    r->clears++;
+  if (rec->flags & (SMPL_F_GAP | SMPL_F_CLEAR)) {
+    r->brk = 1;
+    energy_q_gap(&r->e);
+  }
+  if (rec->flags & SMPL_F_SKIP) {
+    if (rec->flags & SMPL_F_RANGE)
+      r->range++;
+    else
+      r->ovf++;
+    return;
+  }
+
+  smp.tsNs = rec->tsNs;
+  memcpy(smp.raw, rec->raw, sizeof(smp.raw));
+  smp.flags = rec->flags;
+  p = meas_power_fine(&smp);
+
+  if (!r->any) {
+    r->any = 1;
+    r->headBreak = r->brk;
+    r->firstTsNs = smp.tsNs;
+    r->firstPower = p;
+  }
+  else if (r->e.primed)
+    red_interval(r, thr, r->e.prevTsNs, r->e.prevPower, smp.tsNs, p);
+  energy_q_add(&r->e, smp.tsNs, p);
+  r->brk = 0;
+  r->lastTsNs = smp.tsNs;
+  r->lastPower = p;
+
+  rollup_values(&smp, v);
+  for (ch = 0; ch < ROLLUP_CH; ch++) {
+    if (r->ch[ch].n == 0 || v[ch] < r->ch[ch].min)
+      r->ch[ch].min = v[ch];
+    if (r->ch[ch].n == 0 || v[ch] > r->ch[ch].max)
+      r->ch[ch].max = v[ch];
+    r->ch[ch].sum += v[ch];
+    r->ch[ch].n++;
+  }
+}
+
+
+/* @func  red_chunk - reduce chunk n of capture into job->res[n]. Block
+ *                    of -z log failing checksum is counted bad */
+static void red_chunk(red_job_s *job, size_t n)
+{
+  log_rec_s recs[CLOG_BLOCK_SAMPLES];
+  red_chunk_s *c = &job->res[n];
+  const clog_blk_s *blk;
+  size_t i, end;
+  int k, cnt;
+
+  if (job->recs != NULL) {
+    end = (n + 1) * job->chunkLen;
+    if (end > job->nrec)
+      end = job->nrec;
+    for (i = n * job->chunkLen; i < end; i++)
+      red_rec(c, job->thr, &job->recs[i]);
+    return;
+  }
+
+  end = (n + 1) * job->chunkLen;
+  if (end > job->nblk)
+    end = job->nblk;
+  for (i = n * job->chunkLen; i < end; i++) {
+    blk = clog_block(job->cm, job->offs[i]);
+    cnt = (blk == NULL) ? -1
+      : clog_decode(blk, (const uint8_t *)(blk + 1), job->cm->hdr->tsQuantNs,
+		    recs);
+    if (cnt == -1) {
+      c->bad++;
+      continue;
+    }
+    for (k = 0; k < cnt; k++)
+      red_rec(c, job->thr, &recs[k]);
+  }
+}
+
+
+/* @func  red_worker - thread of pool, takes chunks until none is left */
+static void *red_worker(void *arg)
+{
+  red_job_s *job = arg;
+  size_t n;
+
+  while ((n = atomic_fetch_add(&job->next, 1)) < job->nchunk)
+    red_chunk(job, n);
+
+  return NULL;
+}
+
+
+/* @func  red_merge - append reduction of next chunk to total of device,
+ *                    seam between last sample before and first one of
+ *                    chunk is trapezoid as energy_q_add() makes it
+ * @param int *primed    - total ends with sample seam can start from
+ */
+static void red_merge(red_dev_s *tot, int *primed, const red_dev_s *r,
+		      double thr)
+{
+  int ch;
+
+  tot->samples += r->samples;
+  tot->range += r->range;
+  tot->ovf += r->ovf;
+  tot->clears += r->clears;
+  tot->gaps += r->gaps;
+  if (!r->any) {
+    if (r->brk)
+      *primed = 0;
+    return;
+  }
+
+  if (*primed && !r->headBreak) {
+    if (r->firstTsNs > tot->lastTsNs)
+      u128_add_mul(&tot->e.sum, (uint64_t)tot->lastPower + r->firstPower,
+		   (uint64_t)(r->firstTsNs - tot->lastTsNs));
+    red_interval(tot, thr, tot->lastTsNs, tot->lastPower,
+		 r->firstTsNs, r->firstPower);
+  }
+  u128_add(&tot->e.sum, &r->e.sum);
+  tot->timeNs += r->timeNs;
+  tot->aboveNs += r->aboveNs;
+
+  if (!tot->any) {
+    tot->any = 1;
+    tot->firstTsNs = r->firstTsNs;
+    tot->firstPower = r->firstPower;
+  }
+  tot->lastTsNs = r->lastTsNs;
+  tot->lastPower = r->lastPower;
+  *primed = !r->brk;
+
+  for (ch = 0; ch < ROLLUP_CH; ch++) {
+    if (r->ch[ch].n == 0)
+      continue;
+    if (tot->ch[ch].n == 0 || r->ch[ch].min < tot->ch[ch].min)
+      tot->ch[ch].min = r->ch[ch].min;
+    if (tot->ch[ch].n == 0 || r->ch[ch].max > tot->ch[ch].max)
+      tot->ch[ch].max = r->ch[ch].max;
+    tot->ch[ch].sum += r->ch[ch].sum;
+    tot->ch[ch].n += r->ch[ch].n;
+  }
+}
+
+
+/* @func  red_blocks - offsets of all blocks of -z log: indexed ones
+ *                     from index, blocks written after it by scan.
+ *                     Indexed blocks are verified by workers, only
+ *                     scanned ones are here
+ * @param uint64_t **offs - allocated array, caller frees it
+ * @return number of blocks
+ */
+static size_t red_blocks(const clog_map_s *m, uint64_t **offs)
+{
+  const clog_blk_s *blk;
+  const clog_idx_s *e;
+  uint64_t off = sizeof(clog_hdr_s);
+  size_t n = 0, cap = 0, i;
+
+  *offs = NULL;
+  for (i = 0; ; i++) {
+    // Entry is trusted while valid and ahead of previous block
+    if (i < m->nidx) {
+      e = &m->idx[i];
+      blk = (const clog_blk_s *)((const char *)m->base + e->off);
+      if (e->crc != log_crc32(0, e, offsetof(clog_idx_s, crc))
+	  || e->off < off || e->off % CLOG_ALIGN != 0
+	  || e->off + sizeof(clog_blk_s) > m->size
+	  || blk->magic != CLOG_BLK_MAGIC)
+	i = m->nidx;
+      else
+	off = e->off;
+    }
+    if (i >= m->nidx && clog_block(m, off) == NULL)
+      break;
+
+    if (n == cap) {
+      cap = cap ? 2 * cap : 4096;
+      *offs = realloc(*offs, cap * sizeof(**offs));
+      if (*offs == NULL)
+	errExit("realloc");
+    }
+    (*offs)[n++] = off;
+    off = clog_next(m, off);
+  }
+
+  return n;
+}
+
+
+/* @func  red_report - totals of device in engineering units */
+static void red_report(int d, const red_dev_s *r, double watts)
+{
+  double s, joules = energy_q_joules(&r->e.sum);
+  int ch;
+
+  printf("{ \"device\":%d, \"samples\":%llu, \"range_marked\":%llu, \"overflows\":%llu, \"gaps\":%llu, \"clears\":%llu, \"energy_Wh\":%.6f, \"energy_J\":%.3f, \"energy_q\":\"0x%016llx%016llx\", \"time_s\":%.3f, \"above_W\":%.4f, \"above_s\":%.3f",
+	 d, (unsigned long long)r->samples, (unsigned long long)r->range,
+	 (unsigned long long)r->ovf,
+	 (unsigned long long)r->gaps, (unsigned long long)r->clears,
+	 joules / J_PER_WH, joules,
+	 (unsigned long long)r->e.sum.hi, (unsigned long long)r->e.sum.lo,
+	 r->timeNs / 1e9, watts, r->aboveNs / 1e9);
+  for (ch = 0; ch < ROLLUP_CH; ch++) {
+    s = rollup_scale(ch);
+    if (r->ch[ch].n == 0)
+      continue;
+    printf(", \"%s\":{ \"min\":%.4f, \"max\":%.4f, \"mean\":%.4f }",
+	   rollupChNames[ch], r->ch[ch].min * s, r->ch[ch].max * s,
+	   (double)r->ch[ch].sum / r->ch[ch].n * s);
+  }
+  printf(" }\n");
+
+  /* Mean is over samples, energy over time, so they part only with
+   * uneven sampling or load following its rhythm. Far apart they
+   * mean power taken with wrong sign or scale */
+  if (r->ch[ROLLUP_POWER].n == 0 || r->timeNs <= 0)
+    return;
+  s = (double)r->ch[ROLLUP_POWER].sum / r->ch[ROLLUP_POWER].n
+    * rollup_scale(ROLLUP_POWER) * (r->timeNs / 1e9);
+  if (fabs(s - joules) > RED_MEAN_TOL * fmax(fabs(s), fabs(joules))
+      + rollup_scale(ROLLUP_POWER) * (r->timeNs / 1e9))
+    fprintf(stderr, "{ \"WARN\":\"mean power x time differs from energy\", \"device\":%d, \"mean_J\":%.3f, \"energy_J\":%.3f }\n",
+	    d, s, joules);
+}
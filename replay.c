@@ -0,0 +1,339 @@
+/*****************************************************************
+ * Title    : replay.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Offline replay of recorded captures. Logged samples carry
+ *            raw register words and flags as published by sampler, so
+ *            they go through sampler_account() into rollup, energy and
+ *            accumulator exactly like live ones, and reports come from
+ *            same commands. Clear is carried by SMPL_F_CLEAR of sample
+ *            following it and zeroes totals here as well. Raw log (-l)
+ *            keeps ns timestamps, its replay gives energy of live run
+ *            bit for bit unless records were missing; compressed log
+ *            (-z) differs by its timestamp quantum only. Every session
+ *            of capture is reported on its own, as run of application
+ *            started from zero
+ * Version  : 1.00
+ * Options  : [-s speed] [-t mode] <capture>,
+ *            capture is -l or -z log file, speed 0 runs as fast as CPU
+ *            allows (default), 1 in real time, N N times faster,
+ *            -t selects timestamps local|iso|epoch
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+
+#define SELF
+//#define DEBUG
+//#define PRINT
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <time.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/get_num.h"
+#include "measure.h"
+#include "shm_ring.h"
+#include "energy.h"
+#include "sampler.h"
+#include "sample_log.h"
+#include "clog.h"
+#include "command.h"
+#include "ts_fmt.h"
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+typedef struct {
+  shm_share_s *share;               // same layout as live, never shared
+  energy_q_s integ[INA_MAX_DEVS];
+  uint16_t nextSeq[INA_MAX_DEVS];   // expected seq, reveals lost records
+  int seen[INA_MAX_DEVS];
+  int ndev;                         // devices seen in session
+  int session;                      // sessions started
+  uint64_t records, bad, missing;   // of session
+  uint64_t clears;                  // of session, totals zeroed by them
+  int64_t startNs;                  // CLOCK_MONOTONIC, replay of session
+  double speed;                     // 0 as fast as possible
+  int paced;                        // origin of pacing taken
+  int64_t originTsNs;               // first sample of session
+  int64_t originNs;                 // CLOCK_MONOTONIC of originTsNs
+  cmd_ctx_s ctx;
+  cmd_pend_s pend;                  // never parked, 'accu' and 'stats' only
+  stream_s stream;                  // never started, cmd_exec() wants it
+} replay_s;
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+static void replay_report(replay_s *rp);
+static void replay_session(replay_s *rp, const log_rec_s *rec);
+static void replay_pace(replay_s *rp, int64_t tsNs);
+static void replay_rec(replay_s *rp, const log_rec_s *rec);
+static int replay_raw(replay_s *rp, const char *path);
+static int replay_clog(replay_s *rp, const char *path);
+
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+#ifdef SELF
+int main(int argc, char *argv[])
+{
+  static replay_s rp;               // share and stream are big
+  char magic[LOG_MAGIC_LEN];
+  ts_mode_e tsMode = TS_MODE_LOCAL;
+  char *endptr;
+  int fd, opt, ret;
+
+  while ((opt = getopt(argc, argv, "s:t:")) != -1) {
+    switch (opt) {
+    case 's':
+      rp.speed = strtod(optarg, &endptr);
+      if (endptr == optarg || *endptr != '\0' || rp.speed < 0)
+	usageErr("%s [-s speed] [-t mode] <capture>\n", argv[0]);
+      break;
+    case 't':
+      if (ts_fmt_parse_mode(optarg, &tsMode) == -1)
+	usageErr("%s [-s speed] [-t mode] <capture>\n", argv[0]);
+      break;
+    default:
+      usageErr("%s [-s speed] [-t mode] <capture>\n", argv[0]);
+    }
+  }
+  if (optind >= argc)
+    usageErr("%s [-s speed] [-t mode] <capture>\n", argv[0]);
+
+  rp.share = shm_share_create(INA_MAX_DEVS);
+  if (rp.share == NULL)
+    errExit("shm_share_create");
+  rp.ctx.share = rp.share;
+  rp.ctx.tsFixed = 1;
+  ts_fmt_init(&rp.ctx.tsFmt, tsMode, TS_FMT_DEF, TS_FRAC_DIGITS);
+  stream_init(&rp.stream, STDOUT_FILENO, tsMode);
+
+  // Kind of capture by its magic
+  fd = open(argv[optind], O_RDONLY);
+  if (fd == -1 || read(fd, magic, sizeof(magic)) != sizeof(magic))
+    errExit("read %s", argv[optind]);
+  close(fd);
+  if (memcmp(magic, LOG_MAGIC, LOG_MAGIC_LEN) == 0)
+    ret = replay_raw(&rp, argv[optind]);
+  else if (memcmp(magic, CLOG_MAGIC, LOG_MAGIC_LEN) == 0)
+    ret = replay_clog(&rp, argv[optind]);
+  else {
+    fprintf(stderr, "{ \"ERROR\":\"not sample log\", \"file\":\"%s\" }\n",
+	    argv[optind]);
+    exit(EXIT_FAILURE);
+  }
+  if (ret == -1)
+    errExit("map %s", argv[optind]);
+
+  replay_report(&rp);
+  exit(EXIT_SUCCESS);
+}
+
+#endif // SELF
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+/* @func  replay_report - report session replayed so far through same
+ *                        commands as live run, 'accu' and 'stats'
+ */
+static void replay_report(replay_s *rp)
+{
+  char tsBuf[TS_BUF_LEN];
+  double secs;
+
+  if (rp->records == 0 && rp->bad == 0)
+    return;
+
+  secs = (meas_now_ns() - rp->startNs) / 1e9;
+  printf("{ \"replay\":{ \"session\":%d, \"start\":\"%s\", \"devices\":%d, \"samples\":%llu, \"bad\":%llu, \"missing\":%llu, \"clears\":%llu, \"elapsed_s\":%.3f, \"samples_per_s\":%.0f } }\n",
+	 rp->session,
+	 ts_format(&rp->ctx.tsFmt, rp->ctx.tsClock.realNs, tsBuf, sizeof(tsBuf)),
+	 rp->ndev, (unsigned long long)rp->records,
+	 (unsigned long long)rp->bad, (unsigned long long)rp->missing,
+	 (unsigned long long)rp->clears, secs, (secs > 0) ? rp->records / secs : 0.0);
+
+  if (rp->ndev > 0) {
+    rp->share->ndev = rp->ctx.ndev = rp->ndev;
+    cmd_exec(&rp->ctx, "accu", stdout, &rp->stream, &rp->pend);
+    cmd_exec(&rp->ctx, "stats", stdout, &rp->stream, &rp->pend);
+  }
+  fflush(stdout);
+}
+
+
+/* @func  replay_session - report finished session and start new one
+ *                         from zero, as new run of application does
+ * @param const log_rec_s *rec - session record, NULL capture without it
+ */
+static void replay_session(replay_s *rp, const log_rec_s *rec)
+{
+  int d;
+
+  replay_report(rp);
+
+  for (d = 0; d < INA_MAX_DEVS; d++) {
+    memset(&rp->share->dev[d], 0, sizeof(rp->share->dev[d]));
+    energy_q_reset(&rp->integ[d]);
+    rp->seen[d] = 0;
+  }
+  rp->ndev = 0;
+  rp->records = rp->bad = rp->missing = rp->clears = 0;
+  rp->paced = 0;
+  rp->session++;
+  rp->startNs = meas_now_ns();
+
+  // Timestamps of session are reported in wall time of recording
+  rp->ctx.tsClock.monoNs = (rec != NULL) ? rec->tsNs : 0;
+  rp->ctx.tsClock.realNs = (rec != NULL) ? log_session_realtime(rec) : 0;
+}
+
+
+/* @func  replay_pace - wait until sample is due at replay speed,
+ *                      sessions start at once. Blocks of compressed
+ *                      log are per device, earlier one runs unpaced
+ */
+static void replay_pace(replay_s *rp, int64_t tsNs)
+{
+  struct timespec due;
+  int64_t dueNs;
+
+  if (rp->speed == 0)
+    return;
+
+  if (!rp->paced) {
+    rp->paced = 1;
+    rp->originTsNs = tsNs;
+    rp->originNs = meas_now_ns();
+    return;
+  }
+  if (tsNs <= rp->originTsNs)
+    return;
+
+  dueNs = rp->originNs + (int64_t)((tsNs - rp->originTsNs) / rp->speed);
+  due.tv_sec = dueNs / NSEC_PER_SEC;
+  due.tv_nsec = dueNs % NSEC_PER_SEC;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR)
+    ;
+}
+
+
+/* @func  replay_rec - account one logged record as sampler did. Jump
+ *                     of seq counts records lost before logging, they
+ *                     make replay differ from live run
+ */
+static void replay_rec(replay_s *rp, const log_rec_s *rec)
+{
+  sample_s smp;
+  int d = rec->dev;
+
+  if (rec->dev == LOG_DEV_SESSION) {
+    replay_session(rp, rec);
+    return;
+  }
+  if (rp->session == 0)
+    replay_session(rp, NULL);
+  if (!log_rec_valid(rec) || d >= INA_MAX_DEVS) {
+    rp->bad++;
+    return;
+  }
+
+  if (rp->seen[d] && rec->seq != rp->nextSeq[d])
+    rp->missing += (uint16_t)(rec->seq - rp->nextSeq[d]);
+  rp->seen[d] = 1;
+  rp->nextSeq[d] = rec->seq + 1;
+  if (d >= rp->ndev)
+    rp->ndev = d + 1;
+
+  replay_pace(rp, rec->tsNs);
+
+  smp.tsNs = rec->tsNs;
+  memcpy(smp.raw, rec->raw, sizeof(smp.raw));
+  smp.flags = rec->flags;
+  sampler_account(&rp->share->dev[d], &rp->integ[d], &smp, 0);
+  rp->records++;
+  if (smp.flags & SMPL_F_CLEAR)
+    rp->clears++;
+}
+
+
+/* @func  replay_raw - replay raw log (-l) record by record
+ * @return SUCCESS      - 0
+ *         ERROR        - -1, errno set appropriately
+ */
+static int replay_raw(replay_s *rp, const char *path)
+{
+  log_map_s m;
+  size_t i;
+
+  if (log_map(path, &m) == -1)
+    return -1;
+  for (i = 0; i < m.nrec; i++)
+    replay_rec(rp, &m.recs[i]);
+  log_unmap(&m);
+
+  return 0;
+}
+
+
+/* @func  replay_clog - replay compressed log (-z) block by block,
+ *                      scan stops at first damaged block
+ * @return SUCCESS      - 0
+ *         ERROR        - -1, errno set appropriately
+ */
+static int replay_clog(replay_s *rp, const char *path)
+{
+  static log_rec_s recs[CLOG_BLOCK_SAMPLES];
+  clog_map_s m;
+  const clog_blk_s *blk;
+  uint64_t off;
+  int i, n;
+
+  if (clog_map(path, &m) == -1)
+    return -1;
+  for (off = sizeof(clog_hdr_s); off < m.size; off = clog_next(&m, off)) {
+    if ((blk = clog_block(&m, off)) == NULL) {
+      rp->bad++;
+      break;
+    }
+    n = clog_decode(blk, (const uint8_t *)(blk + 1), m.hdr->tsQuantNs, recs);
+    if (n == -1) {
+      rp->bad++;
+      continue;
+    }
+    for (i = 0; i < n; i++)
+      replay_rec(rp, &recs[i]);
+  }
+  clog_unmap(&m);
+
+  return 0;
+}
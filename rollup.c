@@ -0,0 +1,371 @@
+/*****************************************************************
+ * Title    : rollup.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Source file of windowed sample statistics. Windows are
+ *            aligned to multiples of their span on CLOCK_MONOTONIC,
+ *            so all devices roll over together. Conversions of INA219
+ *            are linear, thus statistics of raw counts are scaled to
+ *            volts, amperes and watts only when read
+ * Version  : 1.00
+ * Options  : SELF build checks estimates against exact values:
+ *            [samples]
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+
+//#define SELF
+//#define DEBUG
+//#define PRINT
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <math.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/INA219.h"
+#include "rollup.h"
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+const int64_t rollupSpanNs[ROLLUP_WINDOWS] = {
+  1000000000LL, 60000000000LL, 3600000000000LL
+};
+const char *rollupNames[ROLLUP_WINDOWS] = { "1s", "1m", "1h" };
+const char *rollupChNames[ROLLUP_CH] = { "voltage", "current", "power" };
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+static void rollup_win_reset(rollup_win_s *w, int64_t startNs);
+static void rollup_acc_add(rollup_acc_s *a, int32_t v);
+#ifdef SELF
+static int cmp_double(const void *a, const void *b);
+#endif // SELF
+
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+#ifdef SELF
+int main(int argc, char *argv[])
+{
+  rollup_block_s rb;
+  rollup_data_s d;
+  rollup_res_s r;
+  sample_s smp;
+  double *x, mean = 0, var = 0;
+  int32_t v;
+  int i, n = (argc > 1) ? atoi(argv[1]) : 100000;
+
+  x = malloc(n * sizeof(*x));
+  if (n < 1 || x == NULL)
+    usageErr("%s [samples]\n", argv[0]);
+
+  // Skewed current, mostly idle with rare inrush peaks, all in one window
+  memset(&rb, 0, sizeof(rb));
+  memset(&smp, 0, sizeof(smp));
+  srand(1);
+  for (i = 0; i < n; i++) {
+    v = 1000 + rand() % 200;
+    if (rand() % 50 == 0)
+      v += 5000 + rand() % 20000;
+    x[i] = currConv(v);
+    mean += x[i];
+
+    smp.tsNs = 1000000000LL * 3600 + i;
+    smp.raw[MEAS_CURR] = (uint16_t)v;
+    rollup_add(&rb, &smp);
+  }
+  mean /= n;
+  for (i = 0; i < n; i++)
+    var += (x[i] - mean) * (x[i] - mean);
+  qsort(x, n, sizeof(*x), cmp_double);
+
+  rollup_read(&rb, &d);
+  rollup_result(&d.cur[0], ROLLUP_CURR, &r);
+  printf("n     %llu\n", (unsigned long long)r.n);
+  printf("min   %.5f exact %.5f\n", r.min, x[0]);
+  printf("max   %.5f exact %.5f\n", r.max, x[n - 1]);
+  printf("mean  %.5f exact %.5f\n", r.mean, mean);
+  printf("sd    %.5f exact %.5f\n", r.stddev, sqrt(var / n));
+  printf("p50   %.5f exact %.5f\n", r.p50, x[(int)(0.50 * (n - 1))]);
+  printf("p99   %.5f exact %.5f\n", r.p99, x[(int)(0.99 * (n - 1))]);
+
+  free(x);
+  exit(EXIT_SUCCESS);
+}
+
+#endif // SELF
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+#ifdef SELF
+static int cmp_double(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
+#endif // SELF
+
+
+/* @func  rollup_win_reset - start empty window */
+static void rollup_win_reset(rollup_win_s *w, int64_t startNs)
+{
+  int ch;
+
+  w->used = 1;
+  w->startNs = startNs;
+  for (ch = 0; ch < ROLLUP_CH; ch++) {
+    w->ch[ch].n = 0;
+    w->ch[ch].mean = w->ch[ch].m2 = 0;
+    w->ch[ch].min = INT32_MAX;
+    w->ch[ch].max = INT32_MIN;
+    p2_init(&w->ch[ch].p50, 0.50);
+    p2_init(&w->ch[ch].p99, 0.99);
+  }
+}
+
+
+/* @func  rollup_acc_add - fold one value into running statistics */
+static void rollup_acc_add(rollup_acc_s *a, int32_t v)
+{
+  double delta;
+
+  a->n++;
+  delta = v - a->mean;
+  a->mean += delta / a->n;
+  a->m2 += delta * (v - a->mean);
+
+  if (v < a->min)
+    a->min = v;
+  if (v > a->max)
+    a->max = v;
+
+  p2_add(&a->p50, v);
+  p2_add(&a->p99, v);
+}
+
+
+/****************************************************************/
+/**************** Global Functions Definitions ******************/
+/****************************************************************/
+
+/* @func  p2_init - empty estimator of quantile p */
+void p2_init(p2_s *e, double p)
+{
+  memset(e, 0, sizeof(*e));
+  e->p = p;
+}
+
+
+/* @func  p2_add - add observation, markers are moved towards their
+ *                 desired positions by piecewise-parabolic prediction
+ */
+void p2_add(p2_s *e, double x)
+{
+  double d, qp, tmp;
+  int i, k;
+
+  // First five observations are kept sorted, they become markers
+  if (e->count < 5) {
+    for (i = e->count; i > 0 && e->q[i - 1] > x; i--)
+      e->q[i] = e->q[i - 1];
+    e->q[i] = x;
+    if (++e->count == 5) {
+      for (i = 0; i < 5; i++)
+	e->n[i] = i;
+      e->np[0] = 0;
+      e->np[1] = 2 * e->p;
+      e->np[2] = 4 * e->p;
+      e->np[3] = 2 + 2 * e->p;
+      e->np[4] = 4;
+    }
+    return;
+  }
+  e->count++;
+
+  // Cell of x, extreme markers follow new minimum and maximum
+  if (x < e->q[0]) {
+    e->q[0] = x;
+    k = 0;
+  }
+  else if (x >= e->q[4]) {
+    e->q[4] = x;
+    k = 3;
+  }
+  else
+    for (k = 0; k < 3 && x >= e->q[k + 1]; k++)
+      ;
+
+  for (i = k + 1; i < 5; i++)
+    e->n[i]++;
+  e->np[1] += e->p / 2;
+  e->np[2] += e->p;
+  e->np[3] += (1 + e->p) / 2;
+  e->np[4] += 1;
+
+  for (i = 1; i < 4; i++) {
+    d = e->np[i] - e->n[i];
+    if ((d >= 1 && e->n[i + 1] - e->n[i] > 1)
+	|| (d <= -1 && e->n[i - 1] - e->n[i] < -1)) {
+      d = (d > 0) ? 1 : -1;
+
+      // Parabolic prediction, linear when it would break ordering
+      qp = e->q[i] + d / (e->n[i + 1] - e->n[i - 1])
+	* ((e->n[i] - e->n[i - 1] + d) * (e->q[i + 1] - e->q[i])
+	   / (e->n[i + 1] - e->n[i])
+	   + (e->n[i + 1] - e->n[i] - d) * (e->q[i] - e->q[i - 1])
+	   / (e->n[i] - e->n[i - 1]));
+      if (qp <= e->q[i - 1] || qp >= e->q[i + 1]) {
+	tmp = e->q[i + (int)d];
+	qp = e->q[i] + d * (tmp - e->q[i]) / (e->n[i + (int)d] - e->n[i]);
+      }
+      e->q[i] = qp;
+      e->n[i] += d;
+    }
+  }
+}
+
+
+/* @func  p2_value - current estimate, exact while fewer than five
+ *                   observations were added
+ */
+double p2_value(const p2_s *e)
+{
+  if (e->count == 0)
+    return 0;
+  if (e->count < 5)
+    return e->q[(int)(e->p * (e->count - 1) + 0.5)];
+
+  return e->q[2];
+}
+
+
+/* @func  rollup_scale - engineering units per raw count of channel */
+double rollup_scale(int ch)
+{
+  switch (ch) {
+  case ROLLUP_VOLT:
+    return busVoltConv(1 << 3);
+  case ROLLUP_CURR:
+    return currConv(1) / (1 << MEAS_SCALE_MAX);
+  default:
+    return pwrConv(1) / (1 << MEAS_SCALE_MAX);
+  }
+}
+
+
+/* @func  rollup_values - raw counts of channels of sample, current and
+ *                        power in LSB of finest range, all ranges mix
+ *                        exactly. Current register is signed, power
+ *                        register is not, as energy integrator takes it
+ * @param int32_t *v     - ROLLUP_CH values
+ */
+void rollup_values(const sample_s *smp, int32_t *v)
+{
+  v[ROLLUP_VOLT] = smp->raw[MEAS_BUS] >> 3;
+  v[ROLLUP_CURR] = (int16_t)smp->raw[MEAS_CURR]
+    * (1 << (MEAS_SCALE_MAX - smplScale(smp->flags)));
+  v[ROLLUP_POWER] = (int32_t)meas_power_fine(smp);
+}
+
+
+/* @func  rollup_add - fold sample into all windows, only bus worker
+ *                     of device may call it
+ * @param rollup_block_s *rb - statistics in shared memory
+ * @param const sample_s *smp - sample with raw words
+ */
+void rollup_add(rollup_block_s *rb, const sample_s *smp)
+{
+  int32_t v[ROLLUP_CH];
+  int64_t startNs;
+  rollup_win_s *w;
+  uint32_t seq;
+  int i, ch;
+
+  rollup_values(smp, v);
+
+  seq = atomic_load_explicit(&rb->seq, memory_order_relaxed);
+  atomic_store_explicit(&rb->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  for (i = 0; i < ROLLUP_WINDOWS; i++) {
+    w = &rb->d.cur[i];
+    startNs = smp->tsNs - smp->tsNs % rollupSpanNs[i];
+    if (!w->used || w->startNs != startNs) {
+      if (w->used)
+	rb->d.last[i] = *w;
+      rollup_win_reset(w, startNs);
+    }
+    for (ch = 0; ch < ROLLUP_CH; ch++)
+      rollup_acc_add(&w->ch[ch], v[ch]);
+  }
+
+  atomic_store_explicit(&rb->seq, seq + 2, memory_order_release);
+}
+
+
+/* @func  rollup_read - take consistent copy of all windows, retrying
+ *                      while sampler is in the middle of update
+ */
+void rollup_read(const rollup_block_s *rb, rollup_data_s *d)
+{
+  uint32_t s1, s2;
+
+  do {
+    s1 = atomic_load_explicit(&rb->seq, memory_order_acquire);
+    *d = rb->d;
+    atomic_thread_fence(memory_order_acquire);
+    s2 = atomic_load_explicit(&rb->seq, memory_order_relaxed);
+  } while ((s1 & 1) || s1 != s2);
+}
+
+
+/* @func  rollup_result - finalize statistics of channel in window
+ * @param const rollup_win_s *w - window copied by rollup_read()
+ * @param int ch               - ROLLUP_VOLT, ROLLUP_CURR or ROLLUP_POWER
+ * @param rollup_res_s *r      - volts, amperes or watts, zero if empty
+ */
+void rollup_result(const rollup_win_s *w, int ch, rollup_res_s *r)
+{
+  const rollup_acc_s *a = &w->ch[ch];
+  double s = rollup_scale(ch);
+
+  memset(r, 0, sizeof(*r));
+  if (!w->used || a->n == 0)
+    return;
+
+  r->n = a->n;
+  r->min = a->min * s;
+  r->max = a->max * s;
+  r->mean = a->mean * s;
+  r->stddev = sqrt(a->m2 / a->n) * fabs(s);
+  r->p50 = p2_value(&a->p50) * s;
+  r->p99 = p2_value(&a->p99) * s;
+}
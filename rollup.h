@@ -0,0 +1,96 @@
+/*****************************************************************
+ * Title    : rollup.h
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Header file of windowed sample statistics. Bus worker
+ *            folds every sample into running min/max/mean/stddev
+ *            and P-square p50/p99 estimates of 1 s, 1 min and 1 h
+ *            tumbling windows, O(1) per sample. State lives in shared
+ *            memory under seqlock, readers finalize it on demand
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <stdint.h>
+#include <stdatomic.h>
+#include "measure.h"
+
+/****************************************************************/
+/******************* Symbolic Constant Definitions **************/
+/****************************************************************/
+// Channels, statistics run on raw counts, current and power in LSB of
+// finest auto-ranged range
+#define ROLLUP_VOLT      0          // bus voltage
+#define ROLLUP_CURR      1
+#define ROLLUP_POWER     2
+#define ROLLUP_CH        3
+
+#define ROLLUP_WINDOWS   3          // 1 s, 1 min, 1 h
+
+/****************************************************************/
+/********************** New Types Definitions *******************/
+/****************************************************************/
+// P-square estimator of one quantile (Jain & Chlamtac), five markers
+typedef struct {
+  double p;                         // quantile, 0 - 1
+  double q[5];                      // marker heights
+  double n[5];                      // marker positions
+  double np[5];                     // desired positions
+  uint32_t count;                   // observations, first 5 kept in q
+} p2_s;
+
+typedef struct {
+  uint64_t n;
+  double mean, m2;                  // Welford running mean and M2
+  int32_t min, max;
+  p2_s p50, p99;
+} rollup_acc_s;
+
+typedef struct {
+  int used;                         // window holds samples
+  int64_t startNs;                  // CLOCK_MONOTONIC, multiple of span
+  rollup_acc_s ch[ROLLUP_CH];
+} rollup_win_s;
+
+typedef struct {
+  rollup_win_s cur[ROLLUP_WINDOWS]; // window being filled
+  rollup_win_s last[ROLLUP_WINDOWS]; // last completed window
+} rollup_data_s;
+
+typedef struct {
+  _Atomic uint32_t seq;             // odd while sampler updates data
+  rollup_data_s d;
+} rollup_block_s;
+
+// Finalized statistics of one channel in engineering units
+typedef struct {
+  uint64_t n;
+  double min, max, mean, stddev, p50, p99;
+} rollup_res_s;
+
+/****************************************************************/
+/******************* Global Variable Declarations ***************/
+/****************************************************************/
+extern const int64_t rollupSpanNs[ROLLUP_WINDOWS];
+extern const char *rollupNames[ROLLUP_WINDOWS];
+extern const char *rollupChNames[ROLLUP_CH];
+
+/****************************************************************/
+/******************* Global Functions Declarations **************/
+/****************************************************************/
+void p2_init(p2_s *e, double p);
+void p2_add(p2_s *e, double x);
+double p2_value(const p2_s *e);
+
+double rollup_scale(int ch);
+void rollup_values(const sample_s *smp, int32_t *v);
+void rollup_add(rollup_block_s *rb, const sample_s *smp);
+void rollup_read(const rollup_block_s *rb, rollup_data_s *d);
+void rollup_result(const rollup_win_s *w, int ch, rollup_res_s *r);
+
+#endif // ROLLUP_H
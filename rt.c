@@ -0,0 +1,236 @@
+/*****************************************************************
+ * Title    : rt.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Source file of real-time mode of sampler workers. Each
+ *            step is tried on its own, worker without privilege keeps
+ *            sampling with what it got and reports the rest
+ * Version  : 1.00
+ * Options  : SELF build measures wakeup lateness at rate Hz:
+ *            [prio[:cpu]] [rate] [seconds]
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+#define _GNU_SOURCE             // CPU_SET(), sched_setaffinity()
+
+//#define SELF
+//#define DEBUG
+//#define PRINT
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <sched.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include "../header/tlpi_hdr.h"
+#include "rt.h"
+#ifdef SELF
+#include <time.h>
+#include "lat_hist.h"
+#endif // SELF
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+static void rt_prefault_stack(void);
+
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+#ifdef SELF
+int main(int argc, char *argv[])
+{
+  static hist_s h;
+  static uint64_t oct[HIST_MAX_BITS];
+  rt_opts_s o = { 0, 0, { 0 } };
+  rt_state_s st;
+  struct timespec next, now;
+  long rate = (argc > 2) ? getLong(argv[2], GN_GT_0, "rate") : 1000;
+  long secs = (argc > 3) ? getLong(argv[3], GN_GT_0, "seconds") : 10;
+  long i;
+  int e;
+
+  if (argc > 1 && rt_parse(argv[1], &o) == -1)
+    usageErr("%s [prio[:cpu]] [rate] [seconds]\n", argv[0]);
+  rt_enter(&o, 0, &st);
+  printf("prio %d cpu %d locked %d\n", st.prio, st.cpu, st.locked);
+
+  // Absolute deadlines, lateness is wakeup past deadline
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  for (i = 0; i < rate * secs; i++) {
+    next.tv_nsec += 1000000000L / rate;
+    if (next.tv_nsec >= 1000000000L) {
+      next.tv_sec++;
+      next.tv_nsec -= 1000000000L;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL)
+	   == EINTR)
+      ;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    hist_add(&h, (now.tv_sec - next.tv_sec) * 1000000000LL
+	     + (now.tv_nsec - next.tv_nsec));
+  }
+
+  printf("wakeups %llu p50 %.1f us p99 %.1f us p99.9 %.1f us max %.1f us\n",
+	 (unsigned long long)hist_count(&h), hist_quantile(&h, 0.50) / 1e3,
+	 hist_quantile(&h, 0.99) / 1e3, hist_quantile(&h, 0.999) / 1e3,
+	 atomic_load(&h.maxNs) / 1e3);
+  hist_octaves(&h, oct);
+  for (e = 0; e < HIST_MAX_BITS; e++)
+    if (oct[e] > 0)
+      printf("< %10.1f us %10llu\n", (double)(1ULL << (e + 1)) / 1e3,
+	     (unsigned long long)oct[e]);
+
+  exit(EXIT_SUCCESS);
+}
+
+#endif // SELF
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+/* @func  rt_prefault_stack - touch stack worker can ever use, locked
+ *                            pages are then present for good
+ */
+static void rt_prefault_stack(void)
+{
+  volatile unsigned char stack[RT_STACK_PREFAULT];
+  size_t i;
+
+  for (i = 0; i < sizeof(stack); i += 4096)
+    stack[i] = 0;
+}
+
+
+/****************************************************************/
+/**************** Global Functions Definitions ******************/
+/****************************************************************/
+
+/* @func  rt_parse - parse spec of -R
+ * @param const char *spec - prio[:cpu[,cpu]...], prio 1 - 99
+ * @param rt_opts_s *o     - options, updated only on success
+ * @return SUCCESS         - 0
+ *         ERROR           - -1, errno EINVAL
+ */
+int rt_parse(const char *spec, rt_opts_s *o)
+{
+  rt_opts_s r = { 0, 0, { 0 } };
+  char *endptr;
+  long n;
+
+  n = strtol(spec, &endptr, 10);
+  if (endptr == spec || n < sched_get_priority_min(SCHED_FIFO)
+      || n > sched_get_priority_max(SCHED_FIFO))
+    goto inval;
+  r.prio = (int)n;
+
+  if (*endptr == ':') {
+    do {
+      spec = endptr + 1;
+      n = strtol(spec, &endptr, 10);
+      if (endptr == spec || n < 0 || n >= CPU_SETSIZE
+	  || r.ncpu == RT_MAX_CPUS)
+	goto inval;
+      r.cpus[r.ncpu++] = (int)n;
+    } while (*endptr == ',');
+  }
+  if (*endptr != '\0')
+    goto inval;
+
+  *o = r;
+  return 0;
+
+ inval:
+  errno = EINVAL;
+  return -1;
+}
+
+
+/* @func  rt_enter - switch calling worker to real-time mode: pin it,
+ *                   lock its memory, keep heap from being trimmed or
+ *                   mmapped, fault stack in, then raise policy to
+ *                   SCHED_FIFO. Failed step is reported on stderr
+ * @param const rt_opts_s *o - options, prio 0 does nothing
+ * @param int worker         - index of bus worker, selects CPU
+ * @param rt_state_s *st     - what took effect
+ * @return SUCCESS           - 0
+ *         ERROR             - -1, some step failed, others applied
+ */
+int rt_enter(const rt_opts_s *o, int worker, rt_state_s *st)
+{
+  struct sched_param sp;
+  cpu_set_t set;
+  int ret = 0;
+
+  st->prio = 0;
+  st->cpu = -1;
+  st->locked = 0;
+  if (o->prio == 0)
+    return 0;
+
+  if (o->ncpu > 0) {
+    CPU_ZERO(&set);
+    CPU_SET(o->cpus[(worker < o->ncpu) ? worker : o->ncpu - 1], &set);
+    if (sched_setaffinity(0, sizeof(set), &set) == -1) {
+      fprintf(stderr,
+	      "{ \"WARN\":\"rt sched_setaffinity\", \"worker\":%d } errno: %s\n",
+	      worker, strerror(errno));
+      ret = -1;
+    }
+    else
+      st->cpu = o->cpus[(worker < o->ncpu) ? worker : o->ncpu - 1];
+  }
+
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+    fprintf(stderr,
+	    "{ \"WARN\":\"rt mlockall\", \"worker\":%d } errno: %s\n",
+	    worker, strerror(errno));
+    ret = -1;
+  }
+  else
+    st->locked = 1;
+  mallopt(M_TRIM_THRESHOLD, -1);
+  mallopt(M_MMAP_MAX, 0);
+  rt_prefault_stack();
+
+  sp.sched_priority = o->prio;
+  if (sched_setscheduler(0, SCHED_FIFO, &sp) == -1) {
+    fprintf(stderr,
+	    "{ \"WARN\":\"rt sched_setscheduler\", \"worker\":%d } errno: %s\n",
+	    worker, strerror(errno));
+    ret = -1;
+  }
+  else
+    st->prio = o->prio;
+
+  return ret;
+}
@@ -0,0 +1,45 @@
+/*****************************************************************
+ * Title    : rt.h
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Header file of real-time mode of sampler workers. Worker
+ *            is pinned to its CPU, runs SCHED_FIFO above every normal
+ *            service and has all its memory locked and stack faulted
+ *            in before first tick, so wakeup never waits for page
+ *            fault or time slice of other process
+ * Version  : 1.00
+ * Options  : spec of -R is prio[:cpu[,cpu]...], worker of bus i is
+ *            pinned to i-th cpu of list, last one serves the rest
+ ****************************************************************/
+#ifndef RT_H
+#define RT_H
+
+/****************************************************************/
+/******************* Symbolic Constant Definitions **************/
+/****************************************************************/
+#define RT_MAX_CPUS      16
+#define RT_STACK_PREFAULT (256 * 1024) // stack touched before first tick
+
+/****************************************************************/
+/********************** New Types Definitions *******************/
+/****************************************************************/
+typedef struct {
+  int prio;                         // SCHED_FIFO priority, 0 mode off
+  int ncpu;                         // CPUs listed, 0 keeps affinity
+  int cpus[RT_MAX_CPUS];
+} rt_opts_s;
+
+// What actually took effect in worker, reported by 'jitter'
+typedef struct {
+  int prio;                         // SCHED_FIFO priority, 0 none
+  int cpu;                          // pinned CPU, -1 none
+  int locked;                       // mlockall() succeeded
+} rt_state_s;
+
+/****************************************************************/
+/******************* Global Functions Declarations **************/
+/****************************************************************/
+int rt_parse(const char *spec, rt_opts_s *o);
+int rt_enter(const rt_opts_s *o, int worker, rt_state_s *st);
+
+#endif // RT_H
@@ -0,0 +1,532 @@
+/*****************************************************************
+ * Title    : sample_log.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Source file of persistent sample log. Logger process
+ *            drains sample rings of all devices every LOG_FLUSH_MS
+ *            and appends records in one write() per batch, so
+ *            sampler never waits for storage. Same samples can go to
+ *            compressed log (see clog.h). Reader maps the file and
+ *            scans records in place
+ * Version  : 1.00
+ * Options  : SELF build dumps log file: <file>
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+
+//#define SELF
+//#define DEBUG
+//#define PRINT
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../header/tlpi_hdr.h"
+#include "sample_log.h"
+#include "clog.h"
+#include "ts_fmt.h"
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+#define CRC32_POLY     0xedb88320U      // reflected IEEE 802.3
+
+_Static_assert(sizeof(log_hdr_s) == 16, "log_hdr_s layout changed");
+_Static_assert(sizeof(log_rec_s) == 24, "log_rec_s layout changed");
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+static uint32_t crcTable[256];
+static int crcTableReady = 0;
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+static void crc_table_init(void);
+static void log_drain(log_writer_s *w, clog_writer_s *z, shm_share_s *share,
+		      uint64_t *cursor);
+
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+#ifdef SELF
+int main(int argc, char *argv[])
+{
+  log_map_s m;
+  const log_rec_s *rec;
+  size_t i, bad = 0;
+
+  if (argc < 2 || strcmp(argv[1], "--help") == 0)
+    usageErr("%s <sample log file>\n", argv[0]);
+
+  if (log_map(argv[1], &m) == -1)
+    errExit("log_map %s", argv[1]);
+
+  printf("ts_ns,dev,seq,flags,shunt,bus,current,power\n");
+  for (i = 0; i < m.nrec; i++) {
+    rec = &m.recs[i];
+    if (!log_rec_valid(rec)) {
+      bad++;
+      continue;
+    }
+    if (rec->dev == LOG_DEV_SESSION) {
+      printf("# session realtime %lld ns\n",
+	     (long long)log_session_realtime(rec));
+      continue;
+    }
+    printf("%lld,%u,%u,0x%02x,0x%04x,0x%04x,0x%04x,0x%04x\n",
+	   (long long)rec->tsNs, rec->dev, rec->seq, rec->flags,
+	   rec->raw[MEAS_SHUNT], rec->raw[MEAS_BUS],
+	   rec->raw[MEAS_CURR], rec->raw[MEAS_POWER]);
+  }
+  fprintf(stderr, "%zu records, %zu bad checksum\n", m.nrec, bad);
+
+  log_unmap(&m);
+  exit(EXIT_SUCCESS);
+}
+
+#endif // SELF
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+static void crc_table_init(void)
+{
+  uint32_t c;
+  int i, k;
+
+  for (i = 0; i < 256; i++) {
+    c = (uint32_t)i;
+    for (k = 0; k < 8; k++)
+      c = (c & 1) ? CRC32_POLY ^ (c >> 1) : c >> 1;
+    crcTable[i] = c;
+  }
+  crcTableReady = 1;
+}
+
+
+/* @func  log_drain - append samples published since last drain. When
+ *                    logger fell more than ring size behind, overwritten
+ *                    samples are counted as lost and skipped
+ * @param log_writer_s *w  - raw log, NULL none
+ * @param clog_writer_s *z - compressed log, NULL none
+ * @param uint64_t *cursor - per device index of next sample to log
+ */
+static void log_drain(log_writer_s *w, clog_writer_s *z, shm_share_s *share,
+		      uint64_t *cursor)
+{
+  sample_s smp;
+  uint64_t head, lost = 0;
+  int d;
+
+  for (d = 0; d < share->ndev; d++) {
+    head = ring_head(&share->dev[d].ring);
+    if (head - cursor[d] > RING_SLOTS) {
+      lost += head - cursor[d] - RING_SLOTS;
+      cursor[d] = head - RING_SLOTS;
+    }
+
+    for (; cursor[d] < head; cursor[d]++) {
+      if (ring_read(&share->dev[d].ring, cursor[d], &smp) == -1) {
+	lost++;
+	continue;
+      }
+      if (w != NULL)
+	log_append(w, d, cursor[d], &smp);
+      if (z != NULL)
+	clog_append(z, d, cursor[d], &smp);
+    }
+  }
+
+  if (w != NULL) {
+    w->lost += lost;
+    log_flush(w);
+  }
+  if (z != NULL) {
+    pthread_mutex_lock(&z->lock);
+    z->lost += lost;
+    pthread_mutex_unlock(&z->lock);
+  }
+}
+
+
+/****************************************************************/
+/**************** Global Functions Definitions ******************/
+/****************************************************************/
+
+/* @func  log_crc32 - update CRC-32 (IEEE) with buffer
+ * @param uint32_t crc - 0 to start new checksum
+ * @return updated checksum
+ */
+uint32_t log_crc32(uint32_t crc, const void *buf, size_t len)
+{
+  const unsigned char *p = buf;
+
+  if (!crcTableReady)
+    crc_table_init();
+
+  crc = ~crc;
+  while (len--)
+    crc = crcTable[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+  return ~crc;
+}
+
+
+/* @func  log_write_all - write whole buffer, resuming partial writes
+ * @return SUCCESS   - 0
+ *         ERROR     - -1, errno set appropriately
+ */
+int log_write_all(int fd, const void *buf, size_t len)
+{
+  const char *p = buf;
+  ssize_t n;
+
+  while (len > 0) {
+    n = write(fd, p, len);
+    if (n == -1) {
+      if (errno == EINTR)
+	continue;
+      return -1;
+    }
+    p += n;
+    len -= n;
+  }
+
+  return 0;
+}
+
+
+/* @func  log_open - open log file for appending, create it with header
+ *                   when new, cut torn record left by crash when not
+ * @param log_writer_s *w - writer to initialize
+ * @param const char *path - log file
+ * @return SUCCESS         - 0
+ *         ERROR           - -1, errno set appropriately (EINVAL when
+ *                           file is not sample log)
+ */
+int log_open(log_writer_s *w, const char *path)
+{
+  log_hdr_s hdr;
+  struct stat sb;
+  off_t body;
+
+  memset(w, 0, sizeof(*w));
+
+  w->fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (w->fd == -1)
+    return -1;
+  if (fstat(w->fd, &sb) == -1)
+    goto fail;
+
+  if (sb.st_size == 0) {
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, LOG_MAGIC, LOG_MAGIC_LEN);
+    hdr.version = LOG_VERSION;
+    hdr.recSize = sizeof(log_rec_s);
+    hdr.crc = log_crc32(0, &hdr, offsetof(log_hdr_s, crc));
+    if (log_write_all(w->fd, &hdr, sizeof(hdr)) == -1)
+      goto fail;
+  }
+  else {
+    if (pread(w->fd, &hdr, sizeof(hdr), 0) != sizeof(hdr)
+	|| memcmp(hdr.magic, LOG_MAGIC, LOG_MAGIC_LEN) != 0
+	|| hdr.version != LOG_VERSION || hdr.recSize != sizeof(log_rec_s)
+	|| hdr.crc != log_crc32(0, &hdr, offsetof(log_hdr_s, crc))) {
+      errno = EINVAL;
+      goto fail;
+    }
+    body = sb.st_size - sizeof(hdr);
+    if (body % sizeof(log_rec_s) != 0
+	&& ftruncate(w->fd, sb.st_size - body % sizeof(log_rec_s)) == -1)
+      goto fail;
+  }
+
+  return log_session(w);
+
+ fail:
+  close(w->fd);
+  w->fd = -1;
+  return -1;
+}
+
+
+/* @func  log_session_sample - sample of session record, its raw words
+ *                             carry CLOCK_REALTIME paired with tsNs
+ */
+void log_session_sample(sample_s *smp)
+{
+  ts_clock_s clk;
+  int i;
+
+  memset(smp, 0, sizeof(*smp));
+  ts_clock_sync(&clk);
+  smp->tsNs = clk.monoNs;
+  for (i = 0; i < MEAS_REGS; i++)
+    smp->raw[i] = (uint16_t)((uint64_t)clk.realNs >> (16 * i));
+}
+
+
+/* @func  log_session - append session record binding CLOCK_MONOTONIC
+ *                      timestamps that follow to wall-clock time
+ */
+int log_session(log_writer_s *w)
+{
+  sample_s smp;
+
+  log_session_sample(&smp);
+  return log_append(w, LOG_DEV_SESSION, 0, &smp);
+}
+
+
+/* @func  log_append - add sample to batch, batch is written when full
+ * @param int dev          - device index
+ * @param uint64_t seq     - ring index of sample
+ * @param const sample_s *smp - sample
+ * @return SUCCESS         - 0
+ *         ERROR           - -1, write of full batch failed
+ */
+int log_append(log_writer_s *w, int dev, uint64_t seq, const sample_s *smp)
+{
+  log_rec_s *rec;
+
+  if (w->nbatch == LOG_BATCH_RECS && log_flush(w) == -1)
+    return -1;
+
+  rec = &w->batch[w->nbatch++];
+  rec->tsNs = smp->tsNs;
+  memcpy(rec->raw, smp->raw, sizeof(rec->raw));
+  rec->seq = (uint16_t)seq;
+  rec->dev = (uint8_t)dev;
+  rec->flags = (uint8_t)smp->flags;
+  rec->crc = log_crc32(0, rec, offsetof(log_rec_s, crc));
+
+  return 0;
+}
+
+
+/* @func  log_flush - write batched records in one write()
+ * @return SUCCESS   - 0
+ *         ERROR     - -1, errno set appropriately, batch is dropped
+ */
+int log_flush(log_writer_s *w)
+{
+  int ret;
+
+  if (w->nbatch == 0)
+    return 0;
+
+  ret = log_write_all(w->fd, w->batch, w->nbatch * sizeof(log_rec_s));
+  if (ret == 0)
+    w->written += w->nbatch;
+  else
+    w->lost += w->nbatch;
+  w->nbatch = 0;
+
+  return ret;
+}
+
+
+/* @func  log_close - flush, sync and close log file */
+int log_close(log_writer_s *w)
+{
+  int ret = log_flush(w);
+
+  if (fdatasync(w->fd) == -1)
+    ret = -1;
+  if (close(w->fd) == -1)
+    ret = -1;
+  w->fd = -1;
+
+  return ret;
+}
+
+
+/* @func  log_map - map log file read-only for scanning
+ * @param const char *path - log file
+ * @param log_map_s *m     - mapping to fill, whole records only
+ * @return SUCCESS         - 0
+ *         ERROR           - -1, errno set appropriately
+ */
+int log_map(const char *path, log_map_s *m)
+{
+  const log_hdr_s *hdr;
+  struct stat sb;
+  int fd;
+
+  memset(m, 0, sizeof(*m));
+
+  fd = open(path, O_RDONLY);
+  if (fd == -1)
+    return -1;
+  if (fstat(fd, &sb) == -1) {
+    close(fd);
+    return -1;
+  }
+  if ((size_t)sb.st_size < sizeof(log_hdr_s)) {
+    close(fd);
+    errno = EINVAL;
+    return -1;
+  }
+
+  m->base = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (m->base == MAP_FAILED)
+    return -1;
+  m->size = sb.st_size;
+
+  hdr = m->base;
+  if (memcmp(hdr->magic, LOG_MAGIC, LOG_MAGIC_LEN) != 0
+      || hdr->version != LOG_VERSION || hdr->recSize != sizeof(log_rec_s)) {
+    log_unmap(m);
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Records are scanned front to back, let kernel read ahead
+  madvise(m->base, m->size, MADV_SEQUENTIAL);
+
+  m->recs = (const log_rec_s *)((const char *)m->base + sizeof(log_hdr_s));
+  m->nrec = (m->size - sizeof(log_hdr_s)) / sizeof(log_rec_s);
+
+  return 0;
+}
+
+
+/* @func  log_unmap - release mapping of log file */
+void log_unmap(log_map_s *m)
+{
+  if (m->base != NULL && m->base != MAP_FAILED)
+    munmap(m->base, m->size);
+  memset(m, 0, sizeof(*m));
+}
+
+
+/* @func  log_rec_valid - verify checksum of record
+ * @return 1 valid, 0 corrupted
+ */
+int log_rec_valid(const log_rec_s *rec)
+{
+  return rec->crc == log_crc32(0, rec, offsetof(log_rec_s, crc));
+}
+
+
+/* @func  log_session_realtime - CLOCK_REALTIME ns stored in session record */
+int64_t log_session_realtime(const log_rec_s *rec)
+{
+  uint64_t realNs = 0;
+  int i;
+
+  for (i = 0; i < MEAS_REGS; i++)
+    realNs |= (uint64_t)rec->raw[i] << (16 * i);
+
+  return (int64_t)realNs;
+}
+
+
+/* @func  log_worker - loop of logger process, drains rings of all
+ *                     devices to log files until exit is requested
+ * @param shm_share_s *share - shared state with sample rings
+ * @param const char *path   - raw log file, NULL none
+ * @param const char *zPath  - compressed log file, NULL none
+ * @param volatile sig_atomic_t *exitFlag - set by signal handler to stop
+ * @return SUCCESS           - 0, exit requested, logs flushed
+ *         ERROR             - -1, error reported on stderr
+ */
+int log_worker(shm_share_s *share, const char *path, const char *zPath,
+	       volatile sig_atomic_t *exitFlag)
+{
+  static log_writer_s w;              // batch is too big for stack
+  static clog_writer_s z;             // so are blocks
+  log_writer_s *pw = NULL;
+  clog_writer_s *pz = NULL;
+  uint64_t cursor[share->ndev];
+  struct timespec period, lastSync, now;
+  int ret = 0;
+
+  if (path != NULL) {
+    if (log_open(&w, path) == -1) {
+      fprintf(stderr,
+	      "{ \"ERROR\":\"log_open-%s\" errno: %s }\n", path, strerror(errno));
+      return -1;
+    }
+    pw = &w;
+  }
+  if (zPath != NULL) {
+    if (clog_open(&z, zPath) == -1) {
+      fprintf(stderr,
+	      "{ \"ERROR\":\"clog_open-%s\" errno: %s }\n", zPath,
+	      strerror(errno));
+      if (pw != NULL)
+	log_close(pw);
+      return -1;
+    }
+    pz = &z;
+  }
+
+  memset(cursor, 0, sizeof(cursor));
+  period.tv_sec = LOG_FLUSH_MS / 1000;
+  period.tv_nsec = (LOG_FLUSH_MS % 1000) * 1000000L;
+  clock_gettime(CLOCK_MONOTONIC, &lastSync);
+
+  while (!*exitFlag) {
+    // Interrupted sleep is fine, loop re-checks exit flag
+    nanosleep(&period, NULL);
+    log_drain(pw, pz, share, cursor);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (pz != NULL)
+      clog_tick(pz, now.tv_sec * 1000000000LL + now.tv_nsec);
+    // Encoder thread syncs compressed log itself
+    if (pw != NULL && now.tv_sec - lastSync.tv_sec >= LOG_SYNC_SEC) {
+      fdatasync(w.fd);
+      lastSync = now;
+    }
+  }
+
+  // Workers are stopped first, take their last samples
+  log_drain(pw, pz, share, cursor);
+
+#ifdef DEBUG
+  if (pw != NULL)
+    printf("Sample log: %llu records written, %llu lost\n",
+	   (unsigned long long)w.written, (unsigned long long)w.lost);
+#endif // DEBUG
+
+  if (pw != NULL && log_close(pw) == -1)
+    ret = -1;
+  if (pz != NULL) {
+    if (clog_close(pz) == -1)
+      ret = -1;
+#ifdef DEBUG
+    printf("Compressed log: %llu samples in %llu bytes, %llu lost\n",
+	   (unsigned long long)z.written, (unsigned long long)z.bytes,
+	   (unsigned long long)z.lost);
+#endif // DEBUG
+  }
+
+  return ret;
+}
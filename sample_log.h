@@ -0,0 +1,97 @@
+/*****************************************************************
+ * Title    : sample_log.h
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Header file of persistent sample log. Append-only file
+ *            of fixed-size checksummed records (timestamp + raw
+ *            register words), written in batches by logger process
+ *            and read back through mmap
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+#ifndef SAMPLE_LOG_H
+#define SAMPLE_LOG_H
+
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <stddef.h>
+#include <stdint.h>
+#include <signal.h>
+#include "measure.h"
+#include "shm_ring.h"
+
+/****************************************************************/
+/******************* Symbolic Constant Definitions **************/
+/****************************************************************/
+#define LOG_MAGIC        "INA219LG"
+#define LOG_MAGIC_LEN    8
+#define LOG_VERSION      1
+
+// Record of this device index marks start of sampling session, its
+// raw words carry CLOCK_REALTIME ns matching tsNs (CLOCK_MONOTONIC)
+#define LOG_DEV_SESSION  0xff
+
+#define LOG_BATCH_RECS   2048       // records written by one write()
+#define LOG_FLUSH_MS     250        // logger drains rings this often
+#define LOG_SYNC_SEC     10         // fdatasync() period, spares SD card
+
+/****************************************************************/
+/********************** New Types Definitions *******************/
+/****************************************************************/
+
+/* File layout, little-endian: log_hdr_s followed by log_rec_s records.
+ * Torn record at end of file (crash during write) is cut on reopen */
+typedef struct {
+  char magic[LOG_MAGIC_LEN];
+  uint16_t version;
+  uint16_t recSize;
+  uint32_t crc;                 // CRC-32 of preceding header bytes
+} log_hdr_s;
+
+typedef struct {
+  int64_t tsNs;                 // CLOCK_MONOTONIC time of read
+  uint16_t raw[MEAS_REGS];      // register words in MEAS_* order
+  uint16_t seq;                 // low bits of ring index, reveals drops
+  uint8_t dev;                  // device index or LOG_DEV_SESSION
+  uint8_t flags;                // SMPL_F_* flags
+  uint32_t crc;                 // CRC-32 of preceding record bytes
+} log_rec_s;
+
+typedef struct {
+  int fd;
+  log_rec_s batch[LOG_BATCH_RECS];
+  int nbatch;
+  uint64_t written;             // records written
+  uint64_t lost;                // samples overwritten in ring before logged
+} log_writer_s;
+
+typedef struct {
+  void *base;
+  size_t size;
+  const log_rec_s *recs;
+  size_t nrec;
+} log_map_s;
+
+/****************************************************************/
+/******************* Global Functions Declarations **************/
+/****************************************************************/
+uint32_t log_crc32(uint32_t crc, const void *buf, size_t len);
+int log_write_all(int fd, const void *buf, size_t len);
+void log_session_sample(sample_s *smp);
+
+int log_open(log_writer_s *w, const char *path);
+int log_session(log_writer_s *w);
+int log_append(log_writer_s *w, int dev, uint64_t seq, const sample_s *smp);
+int log_flush(log_writer_s *w);
+int log_close(log_writer_s *w);
+
+int log_map(const char *path, log_map_s *m);
+void log_unmap(log_map_s *m);
+int log_rec_valid(const log_rec_s *rec);
+int64_t log_session_realtime(const log_rec_s *rec);
+
+int log_worker(shm_share_s *share, const char *path, const char *zPath,
+	       volatile sig_atomic_t *exitFlag);
+
+#endif // SAMPLE_LOG_H
@@ -0,0 +1,766 @@
+/*****************************************************************
+ * Title    : sampler.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Source file of sampler scheduler. Sampler process
+ *            blocks in clock_nanosleep() on absolute CLOCK_MONOTONIC
+ *            deadlines instead of spinning on SIGALRM flag, either at
+ *            fixed rate or paced by conversion-ready bit of INA219
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+
+//#define SELF
+//#define DEBUG
+//#define PRINT
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <time.h>
+#include <errno.h>
+#include "../header/tlpi_hdr.h"
+#include "../header/INA219.h"
+#include "measure.h"
+#include "energy.h"
+#include "sampler.h"
+#include "ina_config.h"
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+
+/* Conversion times of INA219 ADC in ns indexed by SADC/BADC field
+ * (datasheet table 5). 0x0-0x3 resolution, 0x8 12bit, 0x9-0xf averaging */
+static const long adcConvNs[16] = {
+  84000, 148000, 276000, 532000,
+  84000, 148000, 276000, 532000,
+  532000, 1060000, 2130000, 4260000,
+  8510000, 17020000, 34050000, 68100000
+};
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+static void sched_deadline(sched_s *sch);
+static int sampler_take(ina_dev_s *dev, int d, dev_share_s *ds,
+			energy_q_s *integ, uint64_t missed);
+static int sampler_serve(ina_dev_s *devs, int ndev, int busIdx,
+			 shm_share_s *share, energy_q_s *integ, int reads);
+static int sampler_online(ina_dev_s *dev, int d);
+static void sampler_down(ina_dev_s *dev, int d, dev_share_s *ds);
+static void sampler_range(ina_dev_s *dev, int d, dev_share_s *ds, int pg);
+static void sampler_clear(dev_share_s *ds, energy_q_s *integ);
+static int sampler_conv_times(ina_dev_s *devs, int ndev, int busIdx,
+			      shm_share_s *share, int64_t *convNs);
+static void sampler_stat_add(_Atomic uint64_t *cnt, uint64_t n);
+static void sampler_stat_ns(_Atomic int64_t *last, _Atomic int64_t *max,
+			    int64_t ns);
+static void sampler_timing(ina_dev_s *devs, int ndev, int busIdx,
+			   shm_share_s *share, int64_t lateNs,
+			   uint64_t overruns);
+static int sampler_cnvr(ina_dev_s *devs, int ndev, int busIdx,
+			shm_share_s *share, energy_q_s *integ,
+			volatile sig_atomic_t *exitFlag);
+
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+#ifdef SELF
+int main(int argc, char *argv[])
+{
+  sched_s sch;
+  struct timespec now;
+  int i, rate;
+
+  rate = (argc > 1) ? getInt(argv[1], GN_GT_0, "rate") : 10;
+
+  if (sched_init(&sch, rate) == -1)
+    errExit("sched_init");
+
+  for (i = 0; i < 3 * rate; i++) {
+    if (sched_wait(&sch) == -1)
+      errExit("sched_wait");
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    printf("tick %d at %ld.%09ld\n", i, (long)now.tv_sec, now.tv_nsec);
+  }
+  printf("overruns: %lu\n", sch.overruns);
+
+  exit(EXIT_SUCCESS);
+}
+
+#endif // SELF
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+/* @func  sched_deadline - compute absolute deadline of tick sch->tick
+ *                         as start + tick/rate seconds in integer math
+ * @param sched_s *sch    - scheduler state
+ */
+static void sched_deadline(sched_s *sch)
+{
+  unsigned long long sec, rem;
+
+  sec = sch->tick / sch->rate;
+  rem = sch->tick % sch->rate;
+
+  sch->next.tv_sec = sch->start.tv_sec + (time_t)sec;
+  sch->next.tv_nsec = sch->start.tv_nsec + (long)(rem * NSEC_PER_SEC / sch->rate);
+  if (sch->next.tv_nsec >= NSEC_PER_SEC) {
+    sch->next.tv_sec++;
+    sch->next.tv_nsec -= NSEC_PER_SEC;
+  }
+}
+
+
+/* @func  sampler_take - read one sample of device, publish it and
+ *                       account it by sampler_account(). First sample
+ *                       after outage is marked SMPL_F_GAP
+ * @param ina_dev_s *dev  - device to read
+ * @param int d           - index of device
+ * @param dev_share_s *ds - shared block of device
+ * @param energy_q_s *integ - energy integrator of device
+ * @param uint64_t missed - conversions lost since previous sample
+ * @return 1 sample taken, 0 device offline
+ */
+static int sampler_take(ina_dev_s *dev, int d, dev_share_s *ds,
+			energy_q_s *integ, uint64_t missed)
+{
+  char RDwords[MEAS_REGS][2];
+  sample_s smp;
+  int64_t startNs;
+  int pg;
+
+  if (!sampler_online(dev, d))
+    return 0;
+
+  // Read shunt, bus, current and power registers in one transaction
+  startNs = meas_now_ns();
+  if (ina_dev_read_words(dev, measRegs, RDwords, MEAS_REGS) == -1) {
+    sampler_stat_add(&ds->stats.i2cErrors, 1);
+    sampler_down(dev, d, ds);
+    return 0;
+  }
+
+  // Publish raw sample, readers convert it when they report
+  meas_decode(RDwords, meas_now_ns(), &smp);
+  pg = autorange_step(&dev->range, &smp);
+  if (dev->lost) {
+    smp.flags |= SMPL_F_GAP;
+    dev->lost = 0;
+  }
+  if (dev->cleared) {
+    smp.flags |= SMPL_F_CLEAR;
+    dev->cleared = 0;
+  }
+  ring_publish(&ds->ring, &smp);
+  sampler_stat_ns(&ds->stats.readNs, &ds->stats.readMaxNs,
+		  smp.tsNs - startNs);
+  sampler_account(ds, integ, &smp, missed);
+
+  if (pg != -1)
+    sampler_range(dev, d, ds, pg);
+
+  return 1;
+}
+
+
+/* @func  sampler_online - check device is online. Offline device is
+ *                         recovered once its backoff elapsed, backoff
+ *                         doubles up to INA_REOPEN_MAX_NS while it
+ *                         keeps failing
+ * @return 1 online, 0 offline
+ */
+static int sampler_online(ina_dev_s *dev, int d)
+{
+  int64_t now;
+
+  if (dev->reopenNs == 0)
+    return 1;
+
+  now = meas_now_ns();
+  if (now < dev->reopenNs)
+    return 0;
+
+  if (ina_dev_recover(dev) == -1) {
+    dev->reopenStepNs *= 2;
+    if (dev->reopenStepNs > INA_REOPEN_MAX_NS)
+      dev->reopenStepNs = INA_REOPEN_MAX_NS;
+    dev->reopenNs = now + dev->reopenStepNs;
+    return 0;
+  }
+
+  dev->reopenNs = 0;
+  dev->verifyNs = now + INA_VERIFY_NS;
+  fprintf(stderr, "{ \"INFO\":\"device back online\", \"device\":%d }\n", d);
+  return 1;
+}
+
+
+/* @func  sampler_down - device failed even after retries and reopen,
+ *                       take it offline. Worker keeps sampling other
+ *                       devices and all accumulated state
+ */
+static void sampler_down(ina_dev_s *dev, int d, dev_share_s *ds)
+{
+  fprintf(stderr,
+	  "{ \"WARN\":\"device offline, recovering\", \"device\":%d } errno: %s\n",
+	  d, strerror(errno));
+
+  dev->lost = 1;
+  dev->reopenStepNs = INA_REOPEN_MIN_NS;
+  dev->reopenNs = meas_now_ns() + dev->reopenStepNs;
+  sampler_stat_add(&ds->stats.outages, 1);
+}
+
+
+/* @func  sampler_range - switch PGA range of auto-ranged device, after
+ *                        sample deciding it was published. Samples
+ *                        read before first conversion of new range
+ *                        ends are marked SMPL_F_RANGE
+ * @param int pg          - new PGA field
+ */
+static void sampler_range(ina_dev_s *dev, int d, dev_share_s *ds, int pg)
+{
+  int ret;
+
+  autorange_switch(&dev->range, pg, &dev->conf, &dev->calib);
+
+  // Conversion completing in between already uses new calibration
+  ret = ina_dev_write_word(dev, calib_reg, (short)dev->calib);
+  if (ret != -1)
+    ret = ina_dev_write_word(dev, config_reg, (short)dev->conf);
+  dev->range.settleNs = meas_now_ns() + ina219_conv_time_ns(dev->conf)
+    + AR_SETTLE_NS;
+
+  // Recovery of device writes registers of new range
+  if (ret == -1) {
+    sampler_stat_add(&ds->stats.i2cErrors, 1);
+    sampler_down(dev, d, ds);
+    return;
+  }
+  sampler_stat_add(&ds->stats.rangeSwitches, 1);
+}
+
+
+/* @func  sampler_clear - zero energy and accumulator of device,
+ *                        integration restarts at next sample
+ */
+static void sampler_clear(dev_share_s *ds, energy_q_s *integ)
+{
+  energy_q_reset(integ);
+  accu_write_begin(&ds->accu);
+  memset(&ds->accu.d, 0, sizeof(ds->accu.d));
+  accu_write_end(&ds->accu);
+}
+
+
+/* @func  sampler_serve - serve clear, config and read requested by
+ *                        readers, worker is only writer of accu and
+ *                        only user of its bus. Called after scheduled
+ *                        samples were taken, so they always go first.
+ *                        Registers of every device are checked once
+ *                        per INA_VERIFY_NS for reset
+ * @param int reads       - take sample for pending read request now,
+ *                          0 when next scheduled sample serves it
+ * @return number of devices reconfigured or restored
+ */
+static int sampler_serve(ina_dev_s *devs, int ndev, int busIdx,
+			 shm_share_s *share, energy_q_s *integ, int reads)
+{
+  dev_share_s *ds;
+  uint32_t req;
+  uint16_t conf, calib;
+  int64_t now;
+  int d, nconf = 0;
+
+  for (d = 0; d < ndev; d++) {
+    ds = &share->dev[d];
+    if (devs[d].busIdx != busIdx)
+      continue;
+
+    // Next sample carries clear, so log and replay see it too
+    if (shm_clear_pending(ds, &req)) {
+      sampler_clear(ds, &integ[d]);
+      devs[d].cleared = 1;
+      shm_clear_ack(ds, req);
+    }
+
+    // Offline device gets requested config once recovered
+    if (devs[d].reopenNs == 0
+	&& shm_config_pending(ds, &req, &conf, &calib)) {
+      if (ina_dev_config(&devs[d], (short)conf, (short)calib) == -1) {
+	sampler_stat_add(&ds->stats.i2cErrors, 1);
+	sampler_down(&devs[d], d, ds);
+      }
+      else {
+	shm_config_ack(ds, req);
+	nconf++;
+      }
+    }
+
+    /* All readers waiting share one transaction, sample goes to ring
+     * and accumulator like scheduled one */
+    if (reads && shm_read_pending(ds, &req)
+	&& sampler_take(&devs[d], d, ds, &integ[d], 0) == 1)
+      shm_read_ack(ds, req);
+
+    // Reset by brownout leaves calibration zero, restore it
+    now = meas_now_ns();
+    if (devs[d].reopenNs == 0 && now >= devs[d].verifyNs) {
+      devs[d].verifyNs = now + INA_VERIFY_NS;
+      switch (ina_dev_check(&devs[d])) {
+      case -1:
+	sampler_stat_add(&ds->stats.i2cErrors, 1);
+	break;
+      case 1:
+	fprintf(stderr,
+		"{ \"WARN\":\"device reset, registers restored\", \"device\":%d }\n",
+		d);
+	devs[d].lost = 1;
+	nconf++;
+	break;
+      }
+    }
+  }
+
+  return nconf;
+}
+
+
+/* @func  sampler_conv_times - conversion time as actually configured
+ *                             in every device on bus
+ * @param int64_t *convNs - conversion time in ns, indexed by device
+ * @return SUCCESS        - 0
+ *         ERROR          - -1, error reported on stderr
+ */
+static int sampler_conv_times(ina_dev_s *devs, int ndev, int busIdx,
+			      shm_share_s *share, int64_t *convNs)
+{
+  char RDbuf[2];
+  short regVal;
+  int d;
+
+  for (d = 0; d < ndev; d++) {
+    if (devs[d].busIdx != busIdx)
+      continue;
+
+    // Offline device will be restored to configuration written last
+    if (devs[d].reopenNs != 0)
+      regVal = (short)devs[d].conf;
+    else if (ina_dev_read_word(&devs[d], config_reg, RDbuf) == -1) {
+      sampler_stat_add(&share->dev[d].stats.i2cErrors, 1);
+      sampler_down(&devs[d], d, &share->dev[d]);
+      regVal = (short)devs[d].conf;
+    }
+    else
+      strtosh(RDbuf, regVal);
+    convNs[d] = ina219_conv_time_ns((unsigned short)regVal);
+    if (convNs[d] == 0) {
+      fprintf(stderr,
+	      "{ \"ERROR\":\"device not converting\", \"device\":%d }\n", d);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+
+/* @func  sampler_cnvr - sampling loop paced by conversion-ready bit.
+ *                       Once a result was taken, next one can not come
+ *                       sooner than one conversion time, so bus register
+ *                       is polled only in short window around it (every
+ *                       conversion time / CNVR_POLL_DIV). Reading power
+ *                       register clears CNVR, thus every conversion is
+ *                       taken exactly once
+ * @return SUCCESS        - 0, exit requested
+ *         ERROR          - -1, error reported on stderr
+ */
+static int sampler_cnvr(ina_dev_s *devs, int ndev, int busIdx,
+			shm_share_s *share, energy_q_s *integ,
+			volatile sig_atomic_t *exitFlag)
+{
+  int64_t convNs[INA_MAX_DEVS], nextNs[INA_MAX_DEVS], lastNs[INA_MAX_DEVS];
+  int64_t now, wake, missed;
+  uint32_t req;
+  char RDbuf[2];
+  short regVal = 0;
+  struct timespec ts;
+  int d, err, nconf;
+
+  if (sampler_conv_times(devs, ndev, busIdx, share, convNs) == -1)
+    return -1;
+  for (d = 0; d < ndev; d++) {
+    nextNs[d] = meas_now_ns();
+    lastNs[d] = 0;
+  }
+
+  for (;;) {
+    now = meas_now_ns();
+    wake = INT64_MAX;
+
+    for (d = 0; d < ndev; d++) {
+      if (devs[d].busIdx != busIdx)
+	continue;
+
+      if (nextNs[d] <= now) {
+	if (sampler_online(&devs[d], d)) {
+	  if (ina_dev_read_word(&devs[d], bus_volt_reg, RDbuf) == -1) {
+	    sampler_stat_add(&share->dev[d].stats.i2cErrors, 1);
+	    sampler_down(&devs[d], d, &share->dev[d]);
+	  }
+	  else
+	    strtosh(RDbuf, regVal);
+	}
+
+	// Offline device is polled for recovery, nothing counts as missed
+	if (devs[d].reopenNs != 0) {
+	  nextNs[d] = devs[d].reopenNs;
+	  lastNs[d] = 0;
+	}
+	else if (!(regVal & CNVR))
+	  nextNs[d] = now + convNs[d] / CNVR_POLL_DIV;
+	else {
+	  /* Conversions elapsed since last result were lost. Taken result
+	   * is seen up to one polling step late, so late wakeup alone never
+	   * stretches gap beyond 1.75 conversion time */
+	  missed = 0;
+	  if (lastNs[d] != 0)
+	    missed = (now - lastNs[d] + convNs[d] / 4) / convNs[d] - 1;
+	  lastNs[d] = now;
+
+	  // Extra read would steal conversion, this result serves readers
+	  if (sampler_take(&devs[d], d, &share->dev[d], &integ[d],
+			   missed > 0 ? (uint64_t)missed : 0) == 1
+	      && shm_read_pending(&share->dev[d], &req))
+	    shm_read_ack(&share->dev[d], req);
+	  nextNs[d] = (devs[d].reopenNs != 0) ? devs[d].reopenNs
+	    : now + convNs[d] - convNs[d] / CNVR_POLL_DIV;
+	}
+      }
+
+      if (nextNs[d] < wake)
+	wake = nextNs[d];
+    }
+
+    // Sleep until first device expects result, woken early only by signal
+    ts.tv_sec = wake / NSEC_PER_SEC;
+    ts.tv_nsec = wake % NSEC_PER_SEC;
+    err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    if (err != 0 && err != EINTR) {
+      fprintf(stderr,
+	      "{ \"ERROR\":\"clock_nanosleep\" errno: %s }\n", strerror(err));
+      return -1;
+    }
+    if (err == 0)
+      sampler_timing(devs, ndev, busIdx, share, meas_now_ns() - wake, 0);
+
+    nconf = sampler_serve(devs, ndev, busIdx, share, integ, 0);
+
+    // Reconfigured device restarts conversion, track it from scratch
+    if (nconf > 0) {
+      if (sampler_conv_times(devs, ndev, busIdx, share, convNs) == -1)
+	return -1;
+      for (d = 0; d < ndev; d++) {
+	nextNs[d] = meas_now_ns();
+	lastNs[d] = 0;
+      }
+    }
+
+    // Check if parent does require exit
+    if (*exitFlag)
+      return 0;
+  }
+}
+
+
+/* @func  sampler_stat_add - count into shared counter. Worker is its
+ *                           only writer, plain load and store suffice
+ */
+static void sampler_stat_add(_Atomic uint64_t *cnt, uint64_t n)
+{
+  atomic_store_explicit(cnt, atomic_load_explicit(cnt, memory_order_relaxed)
+			+ n, memory_order_relaxed);
+}
+
+
+/* @func  sampler_stat_ns - publish last duration and keep maximum */
+static void sampler_stat_ns(_Atomic int64_t *last, _Atomic int64_t *max,
+			    int64_t ns)
+{
+  atomic_store_explicit(last, ns, memory_order_relaxed);
+  if (ns > atomic_load_explicit(max, memory_order_relaxed))
+    atomic_store_explicit(max, ns, memory_order_relaxed);
+}
+
+
+/* @func  sampler_timing - publish wakeup lateness and ticks skipped by
+ *                         bus worker to stats of every device on bus
+ */
+static void sampler_timing(ina_dev_s *devs, int ndev, int busIdx,
+			   shm_share_s *share, int64_t lateNs,
+			   uint64_t overruns)
+{
+  smpl_stats_s *st;
+  int d;
+
+  for (d = 0; d < ndev; d++) {
+    if (devs[d].busIdx != busIdx)
+      continue;
+    st = &share->dev[d].stats;
+    sampler_stat_ns(&st->lateNs, &st->lateMaxNs, lateNs);
+    hist_add(&st->lateHist, lateNs);
+    if (overruns > 0)
+      sampler_stat_add(&st->overruns, overruns);
+  }
+}
+
+
+/****************************************************************/
+/**************** Global Functions Definitions ******************/
+/****************************************************************/
+
+/* @func  sampler_account - fold published sample into rollup, energy
+ *                          and accumulator of device. Flags of sample
+ *                          decide everything, so replay of logged
+ *                          samples gives same results bit for bit.
+ *                          Energy of gap is not guessed, integration
+ *                          starts over after it. SMPL_F_CLEAR sample
+ *                          zeroes totals as live clear did before it
+ * @param dev_share_s *ds   - shared block of device
+ * @param energy_q_s *integ - energy integrator of device
+ * @param const sample_s *smp - sample as published to ring
+ * @param uint64_t missed   - conversions lost since previous sample
+ */
+void sampler_account(dev_share_s *ds, energy_q_s *integ,
+		     const sample_s *smp, uint64_t missed)
+{
+  int64_t gapNs = 0;
+
+  // Live worker cleared already, nothing was accounted since
+  if (smp->flags & SMPL_F_CLEAR)
+    sampler_clear(ds, integ);
+  if (smp->flags & SMPL_F_GAP) {
+    if (integ->primed)
+      gapNs = smp->tsNs - integ->prevTsNs;
+    energy_q_gap(integ);
+  }
+
+  /* Integrate raw power over real time elapsed since previous sample.
+   * Sample of uncertain range or overflowed is left out, trapezoid
+   * bridges it */
+  if (smp->flags & SMPL_F_RANGE)
+    sampler_stat_add(&ds->stats.rangeMarked, 1);
+  else if (smp->flags & SMPL_F_OVF)
+    sampler_stat_add(&ds->stats.ovfSamples, 1);
+  if (!(smp->flags & SMPL_F_SKIP)) {
+    rollup_add(&ds->rollup, smp);
+    energy_q_add(integ, smp->tsNs, meas_power_fine(smp));
+  }
+  accu_write_begin(&ds->accu);
+  ds->accu.d.energy = integ->sum;
+  ds->accu.d.samples++;
+  ds->accu.d.missed += missed;
+  if (smp->flags & SMPL_F_GAP) {
+    ds->accu.d.gaps++;
+    ds->accu.d.gapNs += gapNs;
+  }
+  ds->accu.d.lastTsNs = smp->tsNs;
+  accu_write_end(&ds->accu);
+}
+
+
+/* @func  sched_init - initialize sampler scheduler, first deadline
+ *                     is one period from now
+ * @param sched_s *sch - scheduler state to initialize
+ * @param long rate    - sample rate in Hz
+ * @return SUCCESS     - 0
+ *         ERROR       - -1, errno set appropriately
+ */
+int sched_init(sched_s *sch, long rate)
+{
+  if (rate < SMPL_RATE_MIN) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  memset(sch, 0, sizeof(*sch));
+  sch->rate = rate;
+  if (clock_gettime(CLOCK_MONOTONIC, &sch->start) == -1)
+    return -1;
+
+  sch->tick = 1;
+  sched_deadline(sch);
+
+  return 0;
+}
+
+
+/* @func  sched_wait - block until deadline of next tick. When the
+ *                     sampler ran late, missed ticks are skipped and
+ *                     counted in overruns, so rate never bursts
+ * @param sched_s *sch - scheduler state
+ * @return SUCCESS     - 0, deadline reached
+ *         ERROR       - -1, errno set appropriately (EINTR on signal,
+ *                       deadline stays pending)
+ */
+int sched_wait(sched_s *sch)
+{
+  struct timespec now;
+  int err;
+
+  err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &sch->next, NULL);
+  if (err != 0) {
+    errno = err;
+    return -1;
+  }
+
+  if (clock_gettime(CLOCK_MONOTONIC, &now) == -1)
+    return -1;
+  sch->lateNs = (long long)(now.tv_sec - sch->next.tv_sec) * NSEC_PER_SEC
+    + (now.tv_nsec - sch->next.tv_nsec);
+
+  // Advance to first deadline in the future
+  sch->tick++;
+  sched_deadline(sch);
+  while (sch->next.tv_sec < now.tv_sec ||
+	 (sch->next.tv_sec == now.tv_sec && sch->next.tv_nsec <= now.tv_nsec)) {
+    sch->tick++;
+    sch->overruns++;
+    sched_deadline(sch);
+  }
+
+  return 0;
+}
+
+
+/* @func  ina219_conv_time_ns - time INA219 needs to complete one
+ *                              conversion cycle with given configuration
+ * @param unsigned short confRegVal - value of configuration register
+ * @return conversion time in ns (shunt + bus in continuous shunt&bus mode)
+ */
+long ina219_conv_time_ns(unsigned short confRegVal)
+{
+  long ns = 0;
+  unsigned short mode = confRegVal & CONF_MODE_MASK;
+
+  if (mode & CONF_MODE_SHUNT)
+    ns += adcConvNs[(confRegVal >> CONF_SADC_SHIFT) & CONF_ADC_MASK];
+  if (mode & CONF_MODE_BUS)
+    ns += adcConvNs[(confRegVal >> CONF_BADC_SHIFT) & CONF_ADC_MASK];
+
+  return ns;
+}
+
+
+/* @func  ina219_max_rate - highest sample rate at which every sample
+ *                          still sees new conversion result
+ * @param unsigned short confRegVal - value of configuration register
+ * @return rate in Hz, at least SMPL_RATE_MIN
+ */
+long ina219_max_rate(unsigned short confRegVal)
+{
+  long ns = ina219_conv_time_ns(confRegVal);
+
+  if (ns == 0 || NSEC_PER_SEC / ns < SMPL_RATE_MIN)
+    return SMPL_RATE_MIN;
+
+  return NSEC_PER_SEC / ns;
+}
+
+
+/* @func  sampler_worker - sampling loop of one bus worker. Devices on
+ *                         the bus are read one after another each tick,
+ *                         workers of different buses run in parallel
+ * @param ina_dev_s *devs     - all measured devices, opened and configured
+ * @param int ndev            - number of devices
+ * @param int busIdx          - bus served by this worker
+ * @param shm_share_s *share  - shared state, one block per device
+ * @param long rate           - sample rate in Hz, SMPL_RATE_CNVR to take
+ *                              every conversion as soon as it is ready
+ * @param volatile sig_atomic_t *exitFlag - set by signal handler to stop
+ * @return SUCCESS            - 0, exit requested
+ *         ERROR              - -1, error reported on stderr
+ */
+int sampler_worker(ina_dev_s *devs, int ndev, int busIdx, shm_share_s *share,
+		   long rate, volatile sig_atomic_t *exitFlag)
+{
+  energy_q_s integ[INA_MAX_DEVS];
+  sched_s sched;
+  unsigned long overruns = 0;      // of sched already published
+  long newRate;
+  int d;
+
+  for (d = 0; d < ndev; d++)
+    energy_q_reset(&integ[d]);
+
+  if (rate == SMPL_RATE_CNVR)
+    return sampler_cnvr(devs, ndev, busIdx, share, integ, exitFlag);
+
+  if (sched_init(&sched, rate) == -1) {
+    fprintf(stderr,
+	    "{ \"ERROR\":\"sched_init\" errno: %s }\n", strerror(errno));
+    return -1;
+  }
+
+  for (;;) {
+
+    // Block until next sample deadline, woken early only by signal
+    if (sched_wait(&sched) == 0) {
+      sampler_timing(devs, ndev, busIdx, share, sched.lateNs,
+		     sched.overruns - overruns);
+      overruns = sched.overruns;
+      for (d = 0; d < ndev; d++)
+	if (devs[d].busIdx == busIdx)
+	  sampler_take(&devs[d], d, &share->dev[d], &integ[d], 0);
+    }
+    else if (errno != EINTR) {
+      fprintf(stderr,
+	      "{ \"ERROR\":\"sched_wait\" errno: %s }\n", strerror(errno));
+      return -1;
+    }
+
+    sampler_serve(devs, ndev, busIdx, share, integ, 1);
+
+    // Rate retuned by 'config', new schedule starts one period from now
+    newRate = atomic_load_explicit(&share->rate, memory_order_relaxed);
+    if (newRate != sched.rate) {
+      if (sched_init(&sched, newRate) == -1) {
+	fprintf(stderr,
+		"{ \"ERROR\":\"sched_init\" errno: %s }\n", strerror(errno));
+	return -1;
+      }
+      overruns = 0;
+    }
+
+    // Check if parent does require exit
+    if (*exitFlag)
+      return 0;
+  }
+}
@@ -0,0 +1,62 @@
+/*****************************************************************
+ * Title    : sampler.h
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Header file of sampler scheduler. Paces sampling of
+ *            INA219 registers on absolute CLOCK_MONOTONIC deadlines,
+ *            one sampler worker process per physical bus
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <time.h>
+#include <signal.h>
+#include "ina_dev.h"
+#include "shm_ring.h"
+
+/****************************************************************/
+/******************* Symbolic Constant Definitions **************/
+/****************************************************************/
+#define SMPL_RATE_MIN   1          /* Lowest sample rate in Hz */
+#define SMPL_RATE_DEF   1          /* Default sample rate in Hz */
+#define SMPL_RATE_CNVR  0          /* Pace by conversion-ready bit */
+
+// Polling step around expected conversion is conversion time / this
+#define CNVR_POLL_DIV   8
+
+#define NSEC_PER_SEC    1000000000L
+
+/****************************************************************/
+/********************** New Types Definitions *******************/
+/****************************************************************/
+
+/* Sampler scheduler state. Deadlines are derived from tick counter
+ * and start time, never by summing periods, thus no drift even when
+ * rate does not divide one second evenly */
+typedef struct {
+  struct timespec start;     // CLOCK_MONOTONIC time of tick 0
+  struct timespec next;      // absolute deadline of next tick
+  long rate;                 // sample rate in Hz
+  unsigned long long tick;   // index of next tick
+  unsigned long overruns;    // ticks skipped because sampler ran late
+  long long lateNs;          // wakeup past deadline of last tick
+} sched_s;
+
+/****************************************************************/
+/******************* Global Functions Declarations **************/
+/****************************************************************/
+int sched_init(sched_s *sch, long rate);
+int sched_wait(sched_s *sch);
+long ina219_conv_time_ns(unsigned short confRegVal);
+long ina219_max_rate(unsigned short confRegVal);
+int sampler_worker(ina_dev_s *devs, int ndev, int busIdx, shm_share_s *share,
+		   long rate, volatile sig_atomic_t *exitFlag);
+void sampler_account(dev_share_s *ds, energy_q_s *integ,
+		     const sample_s *smp, uint64_t missed);
+
+#endif // SAMPLER_H
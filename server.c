@@ -0,0 +1,585 @@
+/*****************************************************************
+ * Title    : server.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Source file of command server. Every client owns
+ *            stream buffer, command responses are queued in it
+ *            behind streamed lines and written when socket is
+ *            writable, so slow client never blocks others or console.
+ *            Command waiting for sampler parks its client only
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+#define _GNU_SOURCE             // accept4()
+
+//#define SELF
+//#define DEBUG
+//#define PRINT
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "../header/tlpi_hdr.h"
+#include "metrics.h"
+#include "server.h"
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+
+// epoll data of listening sockets, clients are tagged by slot index
+#define SRV_TAG_UNIX     SRV_MAX_CLIENTS
+#define SRV_TAG_TCP      (SRV_MAX_CLIENTS + 1)
+#define SRV_TAG_HTTP     (SRV_MAX_CLIENTS + 2)
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+static int srv_listen(server_s *srv, int fd, uint32_t tag);
+static int srv_loopback(int port);
+static void srv_accept(server_s *srv, int lfd, int kind);
+static void srv_drop(server_s *srv, int i);
+static int srv_read(server_s *srv, srv_client_s *c, cmd_ctx_s *ctx);
+static int srv_reply(srv_client_s *c, cmd_ctx_s *ctx, const char *line);
+static int srv_lines(srv_client_s *c, cmd_ctx_s *ctx);
+static int srv_http(srv_client_s *c, cmd_ctx_s *ctx);
+static size_t srv_pending(const srv_client_s *c);
+static int srv_flush_body(srv_client_s *c);
+static void srv_interest(server_s *srv, int i);
+
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+/* @func  srv_listen - listen on bound socket and add it to epoll */
+static int srv_listen(server_s *srv, int fd, uint32_t tag)
+{
+  struct epoll_event ev;
+
+  if (listen(fd, SRV_BACKLOG) == -1)
+    return -1;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.u32 = tag;
+  return epoll_ctl(srv->epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+
+/* @func  srv_loopback - bound TCP socket on loopback port
+ * @return SUCCESS     - socket descriptor
+ *         ERROR       - -1, errno set appropriately
+ */
+static int srv_loopback(int port)
+{
+  struct sockaddr_in addr;
+  int fd, on = 1;
+
+  fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd == -1)
+    return -1;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) == -1
+      || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+
+/* @func  srv_accept - accept pending connections into free slots,
+ *                     client above SRV_MAX_CLIENTS is refused
+ * @param int kind     - SRV_CLIENT_* of accepted connections
+ */
+static void srv_accept(server_s *srv, int lfd, int kind)
+{
+  struct epoll_event ev;
+  srv_client_s *c;
+  int fd, i;
+
+  while ((fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+    for (i = 0; i < SRV_MAX_CLIENTS && srv->clients[i] != NULL; i++)
+      ;
+    c = (i < SRV_MAX_CLIENTS) ? malloc(sizeof(*c)) : NULL;
+    if (c == NULL) {
+      close(fd);
+      continue;
+    }
+
+    stream_init(&c->st, fd, srv->tsMode);
+    c->fd = fd;
+    c->kind = kind;
+    c->closing = 0;
+    c->inLen = 0;
+    c->events = EPOLLIN;
+    memset(&c->pend, 0, sizeof(c->pend));
+    c->body = NULL;
+    c->bodyLen = c->bodyOff = 0;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = c->events;
+    ev.data.u32 = i;
+    if (epoll_ctl(srv->epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+      close(fd);
+      free(c);
+      continue;
+    }
+    srv->clients[i] = c;
+  }
+}
+
+
+/* @func  srv_drop - close client, its buffered output is discarded */
+static void srv_drop(server_s *srv, int i)
+{
+  srv_client_s *c = srv->clients[i];
+
+  if (c == NULL)
+    return;
+
+  // Closing fd also removes it from epoll set
+  cmd_cancel(&c->pend);
+  close(c->fd);
+  free(c->body);
+  free(c);
+  srv->clients[i] = NULL;
+}
+
+
+/* @func  srv_read - read commands of client and queue responses
+ * @return SUCCESS  - 0
+ *         ERROR    - -1, client closed, quit or can not keep up
+ */
+static int srv_read(server_s *srv, srv_client_s *c, cmd_ctx_s *ctx)
+{
+  ssize_t numRead;
+
+  // Client with command parked is read once it is finished
+  if (c->pend.kind != CMD_PEND_NONE)
+    return 0;
+
+  // Rest of request after metrics were queued is of no interest
+  if (c->closing)
+    c->inLen = 0;
+
+  numRead = read(c->fd, c->in + c->inLen, sizeof(c->in) - c->inLen - 1);
+  if (numRead == -1)
+    return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+  if (numRead == 0)
+    return -1;
+  c->inLen += numRead;
+
+  if (c->kind == SRV_CLIENT_HTTP)
+    return c->closing ? 0 : srv_http(c, ctx);
+
+  // Overlong line without newline is dropped
+  if (c->inLen == sizeof(c->in) - 1 && memchr(c->in, '\n', c->inLen) == NULL)
+    c->inLen = 0;
+
+  return srv_lines(c, ctx);
+}
+
+
+/* @func  srv_reply - execute command line, or poll parked command of
+ *                    client, and queue response whole behind stream
+ * @param const char *line - command line, NULL polls parked command
+ * @return SUCCESS  - 0
+ *         ERROR    - -1, client can not keep up
+ */
+static int srv_reply(srv_client_s *c, cmd_ctx_s *ctx, const char *line)
+{
+  char *resp;
+  size_t respLen;
+  FILE *out;
+  int ret;
+
+  // Response is built in memory, then queued whole behind stream
+  out = open_memstream(&resp, &respLen);
+  if (out == NULL)
+    return -1;
+  if (line == NULL)
+    cmd_poll(&c->pend, out);
+  else if (cmd_exec(ctx, line, out, &c->st, &c->pend) == CMD_EXIT)
+    fprintf(out, "{ \"WARN\":\"'exit' is console only, 'quit' closes connection\" }\n");
+  fclose(out);
+  ret = stream_write(&c->st, resp, respLen);
+  free(resp);
+
+  return ret;
+}
+
+
+/* @func  srv_lines - run complete command lines of client. Command
+ *                    parked for sampler stops it, lines behind wait
+ *                    until srv_reply() polled it to end
+ * @return SUCCESS  - 0
+ *         ERROR    - -1, client quit or can not keep up
+ */
+static int srv_lines(srv_client_s *c, cmd_ctx_s *ctx)
+{
+  char *eol;
+
+  while (c->pend.kind == CMD_PEND_NONE
+	 && (eol = memchr(c->in, '\n', c->inLen)) != NULL) {
+    *eol = '\0';
+    if (eol > c->in && eol[-1] == '\r')
+      eol[-1] = '\0';
+
+    if (strcmp(c->in, "quit") == 0)
+      return -1;
+
+    if (srv_reply(c, ctx, c->in) == -1)
+      return -1;
+
+    c->inLen -= eol + 1 - c->in;
+    memmove(c->in, eol + 1, c->inLen);
+  }
+
+  return 0;
+}
+
+
+/* @func  srv_http - answer GET of metrics once request line is in,
+ *                   headers are not needed. Anything else gets 404,
+ *                   connection closes after response. Header is queued
+ *                   in stream, body of any size is written from its
+ *                   own buffer behind it
+ * @return SUCCESS  - 0
+ *         ERROR    - -1, errno set appropriately
+ */
+static int srv_http(srv_client_s *c, cmd_ctx_s *ctx)
+{
+  char hdr[160], *body = NULL, *eol;
+  size_t bodyLen = 0;
+  FILE *out;
+  int n, found;
+
+  if ((eol = memchr(c->in, '\n', c->inLen)) == NULL) {
+    // Request line longer than buffer is not ours
+    if (c->inLen < sizeof(c->in) - 1)
+      return 0;
+    eol = c->in;
+  }
+  *eol = '\0';
+
+  found = (strncmp(c->in, "GET " METRICS_PATH " ", strlen("GET " METRICS_PATH " ")) == 0
+	   || strncmp(c->in, "GET " METRICS_PATH "?", strlen("GET " METRICS_PATH "?")) == 0);
+
+  out = open_memstream(&body, &bodyLen);
+  if (out == NULL)
+    return -1;
+  if (found)
+    metrics_write(out, ctx);
+  else
+    fprintf(out, "Not found, try " METRICS_PATH "\n");
+  fclose(out);
+
+  n = snprintf(hdr, sizeof(hdr),
+	       "HTTP/1.0 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+	       "Connection: close\r\n\r\n",
+	       found ? "200 OK" : "404 Not Found",
+	       found ? METRICS_TYPE : "text/plain", bodyLen);
+
+  c->body = body;
+  c->bodyLen = bodyLen;
+  c->bodyOff = 0;
+  c->closing = 1;
+
+  return stream_write(&c->st, hdr, n);
+}
+
+
+/* @func  srv_pending - bytes of client not yet written, body included */
+static size_t srv_pending(const srv_client_s *c)
+{
+  return stream_pending(&c->st) + (c->bodyLen - c->bodyOff);
+}
+
+
+/* @func  srv_flush_body - write HTTP body once header is out, without
+ *                         blocking
+ * @return SUCCESS     - 0, all or some bytes written or socket busy
+ *         ERROR       - -1, errno set appropriately
+ */
+static int srv_flush_body(srv_client_s *c)
+{
+  ssize_t n;
+
+  while (c->bodyOff < c->bodyLen && stream_pending(&c->st) == 0) {
+    n = write(c->fd, c->body + c->bodyOff, c->bodyLen - c->bodyOff);
+    if (n == -1) {
+      if (errno == EINTR)
+	continue;
+      return (errno == EAGAIN) ? 0 : -1;
+    }
+    c->bodyOff += n;
+  }
+
+  return 0;
+}
+
+
+/* @func  srv_interest - watch client for writability only while it
+ *                       has output pending, for input only while it
+ *                       has no command parked
+ */
+static void srv_interest(server_s *srv, int i)
+{
+  srv_client_s *c = srv->clients[i];
+  struct epoll_event ev;
+  uint32_t want;
+
+  want = (c->pend.kind == CMD_PEND_NONE ? EPOLLIN : 0)
+    | (srv_pending(c) > 0 ? EPOLLOUT : 0);
+  if (want == c->events)
+    return;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = want;
+  ev.data.u32 = i;
+  if (epoll_ctl(srv->epfd, EPOLL_CTL_MOD, c->fd, &ev) == -1)
+    srv_drop(srv, i);
+  else
+    c->events = want;
+}
+
+
+/****************************************************************/
+/**************** Global Functions Definitions ******************/
+/****************************************************************/
+
+/* @func  server_init - create epoll instance, no socket listens yet.
+ *                      SIGPIPE is ignored, vanished client shows up
+ *                      as EPIPE of its write
+ * @param ts_mode_e tsMode - timestamp format of streamed lines
+ * @return SUCCESS     - 0
+ *         ERROR       - -1, errno set appropriately
+ */
+int server_init(server_s *srv, ts_mode_e tsMode)
+{
+  memset(srv, 0, sizeof(*srv));
+  srv->unixFd = srv->tcpFd = srv->httpFd = -1;
+  srv->tsMode = tsMode;
+
+  if (signal(SIGPIPE, SIG_IGN) == SIG_ERR)
+    return -1;
+
+  srv->epfd = epoll_create1(EPOLL_CLOEXEC);
+  return (srv->epfd == -1) ? -1 : 0;
+}
+
+
+/* @func  server_listen_unix - listen on Unix-domain stream socket,
+ *                             stale socket file is replaced
+ * @param const char *path - socket path
+ * @return SUCCESS     - 0
+ *         ERROR       - -1, errno set appropriately
+ */
+int server_listen_unix(server_s *srv, const char *path)
+{
+  struct sockaddr_un addr;
+
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  srv->unixFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (srv->unixFd == -1)
+    return -1;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+  if (unlink(path) == -1 && errno != ENOENT)
+    return -1;
+  if (bind(srv->unixFd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    return -1;
+  srv->unixPath = path;
+
+  return srv_listen(srv, srv->unixFd, SRV_TAG_UNIX);
+}
+
+
+/* @func  server_listen_tcp - listen on loopback TCP port
+ * @param int port     - port number
+ * @return SUCCESS     - 0
+ *         ERROR       - -1, errno set appropriately
+ */
+int server_listen_tcp(server_s *srv, int port)
+{
+  srv->tcpFd = srv_loopback(port);
+  if (srv->tcpFd == -1)
+    return -1;
+
+  return srv_listen(srv, srv->tcpFd, SRV_TAG_TCP);
+}
+
+
+/* @func  server_listen_http - serve Prometheus metrics on loopback
+ *                             TCP port
+ * @param int port     - port number
+ * @return SUCCESS     - 0
+ *         ERROR       - -1, errno set appropriately
+ */
+int server_listen_http(server_s *srv, int port)
+{
+  srv->httpFd = srv_loopback(port);
+  if (srv->httpFd == -1)
+    return -1;
+
+  return srv_listen(srv, srv->httpFd, SRV_TAG_HTTP);
+}
+
+
+/* @func  server_fd - descriptor readable when server has events */
+int server_fd(const server_s *srv)
+{
+  return srv->epfd;
+}
+
+
+/* @func  server_streaming - whether some client subscribed to stream */
+int server_streaming(const server_s *srv)
+{
+  int i;
+
+  for (i = 0; i < SRV_MAX_CLIENTS; i++)
+    if (srv->clients[i] != NULL && srv->clients[i]->st.active)
+      return 1;
+
+  return 0;
+}
+
+
+/* @func  server_waiting - whether some client has command parked */
+int server_waiting(const server_s *srv)
+{
+  int i;
+
+  for (i = 0; i < SRV_MAX_CLIENTS; i++)
+    if (srv->clients[i] != NULL
+	&& srv->clients[i]->pend.kind != CMD_PEND_NONE)
+      return 1;
+
+  return 0;
+}
+
+
+/* @func  server_service - handle ready sockets without blocking, poll
+ *                         parked commands, then pull samples of
+ *                         subscribed clients. Called on every pass of
+ *                         main loop
+ * @param cmd_ctx_s *ctx - application state commands work on
+ */
+void server_service(server_s *srv, cmd_ctx_s *ctx)
+{
+  struct epoll_event ev[SRV_EVENTS];
+  srv_client_s *c;
+  uint32_t tag;
+  int n, i;
+
+  n = epoll_wait(srv->epfd, ev, SRV_EVENTS, 0);
+  for (i = 0; i < n; i++) {
+    tag = ev[i].data.u32;
+    if (tag == SRV_TAG_UNIX || tag == SRV_TAG_TCP) {
+      srv_accept(srv, tag == SRV_TAG_UNIX ? srv->unixFd : srv->tcpFd,
+		 SRV_CLIENT_CMD);
+      continue;
+    }
+    if (tag == SRV_TAG_HTTP) {
+      srv_accept(srv, srv->httpFd, SRV_CLIENT_HTTP);
+      continue;
+    }
+
+    c = srv->clients[tag];
+    if (c == NULL)
+      continue;
+    if ((ev[i].events & EPOLLIN) && srv_read(srv, c, ctx) == -1)
+      srv_drop(srv, tag);
+    else if (ev[i].events & (EPOLLERR | EPOLLHUP))
+      srv_drop(srv, tag);
+  }
+
+  for (i = 0; i < SRV_MAX_CLIENTS; i++) {
+    c = srv->clients[i];
+    if (c == NULL)
+      continue;
+
+    // Finished command lets lines received behind it run
+    if (c->pend.kind != CMD_PEND_NONE
+	&& (srv_reply(c, ctx, NULL) == -1 || srv_lines(c, ctx) == -1)) {
+      srv_drop(srv, i);
+      continue;
+    }
+
+    stream_poll(&c->st, ctx->share);
+    if (stream_flush(&c->st) == -1 || srv_flush_body(c) == -1
+	|| (c->closing && srv_pending(c) == 0)) {
+      srv_drop(srv, i);
+      continue;
+    }
+    srv_interest(srv, i);
+  }
+}
+
+
+/* @func  server_close - close clients and listening sockets */
+void server_close(server_s *srv)
+{
+  int i;
+
+  for (i = 0; i < SRV_MAX_CLIENTS; i++)
+    srv_drop(srv, i);
+
+  if (srv->unixFd != -1)
+    close(srv->unixFd);
+  if (srv->unixPath != NULL)
+    unlink(srv->unixPath);
+  if (srv->tcpFd != -1)
+    close(srv->tcpFd);
+  if (srv->httpFd != -1)
+    close(srv->httpFd);
+  if (srv->epfd != -1)
+    close(srv->epfd);
+}
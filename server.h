@@ -0,0 +1,74 @@
+/*****************************************************************
+ * Title    : server.h
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Header file of command server. Serves console command
+ *            set to many clients over Unix-domain socket and optional
+ *            loopback TCP port. All sockets are non-blocking and
+ *            multiplexed by one epoll instance, whose descriptor is
+ *            watched by main select() loop beside stdin. Separate
+ *            loopback port answers HTTP GET of Prometheus metrics
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+#ifndef SERVER_H
+#define SERVER_H
+
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include "command.h"
+#include "stream.h"
+
+/****************************************************************/
+/******************* Symbolic Constant Definitions **************/
+/****************************************************************/
+#define SRV_MAX_CLIENTS  16
+#define SRV_LINE_MAX     256        // longest command line of client
+#define SRV_BACKLOG      8
+#define SRV_EVENTS       32         // epoll events taken per call
+
+// Kinds of client connection
+#define SRV_CLIENT_CMD   0          // command lines, stream subscription
+#define SRV_CLIENT_HTTP  1          // one metrics request, then closed
+
+/****************************************************************/
+/********************** New Types Definitions *******************/
+/****************************************************************/
+typedef struct {
+  int fd;
+  int kind;                         // SRV_CLIENT_*
+  int closing;                      // close once output is written
+  uint32_t events;                  // epoll interest of fd
+  char in[SRV_LINE_MAX];            // partial command line
+  size_t inLen;
+  stream_s st;                      // responses and subscribed samples
+  cmd_pend_s pend;                  // command waiting for sampler
+  char *body;                       // HTTP body written behind st, any size
+  size_t bodyLen, bodyOff;
+} srv_client_s;
+
+typedef struct {
+  int epfd;
+  int unixFd;                       // -1 when not listening
+  int tcpFd;
+  int httpFd;
+  const char *unixPath;
+  ts_mode_e tsMode;
+  srv_client_s *clients[SRV_MAX_CLIENTS];
+} server_s;
+
+/****************************************************************/
+/******************* Global Functions Declarations **************/
+/****************************************************************/
+int server_init(server_s *srv, ts_mode_e tsMode);
+int server_listen_unix(server_s *srv, const char *path);
+int server_listen_tcp(server_s *srv, int port);
+int server_listen_http(server_s *srv, int port);
+int server_fd(const server_s *srv);
+int server_streaming(const server_s *srv);
+int server_waiting(const server_s *srv);
+void server_service(server_s *srv, cmd_ctx_s *ctx);
+void server_close(server_s *srv);
+
+#endif // SERVER_H
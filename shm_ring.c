@@ -0,0 +1,393 @@
+/*****************************************************************
+ * Title    : shm_ring.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Source file of sample ring and accumulator block shared
+ *            between sampler and readers. Sampler never blocks,
+ *            readers retry when they race with it
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+
+//#define SELF
+//#define DEBUG
+//#define PRINT
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "../header/tlpi_hdr.h"
+#include "shm_ring.h"
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+
+// Counters are shared between processes, atomics must not fall back
+// to libatomic locks which are private to each process
+_Static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "64-bit atomics not lock-free");
+_Static_assert(ATOMIC_INT_LOCK_FREE == 2, "32-bit atomics not lock-free");
+_Static_assert(ATOMIC_LONG_LOCK_FREE == 2, "long atomics not lock-free");
+_Static_assert((RING_SLOTS & RING_MASK) == 0, "RING_SLOTS not power of two");
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+#ifdef SELF
+int main(int argc, char *argv[])
+{
+  shm_share_s *share;
+  dev_share_s *ds;
+  sample_s smp;
+  accu_data_s d;
+  uint64_t n, bad = 0, ok = 0;
+  pid_t pid;
+
+  share = shm_share_create(1);
+  if (share == NULL)
+    errExit("shm_share_create");
+  ds = &share->dev[0];
+
+  switch (pid = fork()) {
+  case -1:
+    errExit("fork");
+
+  case 0:                            // producer
+    memset(&smp, 0, sizeof(smp));
+    for (n = 0; n < 10000000; n++) {
+      smp.tsNs = n;
+      smp.power = n;
+      ring_publish(&ds->ring, &smp);
+
+      accu_write_begin(&ds->accu);
+      ds->accu.d.lastTsNs = n;
+      ds->accu.d.samples = n;
+      accu_write_end(&ds->accu);
+    }
+    _exit(EXIT_SUCCESS);
+
+  default:                           // consumer checks consistency
+    while (waitpid(pid, NULL, WNOHANG) == 0) {
+      if (ring_latest(&ds->ring, &smp) == 0) {
+	if (smp.power != (double)smp.tsNs)
+	  bad++;
+	ok++;
+      }
+      accu_read(&ds->accu, &d);
+      if (d.lastTsNs != (int64_t)d.samples)
+	bad++;
+    }
+  }
+
+  printf("consistent reads: %llu, torn reads: %llu\n",
+	 (unsigned long long)ok, (unsigned long long)bad);
+  exit(bad == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+#endif // SELF
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+
+/****************************************************************/
+/**************** Global Functions Definitions ******************/
+/****************************************************************/
+
+/* @func  shm_share_create - map zeroed anonymous shared region, which
+ *                           is inherited by child processes after fork()
+ * @param int ndev         - number of measured devices
+ * @return SUCCESS         - pointer to shared state
+ *         ERROR           - NULL, errno set appropriately
+ */
+shm_share_s *shm_share_create(int ndev)
+{
+  shm_share_s *share;
+
+  share = mmap(NULL, sizeof(*share) + ndev * sizeof(dev_share_s),
+	       PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (share == MAP_FAILED)
+    return NULL;
+
+  share->ndev = ndev;
+  return share;
+}
+
+
+/* @func  ring_publish - append sample to ring, overwriting oldest one.
+ *                       Only sampler may call it
+ * @param sample_ring_s *ring - ring in shared memory
+ * @param const sample_s *smp - sample to publish
+ */
+void ring_publish(sample_ring_s *ring, const sample_s *smp)
+{
+  uint64_t n = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  ring_slot_s *slot = &ring->slots[n & RING_MASK];
+
+  atomic_store_explicit(&slot->seq, 2 * n + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  slot->smp = *smp;
+  atomic_store_explicit(&slot->seq, 2 * n + 2, memory_order_release);
+
+  atomic_store_explicit(&ring->head, n + 1, memory_order_release);
+}
+
+
+/* @func  ring_head - number of samples published so far, newest
+ *                    sample has index ring_head() - 1
+ */
+uint64_t ring_head(const sample_ring_s *ring)
+{
+  return atomic_load_explicit(&ring->head, memory_order_acquire);
+}
+
+
+/* @func  ring_read - copy sample with index n
+ * @param const sample_ring_s *ring - ring in shared memory
+ * @param uint64_t n                - index of sample
+ * @param sample_s *smp             - buffer for sample
+ * @return SUCCESS                  - 0
+ *         ERROR                    - -1, sample not published yet or
+ *                                    already overwritten by producer
+ */
+int ring_read(const sample_ring_s *ring, uint64_t n, sample_s *smp)
+{
+  const ring_slot_s *slot = &ring->slots[n & RING_MASK];
+  uint64_t s1, s2;
+
+  s1 = atomic_load_explicit(&slot->seq, memory_order_acquire);
+  if (s1 != 2 * n + 2)
+    return -1;
+
+  *smp = slot->smp;
+
+  atomic_thread_fence(memory_order_acquire);
+  s2 = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+
+  return (s1 == s2) ? 0 : -1;
+}
+
+
+/* @func  ring_latest - copy newest sample
+ * @return SUCCESS     - 0
+ *         ERROR       - -1, ring still empty
+ */
+int ring_latest(const sample_ring_s *ring, sample_s *smp)
+{
+  uint64_t head;
+
+  // Retry only when producer laps whole ring during copy
+  while ((head = ring_head(ring)) > 0)
+    if (ring_read(ring, head - 1, smp) == 0)
+      return 0;
+
+  return -1;
+}
+
+
+/* @func  accu_write_begin - open update of accumulator, only sampler
+ *                           may call it
+ */
+void accu_write_begin(accu_block_s *accu)
+{
+  uint32_t seq = atomic_load_explicit(&accu->seq, memory_order_relaxed);
+
+  atomic_store_explicit(&accu->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+
+/* @func  accu_write_end - publish update of accumulator */
+void accu_write_end(accu_block_s *accu)
+{
+  uint32_t seq = atomic_load_explicit(&accu->seq, memory_order_relaxed);
+
+  atomic_store_explicit(&accu->seq, seq + 1, memory_order_release);
+}
+
+
+/* @func  accu_read - take consistent copy of accumulator, retrying
+ *                    while sampler is in the middle of update
+ * @param const accu_block_s *accu - accumulator in shared memory
+ * @param accu_data_s *d           - buffer for copy
+ */
+void accu_read(const accu_block_s *accu, accu_data_s *d)
+{
+  uint32_t s1, s2;
+
+  do {
+    s1 = atomic_load_explicit(&accu->seq, memory_order_acquire);
+    *d = accu->d;
+    atomic_thread_fence(memory_order_acquire);
+    s2 = atomic_load_explicit(&accu->seq, memory_order_relaxed);
+  } while ((s1 & 1) || s1 != s2);
+}
+
+
+/* @func  shm_request_clear - ask sampler to zero accumulator
+ * @return request number, done when clearAck reaches it
+ */
+uint32_t shm_request_clear(dev_share_s *ds)
+{
+  return atomic_fetch_add_explicit(&ds->clearReq, 1,
+				   memory_order_acq_rel) + 1;
+}
+
+
+/* @func  shm_clear_pending - check for clear request, sampler side
+ * @param uint32_t *req     - latest request number to acknowledge
+ * @return 1 when request pending, 0 otherwise
+ */
+int shm_clear_pending(dev_share_s *ds, uint32_t *req)
+{
+  *req = atomic_load_explicit(&ds->clearReq, memory_order_acquire);
+
+  return *req != atomic_load_explicit(&ds->clearAck, memory_order_relaxed);
+}
+
+
+/* @func  shm_clear_ack - acknowledge clear request, sampler side */
+void shm_clear_ack(dev_share_s *ds, uint32_t req)
+{
+  atomic_store_explicit(&ds->clearAck, req, memory_order_release);
+}
+
+
+/* @func  shm_clear_done - check clear request was served, reader side
+ * @param uint32_t req    - request number from shm_request_clear()
+ * @return 1 when accumulator was zeroed, 0 otherwise
+ */
+int shm_clear_done(dev_share_s *ds, uint32_t req)
+{
+  return (int32_t)(atomic_load_explicit(&ds->clearAck, memory_order_acquire)
+		   - req) >= 0;
+}
+
+
+/* @func  shm_request_config - ask sampler to write configuration and
+ *                             calibration registers of device. Both
+ *                             travel in one word, so never torn
+ * @return request number, done when cfgAck reaches it
+ */
+uint32_t shm_request_config(dev_share_s *ds, uint16_t conf, uint16_t calib)
+{
+  atomic_store_explicit(&ds->cfgWord, (uint32_t)conf << 16 | calib,
+			memory_order_relaxed);
+  return atomic_fetch_add_explicit(&ds->cfgReq, 1,
+				   memory_order_acq_rel) + 1;
+}
+
+
+/* @func  shm_config_pending - check for config request, sampler side
+ * @param uint32_t *req     - latest request number to acknowledge
+ * @param uint16_t *conf    - requested configuration register
+ * @param uint16_t *calib   - requested calibration register
+ * @return 1 when request pending, 0 otherwise
+ */
+int shm_config_pending(dev_share_s *ds, uint32_t *req,
+		       uint16_t *conf, uint16_t *calib)
+{
+  uint32_t word;
+
+  *req = atomic_load_explicit(&ds->cfgReq, memory_order_acquire);
+  if (*req == atomic_load_explicit(&ds->cfgAck, memory_order_relaxed))
+    return 0;
+
+  word = atomic_load_explicit(&ds->cfgWord, memory_order_relaxed);
+  *conf = (uint16_t)(word >> 16);
+  *calib = (uint16_t)word;
+  return 1;
+}
+
+
+/* @func  shm_config_ack - acknowledge config request, sampler side */
+void shm_config_ack(dev_share_s *ds, uint32_t req)
+{
+  atomic_store_explicit(&ds->cfgAck, req, memory_order_release);
+}
+
+
+/* @func  shm_config_done - check config request was served, reader side
+ * @param uint32_t req    - request number from shm_request_config()
+ * @return 1 when device runs with requested config, 0 otherwise
+ */
+int shm_config_done(dev_share_s *ds, uint32_t req)
+{
+  return (int32_t)(atomic_load_explicit(&ds->cfgAck, memory_order_acquire)
+		   - req) >= 0;
+}
+
+
+/* @func  shm_request_read - ask bus worker for sample taken from now on.
+ *                           Requests pending together are served by one
+ *                           bus transaction
+ * @return request number, done when rdAck reaches it
+ */
+uint32_t shm_request_read(dev_share_s *ds)
+{
+  return atomic_fetch_add_explicit(&ds->rdReq, 1,
+				   memory_order_acq_rel) + 1;
+}
+
+
+/* @func  shm_read_pending - check for read request, sampler side
+ * @param uint32_t *req     - latest request number to acknowledge
+ * @return 1 when request pending, 0 otherwise
+ */
+int shm_read_pending(dev_share_s *ds, uint32_t *req)
+{
+  *req = atomic_load_explicit(&ds->rdReq, memory_order_acquire);
+
+  return *req != atomic_load_explicit(&ds->rdAck, memory_order_relaxed);
+}
+
+
+/* @func  shm_read_ack - acknowledge read request once sample requested
+ *                       before req was published in ring, sampler side
+ */
+void shm_read_ack(dev_share_s *ds, uint32_t req)
+{
+  atomic_store_explicit(&ds->rdAck, req, memory_order_release);
+}
+
+
+/* @func  shm_read_done - check read request was served, reader side
+ * @param uint32_t req    - request number from shm_request_read()
+ * @return 1 when ring_latest() holds sample taken after request, 0 otherwise
+ */
+int shm_read_done(dev_share_s *ds, uint32_t req)
+{
+  return (int32_t)(atomic_load_explicit(&ds->rdAck, memory_order_acquire)
+		   - req) >= 0;
+}
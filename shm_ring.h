@@ -0,0 +1,135 @@
+/*****************************************************************
+ * Title    : shm_ring.h
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Header file of state shared between sampler and its
+ *            readers. Single-producer/multi-consumer lock-free ring
+ *            of samples and seqlock protected accumulator block,
+ *            both living in anonymous shared mapping
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <stdint.h>
+#include <stdatomic.h>
+#include "measure.h"
+#include "energy.h"
+#include "rollup.h"
+#include "lat_hist.h"
+
+/****************************************************************/
+/******************* Symbolic Constant Definitions **************/
+/****************************************************************/
+#define RING_SLOTS   8192           // must be power of two
+#define RING_MASK    (RING_SLOTS - 1)
+
+/****************************************************************/
+/********************** New Types Definitions *******************/
+/****************************************************************/
+
+/* Ring slot guarded by its own sequence. Slot of sample n is stable
+ * when seq == 2n + 2, odd seq means producer is writing it */
+typedef struct {
+  _Atomic uint64_t seq;
+  sample_s smp;
+} ring_slot_s;
+
+typedef struct {
+  _Atomic uint64_t head;            // number of samples ever published
+  ring_slot_s slots[RING_SLOTS];
+} sample_ring_s;
+
+// Accumulated values, consistent copy is obtained by accu_read()
+typedef struct {
+  u128_s energy;                    // exact energy since clear, energy_q_s
+  uint64_t samples;                 // samples accumulated since clear
+  uint64_t missed;                  // conversions never read, CNVR pacing
+  int64_t lastTsNs;                 // timestamp of last accumulated sample
+  uint64_t gaps;                    // outages, energy not integrated over
+  int64_t gapNs;                    // total time of outages
+} accu_data_s;
+
+typedef struct {
+  _Atomic uint32_t seq;             // odd while sampler updates data
+  accu_data_s d;
+} accu_block_s;
+
+/* Sampler health of one device. Bus worker is only writer, every
+ * field is read on its own with relaxed load, no snapshot needed */
+typedef struct {
+  _Atomic uint64_t i2cErrors;       // failed register transactions
+  _Atomic uint64_t overruns;        // ticks skipped, bus worker ran late
+  _Atomic uint64_t outages;         // device taken offline after retries
+  _Atomic uint64_t rangeSwitches;   // PGA gain switched by auto-ranging
+  _Atomic uint64_t rangeMarked;     // samples marked SMPL_F_RANGE
+  _Atomic uint64_t ovfSamples;      // samples with SMPL_F_OVF, not counted
+  _Atomic int64_t readNs;           // duration of last sample read
+  _Atomic int64_t readMaxNs;
+  _Atomic int64_t lateNs;           // wakeup past deadline, last tick
+  _Atomic int64_t lateMaxNs;
+  hist_s lateHist;                  // wakeup past deadline, every tick
+  _Atomic int32_t rtPrio;           // SCHED_FIFO priority of worker, 0 none
+  _Atomic int32_t rtCpu;            // CPU worker is pinned to, -1 none
+  _Atomic int32_t rtLocked;         // memory of worker locked
+} smpl_stats_s;
+
+/* Shared state of one device. Bus worker sampling device is its only
+ * writer and only user of its bus, readers post requests (clear,
+ * config, read) which worker serves after its own samples */
+typedef struct {
+  accu_block_s accu;
+  _Atomic uint32_t clearReq;        // incremented by readers
+  _Atomic uint32_t clearAck;        // set to clearReq by sampler
+  _Atomic uint32_t cfgReq;          // incremented by 'config'
+  _Atomic uint32_t cfgAck;          // set to cfgReq once device is set
+  _Atomic uint32_t cfgWord;         // requested config << 16 | calibration
+  _Atomic uint32_t rdReq;           // incremented by readers wanting sample
+  _Atomic uint32_t rdAck;           // set to rdReq once sample is in ring
+  smpl_stats_s stats;
+  i2c_stats_s i2c;                  // every transaction of bus worker
+  rollup_block_s rollup;            // windowed statistics, own seqlock
+  sample_ring_s ring;
+} dev_share_s;
+
+typedef struct {
+  int ndev;
+  _Atomic long rate;                // sample rate set by 'config'
+  dev_share_s dev[];                // one per measured device
+} shm_share_s;
+
+/****************************************************************/
+/******************* Global Functions Declarations **************/
+/****************************************************************/
+shm_share_s *shm_share_create(int ndev);
+
+void ring_publish(sample_ring_s *ring, const sample_s *smp);
+uint64_t ring_head(const sample_ring_s *ring);
+int ring_read(const sample_ring_s *ring, uint64_t n, sample_s *smp);
+int ring_latest(const sample_ring_s *ring, sample_s *smp);
+
+void accu_write_begin(accu_block_s *accu);
+void accu_write_end(accu_block_s *accu);
+void accu_read(const accu_block_s *accu, accu_data_s *d);
+
+uint32_t shm_request_clear(dev_share_s *ds);
+int shm_clear_pending(dev_share_s *ds, uint32_t *req);
+void shm_clear_ack(dev_share_s *ds, uint32_t req);
+int shm_clear_done(dev_share_s *ds, uint32_t req);
+
+uint32_t shm_request_config(dev_share_s *ds, uint16_t conf, uint16_t calib);
+int shm_config_pending(dev_share_s *ds, uint32_t *req,
+		       uint16_t *conf, uint16_t *calib);
+void shm_config_ack(dev_share_s *ds, uint32_t req);
+int shm_config_done(dev_share_s *ds, uint32_t req);
+
+uint32_t shm_request_read(dev_share_s *ds);
+int shm_read_pending(dev_share_s *ds, uint32_t *req);
+void shm_read_ack(dev_share_s *ds, uint32_t req);
+int shm_read_done(dev_share_s *ds, uint32_t req);
+
+#endif // SHM_RING_H
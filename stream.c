@@ -0,0 +1,302 @@
+/*****************************************************************
+ * Title    : stream.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Source file of NDJSON sample stream. Lines go to ring
+ *            buffer of fixed size, one writev() hands both of its
+ *            contiguous parts to kernel. Output is written only when
+ *            select() reports it writable and never blocks, buffer
+ *            full means line is dropped and counted. Socket of client
+ *            is non-blocking already; stdout is shared with stderr and
+ *            workers, so its flags stay and write is kept to PIPE_BUF
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+
+//#define SELF
+//#define DEBUG
+//#define PRINT
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include "../header/tlpi_hdr.h"
+#include "sampler.h"
+#include "stream.h"
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+#define STREAM_BUF_MASK  (STREAM_BUF_SIZE - 1)
+
+_Static_assert((STREAM_BUF_SIZE & STREAM_BUF_MASK) == 0,
+	       "STREAM_BUF_SIZE not power of two");
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+static void stream_put(stream_s *st, const char *data, size_t len);
+static void stream_line(stream_s *st, int d, sample_s *smp);
+
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+/* @func  stream_put - copy bytes to buffer, caller checked free space */
+static void stream_put(stream_s *st, const char *data, size_t len)
+{
+  size_t off, part;
+
+  off = st->head & STREAM_BUF_MASK;
+  part = (len < STREAM_BUF_SIZE - off) ? len : STREAM_BUF_SIZE - off;
+  memcpy(st->buf + off, data, part);
+  memcpy(st->buf, data + part, len - part);
+  st->head += len;
+}
+
+
+/* @func  stream_line - format sample into output buffer, or count it
+ *                      dropped when consumer left no room for it
+ */
+static void stream_line(stream_s *st, int d, sample_s *smp)
+{
+  char line[STREAM_LINE_MAX], tsBuf[TS_BUF_LEN];
+  size_t len;
+  int n;
+
+  meas_eng(smp);
+  n = snprintf(line, sizeof(line),
+	       "{\"dev\":%d,\"ts\":\"%s\",\"v\":%.3f,\"i\":%.4f,\"p\":%.4f,\"flags\":%u}\n",
+	       d, ts_format(&st->tsFmt, ts_mono_to_real(&st->clk, smp->tsNs),
+			    tsBuf, sizeof(tsBuf)),
+	       smp->busVolt + (smp->shuntVolt / 1000), smp->current,
+	       smp->power, (unsigned)smp->flags);
+  len = (n < 0 || (size_t)n >= sizeof(line)) ? 0 : (size_t)n;
+
+  if (len == 0 || len > STREAM_BUF_SIZE - (st->head - st->tail)) {
+    st->dropped++;
+    return;
+  }
+
+  stream_put(st, line, len);
+  st->emitted++;
+}
+
+
+/****************************************************************/
+/**************** Global Functions Definitions ******************/
+/****************************************************************/
+
+/* @func  stream_init - initialize inactive stream
+ * @param int fd          - output file descriptor
+ * @param ts_mode_e tsMode - timestamp format of lines
+ */
+void stream_init(stream_s *st, int fd, ts_mode_e tsMode)
+{
+  int flags;
+
+  memset(st, 0, sizeof(*st));
+  st->fd = fd;
+  flags = fcntl(fd, F_GETFL);
+  st->shared = (flags == -1 || !(flags & O_NONBLOCK));
+  ts_fmt_init(&st->tsFmt, tsMode, TS_FMT_DEF, 6);
+}
+
+
+/* @func  stream_start - stream samples taken from now on
+ * @param long rate       - max lines/s per device, samples between are
+ *                          decimated
+ * @param int first, last - streamed devices
+ */
+void stream_start(stream_s *st, shm_share_s *share, long rate,
+		  int first, int last)
+{
+  int d;
+
+  st->rate = rate;
+  st->periodNs = NSEC_PER_SEC / rate;
+  st->first = first;
+  st->last = last;
+  for (d = first; d <= last; d++) {
+    st->cursor[d] = ring_head(&share->dev[d].ring);
+    st->nextNs[d] = 0;
+  }
+  st->emitted = st->decimated = st->dropped = st->lost = 0;
+  st->active = 1;
+}
+
+
+/* @func  stream_stop - stop taking samples, buffered lines still flush */
+void stream_stop(stream_s *st)
+{
+  st->active = 0;
+}
+
+
+/* @func  stream_poll - format samples published since last poll */
+void stream_poll(stream_s *st, shm_share_s *share)
+{
+  sample_ring_s *ring;
+  sample_s smp;
+  uint64_t head;
+  int d;
+
+  if (!st->active)
+    return;
+
+  ts_clock_sync(&st->clk);
+
+  for (d = st->first; d <= st->last; d++) {
+    ring = &share->dev[d].ring;
+    head = ring_head(ring);
+    if (head - st->cursor[d] > RING_SLOTS) {
+      st->lost += head - st->cursor[d] - RING_SLOTS;
+      st->cursor[d] = head - RING_SLOTS;
+    }
+
+    for (; st->cursor[d] < head; st->cursor[d]++) {
+      if (ring_read(ring, st->cursor[d], &smp) == -1) {
+	st->lost++;
+	continue;
+      }
+      if (smp.tsNs < st->nextNs[d]) {
+	st->decimated++;
+	continue;
+      }
+
+      // Keep lockstep with rate, but no burst after gap in samples
+      if (st->nextNs[d] < smp.tsNs - st->periodNs)
+	st->nextNs[d] = smp.tsNs;
+      st->nextNs[d] += st->periodNs;
+
+      stream_line(st, d, &smp);
+    }
+  }
+}
+
+
+/* @func  stream_write - queue command response behind streamed lines,
+ *                       used when output fd is socket of client
+ * @return SUCCESS     - 0
+ *         ERROR       - -1, not enough free space, nothing queued
+ */
+int stream_write(stream_s *st, const char *data, size_t len)
+{
+  if (len > STREAM_BUF_SIZE - (st->head - st->tail))
+    return -1;
+
+  stream_put(st, data, len);
+  return 0;
+}
+
+
+/* @func  stream_pending - bytes buffered, not yet written */
+size_t stream_pending(const stream_s *st)
+{
+  return st->head - st->tail;
+}
+
+
+/* @func  stream_flush - write buffered lines without blocking, both
+ *                       parts of wrapped buffer in one writev(). Blocking
+ *                       fd is flushed only once select() reported it
+ *                       writable, PIPE_BUF then fits without waiting
+ * @return SUCCESS     - 0, all or some bytes written or output busy
+ *         ERROR       - -1, errno set appropriately
+ */
+int stream_flush(stream_s *st)
+{
+  struct iovec iov[2];
+  size_t pending = st->head - st->tail, off;
+  ssize_t n;
+  int iovcnt = 1;
+
+  if (pending == 0)
+    return 0;
+  if (st->shared && pending > PIPE_BUF)
+    pending = PIPE_BUF;
+
+  off = st->tail & STREAM_BUF_MASK;
+  iov[0].iov_base = st->buf + off;
+  iov[0].iov_len = (pending < STREAM_BUF_SIZE - off) ? pending
+    : STREAM_BUF_SIZE - off;
+  if (iov[0].iov_len < pending) {
+    iov[1].iov_base = st->buf;
+    iov[1].iov_len = pending - iov[0].iov_len;
+    iovcnt = 2;
+  }
+
+  n = writev(st->fd, iov, iovcnt);
+  if (n == -1) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+      return 0;
+    return -1;
+  }
+  st->tail += n;
+
+  return 0;
+}
+
+
+/* @func  stream_sync - finish line written only partly, so command
+ *                      response printed next starts on its own line.
+ *                      Blocks for at most one line, nothing written
+ *                      yet is line boundary
+ * @return SUCCESS     - 0
+ *         ERROR       - -1, errno set appropriately
+ */
+int stream_sync(stream_s *st)
+{
+  size_t off, len;
+  const char *eol;
+  ssize_t n;
+
+  while (st->tail != 0 && st->tail != st->head
+	 && st->buf[(st->tail - 1) & STREAM_BUF_MASK] != '\n') {
+    off = st->tail & STREAM_BUF_MASK;
+    len = st->head - st->tail;
+    if (len > STREAM_BUF_SIZE - off)
+      len = STREAM_BUF_SIZE - off;
+    if ((eol = memchr(st->buf + off, '\n', len)) != NULL)
+      len = eol - (st->buf + off) + 1;
+    n = write(st->fd, st->buf + off, len);
+    if (n == -1) {
+      if (errno == EINTR)
+	continue;
+      return -1;
+    }
+    st->tail += n;
+  }
+
+  return 0;
+}
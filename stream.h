@@ -0,0 +1,68 @@
+/*****************************************************************
+ * Title    : stream.h
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Header file of NDJSON sample stream. Parent process
+ *            pulls samples from rings, formats one compact line per
+ *            sample into preallocated buffer and flushes it with
+ *            writev() when output is writable. Slow consumer costs
+ *            dropped lines, never stalls samplers or command input
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+#ifndef STREAM_H
+#define STREAM_H
+
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <stddef.h>
+#include <stdint.h>
+#include "ina_dev.h"
+#include "shm_ring.h"
+#include "ts_fmt.h"
+
+/****************************************************************/
+/******************* Symbolic Constant Definitions **************/
+/****************************************************************/
+#define STREAM_BUF_SIZE  65536      // output buffer, power of two
+#define STREAM_LINE_MAX  192        // longest line of one sample
+#define STREAM_TICK_MS   20         // rings are pulled this often
+
+/****************************************************************/
+/********************** New Types Definitions *******************/
+/****************************************************************/
+typedef struct {
+  int fd;                           // output, usually stdout
+  int shared;                       // blocking fd, flushed when writable
+  int active;
+  long rate;                        // max lines/s per device
+  int64_t periodNs;                 // 1 / rate
+  int first, last;                  // streamed devices
+  uint64_t cursor[INA_MAX_DEVS];    // next ring index per device
+  int64_t nextNs[INA_MAX_DEVS];     // earliest timestamp of next line
+  char buf[STREAM_BUF_SIZE];
+  uint64_t head;                    // bytes ever buffered
+  uint64_t tail;                    // bytes ever written
+  uint64_t emitted;                 // lines buffered
+  uint64_t decimated;               // samples skipped to keep rate
+  uint64_t dropped;                 // lines not buffered, output full
+  uint64_t lost;                    // samples overwritten in ring
+  ts_clock_s clk;
+  ts_fmt_s tsFmt;
+} stream_s;
+
+/****************************************************************/
+/******************* Global Functions Declarations **************/
+/****************************************************************/
+void stream_init(stream_s *st, int fd, ts_mode_e tsMode);
+void stream_start(stream_s *st, shm_share_s *share, long rate,
+		  int first, int last);
+void stream_stop(stream_s *st);
+void stream_poll(stream_s *st, shm_share_s *share);
+int stream_write(stream_s *st, const char *data, size_t len);
+size_t stream_pending(const stream_s *st);
+int stream_flush(stream_s *st);
+int stream_sync(stream_s *st);
+
+#endif // STREAM_H
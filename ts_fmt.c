@@ -0,0 +1,243 @@
+/*****************************************************************
+ * Title    : ts_fmt.c
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Source file of timestamp service. Replaces currTime(),
+ *            which ran time(), localtime() and strftime() on every
+ *            call into one static buffer, to the second only.
+ *            localtime_r() and strftime() run once per second here,
+ *            sub-second digits are appended by hand
+ * Version  : 1.00
+ * Options  : SELF build prints and times formats: [local|iso|epoch]
+ ****************************************************************/
+//#define _FILE_OFFSET_BITS 64
+
+//#define SELF
+//#define DEBUG
+//#define PRINT
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <time.h>
+#include "../header/tlpi_hdr.h"
+#include "ts_fmt.h"
+
+/****************************************************************/
+/***************** Global Variable Definitions ******************/
+/****************************************************************/
+// Usually put in dedicated header file with specifier "extern"
+
+
+/****************************************************************/
+/************ Local Symbolic Constant Definitions ***************/
+/****************************************************************/
+// When more, can be put in extra header file
+#define NS_PER_SEC       1000000000LL
+#define ISO8601_FMT      "%Y-%m-%dT%H:%M:%S"
+
+/****************************************************************/
+/**************** New Local Types Definitions *******************/
+/****************************************************************/
+// Uses "typedef" keyword to define new type
+
+
+/****************************************************************/
+/************ Static global Variable Definitions ****************/
+/****************************************************************/
+// Must be labeled "static"
+static const char *modeNames[] = { "local", "iso", "epoch" };
+
+/****************************************************************/
+/********* Static Local Functions Prototype Declarations ********/
+/****************************************************************/
+// Use full prototype declarations. Must be labeled "static"
+static int64_t ts_ns(const struct timespec *ts);
+
+
+/****************************************************************/
+/*********************** Main Function **************************/
+/****************************************************************/
+
+#ifdef SELF
+int main(int argc, char *argv[])
+{
+  ts_clock_s clk;
+  ts_fmt_s f;
+  ts_mode_e mode = TS_MODE_LOCAL;
+  char buf[TS_BUF_LEN];
+  struct timespec t0, t1;
+  int i, n = 1000000;
+
+  if (argc > 1 && ts_fmt_parse_mode(argv[1], &mode) == -1)
+    usageErr("%s [local|iso|epoch]\n", argv[0]);
+
+  ts_fmt_init(&f, mode, TS_FMT_DEF, 6);
+  ts_clock_sync(&clk);
+  printf("now: %s\n", ts_format(&f, clk.realNs, buf, sizeof(buf)));
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (i = 0; i < n; i++)
+    ts_format(&f, ts_mono_to_real(&clk, ts_ns(&t0) + i * 1000LL),
+	      buf, sizeof(buf));
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  printf("last: %s, %.1f ns per call\n", buf,
+	 (double)(ts_ns(&t1) - ts_ns(&t0)) / n);
+
+  exit(EXIT_SUCCESS);
+}
+
+#endif // SELF
+
+
+/****************************************************************/
+/************* Static Local Functions Definitions ***************/
+/****************************************************************/
+// Must be labeled "static"
+
+static int64_t ts_ns(const struct timespec *ts)
+{
+  return (int64_t)ts->tv_sec * NS_PER_SEC + ts->tv_nsec;
+}
+
+
+/****************************************************************/
+/**************** Global Functions Definitions ******************/
+/****************************************************************/
+
+/* @func  ts_clock_sync - read monotonic and wall clock at one instant,
+ *                        realtime read is bracketed by two monotonic
+ *                        reads and paired with their midpoint
+ * @param ts_clock_s *c - clock pair to fill
+ */
+void ts_clock_sync(ts_clock_s *c)
+{
+  struct timespec m0, r, m1;
+
+  clock_gettime(CLOCK_MONOTONIC, &m0);
+  clock_gettime(CLOCK_REALTIME, &r);
+  clock_gettime(CLOCK_MONOTONIC, &m1);
+
+  c->monoNs = ts_ns(&m0) + (ts_ns(&m1) - ts_ns(&m0)) / 2;
+  c->realNs = ts_ns(&r);
+}
+
+
+/* @func  ts_mono_to_real - wall-clock time of CLOCK_MONOTONIC timestamp
+ * @param const ts_clock_s *c - clock pair from ts_clock_sync()
+ * @param int64_t monoNs      - CLOCK_MONOTONIC time in ns
+ * @return CLOCK_REALTIME time in ns
+ */
+int64_t ts_mono_to_real(const ts_clock_s *c, int64_t monoNs)
+{
+  return c->realNs + (monoNs - c->monoNs);
+}
+
+
+/* @func  ts_fmt_init - initialize formatter
+ * @param ts_mode_e mode     - output mode
+ * @param const char *strfFmt - strftime() format of TS_MODE_LOCAL,
+ *                             NULL for TS_FMT_DEF
+ * @param int fracDigits     - sub-second digits 0 - 9 (ignored in
+ *                             TS_MODE_EPOCH_NS)
+ */
+void ts_fmt_init(ts_fmt_s *f, ts_mode_e mode, const char *strfFmt,
+		 int fracDigits)
+{
+  memset(f, 0, sizeof(*f));
+  f->mode = mode;
+  f->strfFmt = (strfFmt != NULL) ? strfFmt : TS_FMT_DEF;
+  f->fracDigits = (fracDigits < 0) ? 0 : (fracDigits > 9) ? 9 : fracDigits;
+
+  // localtime_r() need not read TZ by itself
+  tzset();
+}
+
+
+/* @func  ts_fmt_parse_mode - mode by name "local", "iso" or "epoch"
+ * @return SUCCESS          - 0
+ *         ERROR            - -1, unknown name
+ */
+int ts_fmt_parse_mode(const char *name, ts_mode_e *mode)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof(modeNames) / sizeof(modeNames[0]); i++) {
+    if (strcmp(name, modeNames[i]) == 0) {
+      *mode = (ts_mode_e)i;
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+
+/* @func  ts_format - format wall-clock time
+ * @param ts_fmt_s *f    - formatter, caches date and time of last second
+ * @param int64_t realNs - CLOCK_REALTIME time in ns
+ * @param char *buf      - output buffer, TS_BUF_LEN is always enough
+ * @param size_t len     - size of buf
+ * @return buf, empty string when time can not be broken down
+ */
+char *ts_format(ts_fmt_s *f, int64_t realNs, char *buf, size_t len)
+{
+  struct tm tm;
+  time_t sec;
+  long nsec, div;
+  char *p;
+  int i;
+
+  if (f->mode == TS_MODE_EPOCH_NS) {
+    snprintf(buf, len, "%lld", (long long)realNs);
+    return buf;
+  }
+
+  // Floor division, times before Epoch keep positive fraction
+  sec = (time_t)(realNs / NS_PER_SEC);
+  nsec = (long)(realNs % NS_PER_SEC);
+  if (nsec < 0) {
+    sec--;
+    nsec += NS_PER_SEC;
+  }
+
+  if (!f->valid || sec != f->sec) {
+    if ((f->mode == TS_MODE_ISO8601 ? gmtime_r(&sec, &tm)
+	 : localtime_r(&sec, &tm)) == NULL) {
+      buf[0] = '\0';
+      return buf;
+    }
+    f->prefixLen = strftime(f->prefix, sizeof(f->prefix),
+			    f->mode == TS_MODE_ISO8601 ? ISO8601_FMT
+			    : f->strfFmt, &tm);
+    f->sec = sec;
+    f->valid = 1;
+  }
+
+  // Prefix, point, fraction, zone and NUL must fit
+  if (len < f->prefixLen + f->fracDigits + 3) {
+    if (len > 0)
+      buf[0] = '\0';
+    return buf;
+  }
+  memcpy(buf, f->prefix, f->prefixLen);
+  p = buf + f->prefixLen;
+
+  // Leading digits of nanoseconds, written right to left
+  if (f->fracDigits > 0) {
+    *p++ = '.';
+    div = 1;
+    for (i = f->fracDigits; i < 9; i++)
+      div *= 10;
+    nsec /= div;
+    for (i = f->fracDigits - 1; i >= 0; i--) {
+      p[i] = '0' + nsec % 10;
+      nsec /= 10;
+    }
+    p += f->fracDigits;
+  }
+  if (f->mode == TS_MODE_ISO8601)
+    *p++ = 'Z';
+  *p = '\0';
+
+  return buf;
+}
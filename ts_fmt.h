@@ -0,0 +1,65 @@
+/*****************************************************************
+ * Title    : ts_fmt.h
+ * Author   : Martin Dida
+ * Date     : 16.Oct.2026
+ * Brief    : Header file of timestamp service. Maps CLOCK_MONOTONIC
+ *            sample timestamps to wall-clock time and formats them
+ *            with sub-second digits, broken-down time is cached per
+ *            second. Caller owns all state, thus reentrant
+ * Version  : 1.00
+ * Options  :
+ ****************************************************************/
+#ifndef TS_FMT_H
+#define TS_FMT_H
+
+/****************************************************************/
+/************************** Includes ****************************/
+/****************************************************************/
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/****************************************************************/
+/******************* Symbolic Constant Definitions **************/
+/****************************************************************/
+#define TS_BUF_LEN       64         // fits every mode and fraction
+#define TS_PREFIX_LEN    48
+#define TS_FMT_DEF       "%d/%m/%y %T"
+
+/****************************************************************/
+/********************** New Types Definitions *******************/
+/****************************************************************/
+typedef enum {
+  TS_MODE_LOCAL = 0,                // strftime() format in local time
+  TS_MODE_ISO8601,                  // 2026-10-16T12:00:00.123456Z
+  TS_MODE_EPOCH_NS                  // nanoseconds since Epoch
+} ts_mode_e;
+
+// Pair of clock readings taken at one instant
+typedef struct {
+  int64_t monoNs;                   // CLOCK_MONOTONIC
+  int64_t realNs;                   // CLOCK_REALTIME
+} ts_clock_s;
+
+typedef struct {
+  ts_mode_e mode;
+  const char *strfFmt;              // format of TS_MODE_LOCAL
+  int fracDigits;                   // 0 - 9 digits after seconds
+  int valid;                        // prefix holds second sec
+  time_t sec;
+  char prefix[TS_PREFIX_LEN];       // formatted date and time of sec
+  size_t prefixLen;
+} ts_fmt_s;
+
+/****************************************************************/
+/******************* Global Functions Declarations **************/
+/****************************************************************/
+void ts_clock_sync(ts_clock_s *c);
+int64_t ts_mono_to_real(const ts_clock_s *c, int64_t monoNs);
+
+void ts_fmt_init(ts_fmt_s *f, ts_mode_e mode, const char *strfFmt,
+		 int fracDigits);
+int ts_fmt_parse_mode(const char *name, ts_mode_e *mode);
+char *ts_format(ts_fmt_s *f, int64_t realNs, char *buf, size_t len);
+
+#endif // TS_FMT_H